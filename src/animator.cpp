@@ -0,0 +1,301 @@
+#include "animator.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// must match the push constants of shaders/deform.comp (scalar)
+struct DeformParams
+{
+    VkDeviceAddress srcPositions;
+    VkDeviceAddress srcNormals;
+    VkDeviceAddress srcTangents;
+    VkDeviceAddress joints; // 0 if not skinned
+    VkDeviceAddress weights;
+    VkDeviceAddress morphTargets;
+    VkDeviceAddress dstPositions;
+    VkDeviceAddress dstNormals;
+    VkDeviceAddress dstTangents;
+    VkDeviceAddress jointMatrices;
+    VkDeviceAddress morphWeights;
+    uint32_t vertexCount;
+    uint32_t targetCount;
+};
+static_assert(sizeof(DeformParams) == 96u, "DeformParams must match the push constants of deform.comp");
+
+static const uint32_t DEFORM_GROUP_SIZE = 64u;
+// buffer references default to 16 byte alignment
+static const VkDeviceSize PARAM_ALIGNMENT = 16u;
+
+bool Animator::create(const std::vector<Mesh>& meshes)
+{
+    m_poseByNode.assign(m_sceneGraph.size(), -1);
+    for (size_t i = 0; i < m_poses.size(); i++)
+        m_poseByNode[m_poses[i].node] = static_cast<int32_t>(i);
+    m_deformedByNode.assign(m_sceneGraph.size(), -1);
+
+    // deformed copies are laid out like the mesh's own attributes, so they can replace them in the instance table
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | m_extraUsage;
+    VkDeviceSize paramSize = 0u;
+    for (size_t i = 0; i < m_deformed.size(); i++)
+    {
+        DeformedInstance& inst = m_deformed[i];
+        const Mesh& m = meshes[inst.mesh];
+        m_deformedByNode[inst.node] = static_cast<int32_t>(i);
+
+        inst.positionBuffer = std::make_shared<vk::Buffer>(m_allocator);
+        inst.normalBuffer = std::make_shared<vk::Buffer>(m_allocator);
+        inst.tangentBuffer = std::make_shared<vk::Buffer>(m_allocator);
+        if (!inst.positionBuffer->create(12u * static_cast<VkDeviceSize>(m.vertexCount), usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u) ||
+            !inst.normalBuffer->create(12u * static_cast<VkDeviceSize>(m.vertexCount), usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u) ||
+            !inst.tangentBuffer->create(16u * static_cast<VkDeviceSize>(m.vertexCount), usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u))
+            return false;
+
+        size_t jointCount = inst.skin >= 0 ? m_skins[inst.skin].joints.size() : 0u;
+        inst.paramOffset = paramSize;
+        paramSize += sizeof(glm::mat4) * jointCount + sizeof(float) * m.morphTargetCount;
+        paramSize = (paramSize + PARAM_ALIGNMENT - 1u) / PARAM_ALIGNMENT * PARAM_ALIGNMENT;
+    }
+
+    // rewritten every frame the parameters change, like the instance table it is small enough to stay host visible
+    m_paramBuffer = std::make_unique<vk::Buffer>(m_allocator);
+    if (!m_paramBuffer->create(std::max(paramSize, PARAM_ALIGNMENT), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        return false;
+
+    m_currentPoses = m_poses;
+    m_paramsChanged = true;
+    return true;
+}
+
+void Animator::setInstanceTable(std::shared_ptr<vk::Buffer> instanceTable, std::shared_ptr<const std::vector<Mesh>> meshes, const std::vector<uint32_t>& records,
+    const std::vector<std::pair<uint32_t, uint32_t>>& instanceRanges, const std::vector<glm::mat4>& instanceTransforms)
+{
+    m_instanceTable = instanceTable;
+    m_meshes = meshes;
+
+    // a node moves if a channel targets it or any of its ancestors, parents precede their children
+    std::vector<bool> targeted(m_sceneGraph.size(), false);
+    for (const Animation& anim : m_animations)
+    {
+        for (const Channel& ch : anim.channels)
+            targeted[ch.node] = targeted[ch.node] || ch.path != Path::Weights;
+    }
+    m_animatedRecords.clear();
+    for (uint32_t i = 0; i < m_sceneGraph.size(); i++)
+    {
+        int32_t parent = m_sceneGraph.getParent(i);
+        targeted[i] = targeted[i] || (parent >= 0 && targeted[parent]);
+        if (!targeted[i] || records[i] == ~0u)
+            continue;
+
+        // quantized positions are stored relative to the mesh's bounds
+        const glm::mat4& positionTransform = (*meshes)[m_sceneGraph.getMesh(i)].positionTransform;
+        uint32_t instanceCount = i < instanceRanges.size() ? instanceRanges[i].second : 0u;
+        if (instanceCount == 0u)
+            m_animatedRecords.push_back({ i, records[i], positionTransform });
+        for (uint32_t k = 0; k < instanceCount; k++)
+            m_animatedRecords.push_back({ i, records[i] + k, instanceTransforms[instanceRanges[i].first + k] * positionTransform });
+    }
+}
+
+int32_t Animator::getDeformedInstance(uint32_t node) const
+{
+    return node < m_deformedByNode.size() ? m_deformedByNode[node] : -1;
+}
+
+void Animator::sample(const Sampler& sampler, bool rotation, float time, float* dst) const
+{
+    // cubic spline keys hold in-tangent, value, out-tangent
+    size_t n = sampler.components;
+    bool cubic = sampler.interpolation == Interpolation::CubicSpline;
+    size_t stride = cubic ? 3u * n : n;
+    size_t valueOffset = cubic ? n : 0u;
+    size_t keyCount = sampler.times.size();
+    if (keyCount == 0u || sampler.values.size() < keyCount * stride)
+        return;
+
+    const float* values = sampler.values.data();
+    if (keyCount == 1u || time <= sampler.times.front() || time >= sampler.times.back())
+    {
+        size_t k = keyCount == 1u || time <= sampler.times.front() ? 0u : keyCount - 1u;
+        std::copy(values + k * stride + valueOffset, values + k * stride + valueOffset + n, dst);
+        return;
+    }
+
+    size_t k = static_cast<size_t>(std::upper_bound(sampler.times.begin(), sampler.times.end(), time) - sampler.times.begin()) - 1u;
+    float dt = sampler.times[k + 1u] - sampler.times[k];
+    float u = dt > 0.0f ? (time - sampler.times[k]) / dt : 0.0f;
+    const float* v0 = values + k * stride + valueOffset;
+    const float* v1 = values + (k + 1u) * stride + valueOffset;
+
+    switch (sampler.interpolation)
+    {
+    case Interpolation::Step:
+        std::copy(v0, v0 + n, dst);
+        return;
+    case Interpolation::Linear:
+        if (rotation)
+        {
+            // glTF stores quaternions as XYZW
+            glm::quat q = glm::slerp(glm::quat(v0[3], v0[0], v0[1], v0[2]), glm::quat(v1[3], v1[0], v1[1], v1[2]), u);
+            dst[0] = q.x, dst[1] = q.y, dst[2] = q.z, dst[3] = q.w;
+            return;
+        }
+        for (size_t c = 0; c < n; c++)
+            dst[c] = v0[c] + u * (v1[c] - v0[c]);
+        return;
+    case Interpolation::CubicSpline:
+    {
+        // Hermite spline between the keys, tangents are scaled by the key interval
+        const float* outTangent = v0 + n;
+        const float* inTangent = v1 - n;
+        float u2 = u * u, u3 = u2 * u;
+        float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f, h10 = u3 - 2.0f * u2 + u, h01 = -2.0f * u3 + 3.0f * u2, h11 = u3 - u2;
+        for (size_t c = 0; c < n; c++)
+            dst[c] = h00 * v0[c] + h10 * dt * outTangent[c] + h01 * v1[c] + h11 * dt * inTangent[c];
+        if (rotation)
+        {
+            glm::quat q = glm::normalize(glm::quat(dst[3], dst[0], dst[1], dst[2]));
+            dst[0] = q.x, dst[1] = q.y, dst[2] = q.z, dst[3] = q.w;
+        }
+        return;
+    }
+    }
+}
+
+void Animator::update(float time)
+{
+    if (m_animation >= 0 && m_animation < static_cast<int32_t>(m_animations.size()))
+    {
+        const Animation& anim = m_animations[m_animation];
+        float t = anim.duration > 0.0f ? std::fmod(time, anim.duration) : 0.0f;
+
+        // nodes the animation doesn't target keep their rest pose
+        for (size_t i = 0; i < m_poses.size(); i++)
+        {
+            m_currentPoses[i].translation = m_poses[i].translation;
+            m_currentPoses[i].rotation = m_poses[i].rotation;
+            m_currentPoses[i].scale = m_poses[i].scale;
+            std::copy(m_poses[i].weights.begin(), m_poses[i].weights.end(), m_currentPoses[i].weights.begin());
+        }
+
+        for (const Channel& ch : anim.channels)
+        {
+            NodePose& pose = m_currentPoses[m_poseByNode[ch.node]];
+            const Sampler& sampler = anim.samplers[ch.sampler];
+            float v[4];
+            switch (ch.path)
+            {
+            case Path::Translation:
+                sample(sampler, false, t, v);
+                pose.translation = glm::vec3(v[0], v[1], v[2]);
+                break;
+            case Path::Rotation:
+                sample(sampler, true, t, v);
+                pose.rotation = glm::quat(v[3], v[0], v[1], v[2]);
+                break;
+            case Path::Scale:
+                sample(sampler, false, t, v);
+                pose.scale = glm::vec3(v[0], v[1], v[2]);
+                break;
+            case Path::Weights:
+                if (sampler.components == pose.weights.size())
+                    sample(sampler, false, t, pose.weights.data());
+                break;
+            }
+        }
+
+        for (const NodePose& pose : m_currentPoses)
+        {
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), pose.translation) * glm::toMat4(pose.rotation) * glm::scale(glm::mat4(1.0f), pose.scale);
+            m_sceneGraph.setLocalTransform(pose.node, local);
+        }
+        m_paramsChanged = true;
+    }
+    else if (!m_paramsChanged)
+    {
+        return;
+    }
+    m_sceneGraph.updateTransforms();
+
+    if (!m_animatedRecords.empty())
+    {
+        void* data;
+        if (m_instanceTable->map(&data))
+        {
+            InstanceRecord* records = static_cast<InstanceRecord*>(data);
+            for (const AnimatedRecord& r : m_animatedRecords)
+                records[r.record].transform = m_sceneGraph.getWorldTransform(r.node) * r.instanceTransform;
+            m_instanceTable->unmap();
+        }
+    }
+
+    if (m_deformed.empty())
+        return;
+
+    void* data;
+    if (!m_paramBuffer->map(&data))
+        return;
+    for (const DeformedInstance& inst : m_deformed)
+    {
+        unsigned char* params = static_cast<unsigned char*>(data) + inst.paramOffset;
+        // skinned vertices end up in joint space, the instance transform then places them, so it is taken out here
+        if (inst.skin >= 0)
+        {
+            const Skin& skin = m_skins[inst.skin];
+            glm::mat4 toInstance = glm::inverse(m_sceneGraph.getWorldTransform(inst.node));
+            for (size_t j = 0; j < skin.joints.size(); j++)
+            {
+                glm::mat4 jointMatrix = toInstance * m_sceneGraph.getWorldTransform(skin.joints[j]) * skin.inverseBindMatrices[j];
+                memcpy(params, &jointMatrix, sizeof(jointMatrix));
+                params += sizeof(jointMatrix);
+            }
+        }
+
+        int32_t pose = m_poseByNode[inst.node];
+        const std::vector<float>& weights = pose >= 0 && !m_currentPoses[pose].weights.empty() ? m_currentPoses[pose].weights : inst.weights;
+        memcpy(params, weights.data(), sizeof(float) * weights.size());
+    }
+    m_paramBuffer->unmap();
+}
+
+void Animator::recordDeform(vk::CommandBuffer& cmdBuf, vk::ComputePipeline& pipeline)
+{
+    if (!m_paramsChanged)
+        return;
+    m_paramsChanged = false;
+    if (m_deformed.empty())
+        return;
+
+    cmdBuf.bindComputePipeline(&pipeline);
+    VkDeviceAddress paramAddress = m_paramBuffer->getDeviceAddress();
+    for (const DeformedInstance& inst : m_deformed)
+    {
+        const Mesh& m = (*m_meshes)[inst.mesh];
+        size_t jointCount = inst.skin >= 0 ? m_skins[inst.skin].joints.size() : 0u;
+
+        DeformParams pc{};
+        pc.srcPositions = m.positionBuffer->getDeviceAddress();
+        pc.srcNormals = m.normalBuffer->getDeviceAddress();
+        pc.srcTangents = m.tangentBuffer->getDeviceAddress();
+        pc.joints = inst.skin >= 0 ? m.jointBuffer->getDeviceAddress() : 0u;
+        pc.weights = inst.skin >= 0 ? m.weightBuffer->getDeviceAddress() : 0u;
+        pc.morphTargets = m.morphTargetCount > 0u ? m.morphTargetBuffer->getDeviceAddress() : 0u;
+        pc.dstPositions = inst.positionBuffer->getDeviceAddress();
+        pc.dstNormals = inst.normalBuffer->getDeviceAddress();
+        pc.dstTangents = inst.tangentBuffer->getDeviceAddress();
+        pc.jointMatrices = paramAddress + inst.paramOffset;
+        pc.morphWeights = pc.jointMatrices + sizeof(glm::mat4) * jointCount;
+        pc.vertexCount = m.vertexCount;
+        pc.targetCount = m.morphTargetCount;
+
+        cmdBuf.pushConstants(&pc, sizeof(pc));
+        cmdBuf.dispatch((m.vertexCount + DEFORM_GROUP_SIZE - 1u) / DEFORM_GROUP_SIZE);
+    }
+
+    // deformed attributes are read like any mesh's, by vertex fetch, shaders or acceleration structure builds
+    cmdBuf.memoryBarrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "scene.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// plays glTF animations on a copy of the scene graph and deforms skinned and morphed instances on the device
+// built by the loading thread and handed over with the Geometry event, only the render thread touches it afterwards
+class Animator
+{
+public:
+    enum class Path
+    {
+        Translation,
+        Rotation,
+        Scale,
+        Weights,
+    };
+
+    enum class Interpolation
+    {
+        Linear,
+        Step,
+        CubicSpline,
+    };
+
+    // keyframe times and the values at them, cubic spline samplers store in-tangent, value, out-tangent per key
+    struct Sampler
+    {
+        Interpolation interpolation;
+        std::vector<float> times;
+        std::vector<float> values;
+        uint32_t components; // 3 for translation and scale, 4 for rotation, the node's target count for weights
+    };
+
+    struct Channel
+    {
+        uint32_t node; // scene graph node
+        Path path;
+        uint32_t sampler;
+    };
+
+    struct Animation
+    {
+        std::string name;
+        float duration;
+        std::vector<Sampler> samplers;
+        std::vector<Channel> channels;
+    };
+
+    // joints are scene graph nodes
+    struct Skin
+    {
+        std::vector<uint32_t> joints;
+        std::vector<glm::mat4> inverseBindMatrices;
+    };
+
+    // rest pose of an animated node, channels only replace the parts they target
+    struct NodePose
+    {
+        uint32_t node;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+        std::vector<float> weights;
+    };
+
+    // a mesh instance with its own deformed copy of the mesh's positions, normals and tangents
+    struct DeformedInstance
+    {
+        uint32_t node;
+        uint32_t mesh;
+        int32_t skin; // -1 if only morphed
+        std::vector<float> weights; // unless the node's pose animates them
+        std::shared_ptr<vk::Buffer> positionBuffer;
+        std::shared_ptr<vk::Buffer> normalBuffer;
+        std::shared_ptr<vk::Buffer> tangentBuffer;
+        // joint matrices followed by morph weights, in m_paramBuffer
+        VkDeviceSize paramOffset;
+    };
+
+    // extraUsage is added to the deformed buffers, e.g. to make them AS build inputs
+    Animator(VmaAllocator allocator, VkBufferUsageFlags extraUsage = 0u) : m_allocator(allocator), m_extraUsage(extraUsage) {}
+    Animator(const Animator&) = delete;
+
+    // creates the deformed buffers and the parameter buffer once the instances have been added
+    bool create(const std::vector<Mesh>& meshes);
+    // records is the first instance record of each scene graph node, ~0u for nodes without a mesh
+    // nodes with EXT_mesh_gpu_instancing have the count of records and the instance transforms given by instanceRanges
+    void setInstanceTable(std::shared_ptr<vk::Buffer> instanceTable, std::shared_ptr<const std::vector<Mesh>> meshes, const std::vector<uint32_t>& records,
+        const std::vector<std::pair<uint32_t, uint32_t>>& instanceRanges, const std::vector<glm::mat4>& instanceTransforms);
+
+    // samples the current animation at time seconds, looping, and writes the transforms, joint matrices and weights it yields
+    // the previous frame must have completed, the instance table and parameters are host visible and written in place
+    void update(float time);
+    // records the deformation of every deformed instance with pipeline (shaders/deform.comp) if update() changed their parameters
+    void recordDeform(vk::CommandBuffer& cmdBuf, vk::ComputePipeline& pipeline);
+
+    bool empty() const { return m_animations.empty() && m_deformed.empty(); }
+    // into the buffers of DeformedInstance, -1 if the node's instance reads its mesh as it is
+    int32_t getDeformedInstance(uint32_t node) const;
+
+    Animator& operator=(const Animator&) = delete;
+
+    // filled by the scene before create()
+    SceneGraph m_sceneGraph;
+    std::vector<Animation> m_animations;
+    std::vector<Skin> m_skins;
+    std::vector<NodePose> m_poses;
+    std::vector<DeformedInstance> m_deformed;
+    // played on update(), -1 plays none and leaves the rest pose
+    int32_t m_animation = 0;
+
+private:
+    VmaAllocator m_allocator;
+    VkBufferUsageFlags m_extraUsage;
+    std::unique_ptr<vk::Buffer> m_paramBuffer;
+    std::shared_ptr<vk::Buffer> m_instanceTable;
+    // the meshes the deformed instances read from
+    std::shared_ptr<const std::vector<Mesh>> m_meshes;
+    // per scene graph node, -1 if it has no pose or deformed instance
+    std::vector<int32_t> m_poseByNode;
+    std::vector<int32_t> m_deformedByNode;
+    // records of mesh nodes whose world transform an animation can change
+    struct AnimatedRecord
+    {
+        uint32_t node;
+        uint32_t record;
+        glm::mat4 instanceTransform; // relative to the node, EXT_mesh_gpu_instancing and the mesh's positionTransform
+    };
+    std::vector<AnimatedRecord> m_animatedRecords;
+    // the poses being sampled, kept to reuse their storage
+    std::vector<NodePose> m_currentPoses;
+    bool m_paramsChanged = false;
+
+    // writes sampler.components floats, rotations are interpolated as quaternions
+    void sample(const Sampler& sampler, bool rotation, float time, float* dst) const;
+};
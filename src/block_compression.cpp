@@ -0,0 +1,353 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+// calls encode(texels, dst) for every 4x4 block of every level, texels are 16 RGBA8 texels
+template <typename Encode>
+static void compressChain(unsigned char* dst, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, size_t blockSize, Encode encode)
+{
+    const unsigned char* level = chain;
+    for (uint32_t l = 0u; l < levelCount; l++)
+    {
+        unsigned char texels[16 * 4];
+        for (uint32_t by = 0u; by < height; by += 4u)
+        {
+            for (uint32_t bx = 0u; bx < width; bx += 4u)
+            {
+                for (uint32_t y = 0u; y < 4u; y++)
+                {
+                    const unsigned char* row = level + static_cast<size_t>(std::min(by + y, height - 1u)) * width * 4u;
+                    for (uint32_t x = 0u; x < 4u; x++)
+                        memcpy(texels + (y * 4u + x) * 4u, row + std::min(bx + x, width - 1u) * 4u, 4u);
+                }
+                encode(texels, dst);
+                dst += blockSize;
+            }
+        }
+
+        level += static_cast<size_t>(width) * height * 4u;
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+    }
+}
+
+// 8-value mode with red0 > red1, each texel takes the nearest of the 8 evenly spaced values between the block's extremes
+static void encodeBC4Block(const unsigned char* texels, uint32_t channel, unsigned char* dst)
+{
+    unsigned char values[16];
+    for (int i = 0; i < 16; i++)
+        values[i] = texels[i * 4 + channel];
+
+    unsigned char lo, hi;
+#ifdef BLOCK_COMPRESSION_SSE2
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+    __m128i vmin = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    __m128i vmax = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+    vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 4));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 2));
+    vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 2));
+    vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 1));
+    vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 1));
+    lo = static_cast<unsigned char>(_mm_cvtsi128_si32(vmin));
+    hi = static_cast<unsigned char>(_mm_cvtsi128_si32(vmax));
+#else
+    lo = *std::min_element(values, values + 16);
+    hi = *std::max_element(values, values + 16);
+#endif
+
+    // a flat block is all index 0, which decodes to red0 in either mode
+    dst[0] = hi;
+    dst[1] = lo;
+    uint64_t indices = 0u;
+    int range = hi - lo;
+    if (range > 0)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            // position 7 is red0, 0 is red1, 1 .. 6 are palette entries 7 .. 2
+            int pos = ((values[i] - lo) * 14 + range) / (2 * range);
+            uint64_t idx = pos == 7 ? 0u : pos == 0 ? 1u : static_cast<uint64_t>(8 - pos);
+            indices |= idx << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        dst[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+void compressBC5(unsigned char* dst, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t firstChannel)
+{
+    compressChain(dst, chain, width, height, levelCount, 16u, [firstChannel](const unsigned char* texels, unsigned char* block) {
+        encodeBC4Block(texels, firstChannel, block);
+        encodeBC4Block(texels, firstChannel + 1u, block + 8);
+    });
+}
+
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 7-bit endpoint plus the p-bit shared by its four channels
+struct BC7Endpoint
+{
+    int q[4];
+    int p;
+};
+
+static BC7Endpoint quantizeBC7Endpoint(const float e[4])
+{
+    BC7Endpoint best{};
+    float bestErr = 1e30f;
+    for (int p = 0; p < 2; p++)
+    {
+        BC7Endpoint ep;
+        ep.p = p;
+        float err = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            ep.q[c] = std::min(std::max(static_cast<int>(std::floor((e[c] - p) * 0.5f + 0.5f)), 0), 127);
+            float d = static_cast<float>((ep.q[c] << 1) | p) - e[c];
+            err += d * d;
+        }
+        if (err < bestErr)
+        {
+            bestErr = err;
+            best = ep;
+        }
+    }
+    return best;
+}
+
+// picks the nearest palette entry per texel, returns the summed squared error
+static int selectBC7Indices(const unsigned char* texels, const BC7Endpoint& e0, const BC7Endpoint& e1, int indices[16])
+{
+    int palette[16][4];
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            int a = (e0.q[c] << 1) | e0.p;
+            int b = (e1.q[c] << 1) | e1.p;
+            palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * a + BC7_WEIGHTS4[i] * b + 32) >> 6;
+        }
+    }
+
+    int total = 0;
+#ifdef BLOCK_COMPRESSION_SSE2
+    // palette as interleaved 16-bit RG and BA pairs, one madd gives r*r + g*g per entry
+    __m128i paletteRG[4], paletteBA[4];
+    for (int k = 0; k < 4; k++)
+    {
+        const int* e = palette[k * 4];
+        paletteRG[k] = _mm_setr_epi16(static_cast<short>(e[0]), static_cast<short>(e[1]), static_cast<short>(e[4]), static_cast<short>(e[5]), static_cast<short>(e[8]), static_cast<short>(e[9]), static_cast<short>(e[12]), static_cast<short>(e[13]));
+        paletteBA[k] = _mm_setr_epi16(static_cast<short>(e[2]), static_cast<short>(e[3]), static_cast<short>(e[6]), static_cast<short>(e[7]), static_cast<short>(e[10]), static_cast<short>(e[11]), static_cast<short>(e[14]), static_cast<short>(e[15]));
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        const unsigned char* t = texels + i * 4;
+        __m128i rg = _mm_set1_epi32(t[0] | (t[1] << 16));
+        __m128i ba = _mm_set1_epi32(t[2] | (t[3] << 16));
+        alignas(16) int errors[16];
+        for (int k = 0; k < 4; k++)
+        {
+            __m128i dRG = _mm_sub_epi16(rg, paletteRG[k]);
+            __m128i dBA = _mm_sub_epi16(ba, paletteBA[k]);
+            _mm_store_si128(reinterpret_cast<__m128i*>(errors + k * 4), _mm_add_epi32(_mm_madd_epi16(dRG, dRG), _mm_madd_epi16(dBA, dBA)));
+        }
+        int best = 0;
+        for (int j = 1; j < 16; j++)
+            best = errors[j] < errors[best] ? j : best;
+        indices[i] = best;
+        total += errors[best];
+    }
+#else
+    for (int i = 0; i < 16; i++)
+    {
+        const unsigned char* t = texels + i * 4;
+        int best = 0, bestErr = INT_MAX;
+        for (int j = 0; j < 16; j++)
+        {
+            int err = 0;
+            for (int c = 0; c < 4; c++)
+                err += (t[c] - palette[j][c]) * (t[c] - palette[j][c]);
+            if (err < bestErr)
+            {
+                bestErr = err;
+                best = j;
+            }
+        }
+        indices[i] = best;
+        total += bestErr;
+    }
+#endif
+    return total;
+}
+
+// least squares endpoints for fixed indices, false if every texel uses the same weight
+static bool refineBC7Endpoints(const unsigned char* texels, const int indices[16], float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float w = BC7_WEIGHTS4[indices[i]] / 64.0f;
+        aa += (1.0f - w) * (1.0f - w);
+        ab += (1.0f - w) * w;
+        bb += w * w;
+        for (int c = 0; c < 4; c++)
+        {
+            ax[c] += (1.0f - w) * texels[i * 4 + c];
+            bx[c] += w * texels[i * 4 + c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / det, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+// LSB first bit packing into a 128-bit block
+struct BlockWriter
+{
+    uint64_t bits[2] = {};
+    uint32_t pos = 0u;
+
+    void put(uint32_t value, uint32_t count)
+    {
+        if (pos < 64u)
+        {
+            bits[0] |= static_cast<uint64_t>(value) << pos;
+            if (pos + count > 64u)
+                bits[1] |= static_cast<uint64_t>(value) >> (64u - pos);
+        }
+        else
+        {
+            bits[1] |= static_cast<uint64_t>(value) << (pos - 64u);
+        }
+        pos += count;
+    }
+};
+
+static void encodeBC7Block(const unsigned char* texels, unsigned char* dst)
+{
+    // principal axis of the texels by power iteration on their covariance
+    float mean[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+            mean[c] += texels[i * 4 + c];
+    }
+    for (int c = 0; c < 4; c++)
+        mean[c] /= 16.0f;
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[4];
+        for (int c = 0; c < 4; c++)
+            d[c] = texels[i * 4 + c] - mean[c];
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 4; c++)
+                cov[r][c] += d[r] * d[c];
+        }
+    }
+
+    // starting from the column of the most varying channel can't be orthogonal to the principal axis
+    int start = 0;
+    for (int c = 1; c < 4; c++)
+        start = cov[c][c] > cov[start][start] ? c : start;
+    float axis[4] = { cov[0][start], cov[1][start], cov[2][start], cov[3][start] };
+    for (int it = 0; it < 8; it++)
+    {
+        float next[4] = {};
+        for (int r = 0; r < 4; r++)
+        {
+            for (int c = 0; c < 4; c++)
+                next[r] += cov[r][c] * axis[c];
+        }
+        float len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (len < 1e-6f)
+            break;
+        for (int c = 0; c < 4; c++)
+            axis[c] = next[c] / len;
+    }
+
+    float tMin = 0.0f, tMax = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < 4; c++)
+            t += (texels[i * 4 + c] - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+
+    float e0[4], e1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] = std::min(std::max(mean[c] + tMin * axis[c], 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + tMax * axis[c], 0.0f), 255.0f);
+    }
+
+    BC7Endpoint q0 = quantizeBC7Endpoint(e0);
+    BC7Endpoint q1 = quantizeBC7Endpoint(e1);
+    int indices[16];
+    int err = selectBC7Indices(texels, q0, q1, indices);
+
+    // one least squares pass on the chosen indices, kept only if it lowers the error
+    if (err > 0 && refineBC7Endpoints(texels, indices, e0, e1))
+    {
+        BC7Endpoint r0 = quantizeBC7Endpoint(e0);
+        BC7Endpoint r1 = quantizeBC7Endpoint(e1);
+        int refined[16];
+        if (selectBC7Indices(texels, r0, r1, refined) < err)
+        {
+            q0 = r0;
+            q1 = r1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // the anchor index has an implicit 0 MSB, swap the endpoints if texel 0 needs it set
+    if (indices[0] >= 8)
+    {
+        std::swap(q0, q1);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    BlockWriter writer;
+    writer.put(1u << 6, 7u);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.put(static_cast<uint32_t>(q0.q[c]), 7u);
+        writer.put(static_cast<uint32_t>(q1.q[c]), 7u);
+    }
+    writer.put(static_cast<uint32_t>(q0.p), 1u);
+    writer.put(static_cast<uint32_t>(q1.p), 1u);
+    writer.put(static_cast<uint32_t>(indices[0]), 3u);
+    for (int i = 1; i < 16; i++)
+        writer.put(static_cast<uint32_t>(indices[i]), 4u);
+
+    // blocks are little endian
+    for (int i = 0; i < 16; i++)
+        dst[i] = static_cast<unsigned char>(writer.bits[i / 8] >> (8 * (i % 8)));
+}
+
+void compressBC7(unsigned char* dst, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+    compressChain(dst, chain, width, height, levelCount, 16u, encodeBC7Block);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BCn compression of RGBA8 mip chains laid out as in mip_chain.h, the output is the same chain of 4x4 blocks
+// blocks are row major within each level, partial blocks at the right and bottom edges repeat the last texel
+
+// BC5, 16 bytes per block, source channels firstChannel and firstChannel + 1 become red and green
+void compressBC5(unsigned char* dst, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t firstChannel);
+// BC7, 16 bytes per block, mode 6 only (one subset, RGBA endpoints on the block's principal axis, 4-bit indices)
+void compressBC7(unsigned char* dst, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit xxHash (XXH64) of a byte range, used to find duplicate payloads while loading
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0u);
@@ -0,0 +1,81 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+
+GeometryRange::~GeometryRange()
+{
+    m_arena->release(m_block, m_allocation);
+}
+
+GeometryArena::~GeometryArena()
+{
+    // every range holds the arena, so none are left by now
+    for (Block& block : m_blocks)
+    {
+        if (block.buffer)
+            vmaDestroyVirtualBlock(block.virtualBlock);
+    }
+}
+
+std::shared_ptr<GeometryRange> GeometryArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VmaVirtualAllocationCreateInfo allocInfo{};
+    allocInfo.size = std::max<VkDeviceSize>(size, 1u);
+    allocInfo.alignment = alignment;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    VmaVirtualAllocation allocation;
+    VkDeviceSize offset;
+    for (uint32_t i = 0; i < m_blocks.size(); i++)
+    {
+        if (m_blocks[i].buffer && vmaVirtualAllocate(m_blocks[i].virtualBlock, &allocInfo, &allocation, &offset) == VK_SUCCESS)
+            return std::make_shared<GeometryRange>(shared_from_this(), i, allocation, m_blocks[i].buffer.get(), m_blocks[i].address, offset, size);
+    }
+
+    // every block is usable for whatever part of a mesh lands in it
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | m_extraUsage;
+    Block block;
+    block.buffer = std::make_unique<vk::Buffer>(m_allocator);
+    VkDeviceSize blockSize = std::max(m_blockSize, allocInfo.size);
+    if (!block.buffer->create(blockSize, usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u))
+    {
+        LOGE("Failed to create a geometry arena block of " + std::to_string(blockSize) + " bytes.");
+        return nullptr;
+    }
+    block.address = block.buffer->getDeviceAddress();
+
+    VmaVirtualBlockCreateInfo blockInfo{};
+    blockInfo.size = blockSize;
+    if (vmaCreateVirtualBlock(&blockInfo, &block.virtualBlock) != VK_SUCCESS)
+        return nullptr;
+    if (vmaVirtualAllocate(block.virtualBlock, &allocInfo, &allocation, &offset) != VK_SUCCESS)
+    {
+        vmaDestroyVirtualBlock(block.virtualBlock);
+        return nullptr;
+    }
+
+    uint32_t idx = 0u;
+    while (idx < m_blocks.size() && m_blocks[idx].buffer)
+        idx++;
+    if (idx == m_blocks.size())
+        m_blocks.push_back(std::move(block));
+    else
+        m_blocks[idx] = std::move(block);
+    return std::make_shared<GeometryRange>(shared_from_this(), idx, allocation, m_blocks[idx].buffer.get(), m_blocks[idx].address, offset, size);
+}
+
+void GeometryArena::release(uint32_t block, VmaVirtualAllocation allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Block& b = m_blocks[block];
+    vmaVirtualFree(b.virtualBlock, allocation);
+    // ranges are only released once nothing reads them, so the block's memory can go with its last one
+    if (vmaIsVirtualBlockEmpty(b.virtualBlock) == VK_TRUE)
+    {
+        vmaDestroyVirtualBlock(b.virtualBlock);
+        b.virtualBlock = VK_NULL_HANDLE;
+        b.buffer.reset();
+        b.address = 0u;
+    }
+}
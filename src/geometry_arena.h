@@ -0,0 +1,78 @@
+#pragma once
+
+#include "vk_graphics.h"
+
+#include <mutex>
+
+class GeometryArena;
+
+// a sub-allocation of one of the arena's blocks, handed back to the arena once the last owner lets go
+class GeometryRange
+{
+public:
+    GeometryRange(std::shared_ptr<GeometryArena> arena, uint32_t block, VmaVirtualAllocation allocation, const vk::Buffer* buffer, VkDeviceAddress blockAddress, VkDeviceSize offset, VkDeviceSize size)
+        : m_arena(std::move(arena)), m_block(block), m_allocation(allocation), m_buffer(buffer), m_blockAddress(blockAddress), m_offset(offset), m_size(size) {}
+    GeometryRange(const GeometryRange&) = delete;
+
+    ~GeometryRange();
+
+    // the block's buffer, bound or copied to at getOffset()
+    const vk::Buffer& getBuffer() const { return *m_buffer; }
+    VkDeviceSize getOffset() const { return m_offset; }
+    VkDeviceSize getSize() const { return m_size; }
+    VkDeviceAddress getDeviceAddress() const { return m_blockAddress + m_offset; }
+
+    GeometryRange& operator=(const GeometryRange&) = delete;
+
+private:
+    std::shared_ptr<GeometryArena> m_arena;
+    uint32_t m_block;
+    VmaVirtualAllocation m_allocation;
+    const vk::Buffer* m_buffer;
+    VkDeviceAddress m_blockAddress;
+    VkDeviceSize m_offset;
+    VkDeviceSize m_size;
+};
+
+// indices and every vertex attribute stream of a scene, sub-allocated from a few large device local buffers
+// so a draw or AS build over several meshes binds one buffer and only moves offsets
+// blocks are created as the arena fills up and freed once their last range is, freed ranges are reused by later allocations
+// allocate() and the release of ranges may happen on any thread
+class GeometryArena : public std::enable_shared_from_this<GeometryArena>
+{
+public:
+    // extraUsage is added to every block, e.g. to make them AS build inputs
+    GeometryArena(VmaAllocator allocator, VkBufferUsageFlags extraUsage = 0u, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE)
+        : m_allocator(allocator), m_extraUsage(extraUsage), m_blockSize(blockSize) {}
+    GeometryArena(const GeometryArena&) = delete;
+
+    ~GeometryArena();
+
+    // ranges larger than the block size get a block of their own, null if no block could be created
+    std::shared_ptr<GeometryRange> allocate(VkDeviceSize size, VkDeviceSize alignment = DEFAULT_ALIGNMENT);
+
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64u << 20;
+    // enough for either index type, vec4 attributes and buffer references with their default alignment
+    static const VkDeviceSize DEFAULT_ALIGNMENT = 16u;
+
+private:
+    friend class GeometryRange;
+
+    // freed blocks leave their slot empty (null buffer) so the indices ranges hold stay valid, new blocks take empty slots first
+    struct Block
+    {
+        std::unique_ptr<vk::Buffer> buffer;
+        VmaVirtualBlock virtualBlock;
+        VkDeviceAddress address;
+    };
+
+    VmaAllocator m_allocator;
+    VkBufferUsageFlags m_extraUsage;
+    VkDeviceSize m_blockSize;
+    std::mutex m_mutex;
+    std::vector<Block> m_blocks;
+
+    void release(uint32_t block, VmaVirtualAllocation allocation);
+};
@@ -0,0 +1,83 @@
+#include "ktx2.h"
+
+#include <cstring>
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// identifier, 9 header fields, the DFD/KVD/SGD index, then one level index entry per level
+struct Ktx2Header
+{
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80u, "Ktx2Header must match the KTX2 file layout");
+
+struct Ktx2LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+bool isKtx2(const unsigned char* data, size_t size)
+{
+    return size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool parseKtx2(const unsigned char* data, size_t size, Ktx2Image& image, std::string& error)
+{
+    Ktx2Header header;
+    if (!isKtx2(data, size) || size < sizeof(header))
+    {
+        error = "not a KTX2 file.";
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.pixelWidth == 0u || header.pixelHeight == 0u || header.pixelDepth > 1u || header.layerCount > 1u || header.faceCount != 1u)
+    {
+        error = "only 2D KTX2 textures without layers or faces are supported.";
+        return false;
+    }
+
+    // a level count of 0 asks the loader to generate the mips
+    uint32_t levelCount = header.levelCount > 0u ? header.levelCount : 1u;
+    if (levelCount > 32u || size < sizeof(header) + levelCount * sizeof(Ktx2LevelIndex))
+    {
+        error = "truncated KTX2 level index.";
+        return false;
+    }
+
+    image.format = static_cast<VkFormat>(header.vkFormat);
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.supercompressionScheme = header.supercompressionScheme;
+    image.levels.resize(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        Ktx2LevelIndex level;
+        memcpy(&level, data + sizeof(header) + i * sizeof(level), sizeof(level));
+        if (level.byteOffset > size || level.byteLength > size - level.byteOffset)
+        {
+            error = "KTX2 level " + std::to_string(i) + " lies outside the file.";
+            return false;
+        }
+        image.levels[i] = { level.byteOffset, level.byteLength };
+    }
+
+    return true;
+}
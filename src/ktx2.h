@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// KTX2 container header and level index, level data stays in the caller's bytes
+// only single layer, single face 2D textures are accepted
+struct Ktx2Image
+{
+    struct Level
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    VkFormat format; // VK_FORMAT_UNDEFINED for Basis Universal payloads
+    uint32_t width;
+    uint32_t height;
+    uint32_t supercompressionScheme; // 0 none, 1 BasisLZ, 2 Zstandard, 3 ZLIB
+    std::vector<Level> levels; // level 0 first, a container asking for generated mips has just level 0
+};
+
+bool isKtx2(const unsigned char* data, size_t size);
+bool parseKtx2(const unsigned char* data, size_t size, Ktx2Image& image, std::string& error);
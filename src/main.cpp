@@ -1,11 +1,53 @@
 #include "renderer.h"
+#include "scene_pack.h"
 
 // TODO make configurable
 #define WINDOW_WIDTH 2560
 #define WINDOW_HEIGHT 1440
 
-int main()
+// scene units per second
+static const float VIEW_SPEED = 5.0f;
+
+int main(int argc, char** argv)
 {
+    // --record-calls prints the count and CPU time of every Vulkan call made while loading and rendering
+    // --null-commands also drops all command recording calls, --frames <n> exits after n frames
+    // both still need a Vulkan device and a display, without a GPU lavapipe or SwiftShader is picked
+    // --scene <file> picks the glTF/GLB/.craypack to load, --bake <gltf> <craypack> converts offline and exits
+    // --lazy only loads what the glTF's default scene reaches, keys 1-9 then switch to its other scenes
+    // R reloads the glTF file, only what changed in it is uploaded again
+    // --stream-budget <MiB> keeps glTF geometry under that much device memory, streaming meshes in by distance to the view
+    // WASD moves the view position streaming is prioritized by over the XZ plane, Q and E lower and raise it
+    // --compress-vertices packs static glTF meshes' normals, tangents and uvs into 12 bytes and their indices into 16 bits where possible
+    // --quantize-positions also stores their positions as snorm16, implies --compress-vertices
+    int frameLimit = -1;
+    bool lazy = false;
+    VkDeviceSize geometryBudget = 0u;
+    bool compressVertices = false;
+    bool quantizePositions = false;
+    std::string sceneFilename = "assets/scenes/FlightHelmet/FlightHelmet.gltf";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bake") == 0 && i + 2 < argc)
+            return pack::bakeScenePack(argv[i + 1], argv[i + 2]) ? 0 : 1;
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            sceneFilename = argv[++i];
+        else if (strcmp(argv[i], "--record-calls") == 0)
+            vk::CallRecorder::s_enabled = true;
+        else if (strcmp(argv[i], "--null-commands") == 0)
+            vk::CallRecorder::s_enabled = vk::CallRecorder::s_null = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameLimit = std::stoi(argv[++i]);
+        else if (strcmp(argv[i], "--lazy") == 0)
+            lazy = true;
+        else if (strcmp(argv[i], "--stream-budget") == 0 && i + 1 < argc)
+            geometryBudget = static_cast<VkDeviceSize>(std::stoull(argv[++i])) << 20;
+        else if (strcmp(argv[i], "--compress-vertices") == 0)
+            compressVertices = true;
+        else if (strcmp(argv[i], "--quantize-positions") == 0)
+            compressVertices = quantizePositions = true;
+    }
+
     int res = glfwInit();
     if (res == GLFW_FALSE)
     {
@@ -22,7 +64,9 @@ int main()
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
     vk::Instance instance;
-    instance.m_enabledLayers.push_back("VK_LAYER_KHRONOS_validation");
+    // validation would dominate the recorded call times
+    if (!vk::CallRecorder::s_enabled)
+        instance.m_enabledLayers.push_back("VK_LAYER_KHRONOS_validation");
     for (uint32_t i = 0; i < glfwExtensionCount; i++)
         instance.m_enabledExtensions.push_back(glfwExtensions[i]);
 
@@ -33,20 +77,52 @@ int main()
     }
 
     vk::Device gpu(&instance);
+    // --device <index|uuid> overrides the automatic physical device selection
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--device") != 0)
+            continue;
+
+        std::string sel(argv[i + 1]);
+        if (!sel.empty() && sel.find_first_not_of("0123456789") == std::string::npos)
+            gpu.m_physicalDeviceIndex = std::stoi(sel);
+        else
+            gpu.m_physicalDeviceUUID = sel;
+    }
     VkPhysicalDeviceSynchronization2Features sync2Features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES };
     sync2Features.synchronization2 = VK_TRUE;
     VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES };
     dynamicRenderFeatures.dynamicRendering = VK_TRUE;
     dynamicRenderFeatures.pNext = &sync2Features;
-    gpu.m_enabledFeatures.pNext = &dynamicRenderFeatures;
+    VkPhysicalDeviceBufferDeviceAddressFeatures bufferAddressFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES };
+    bufferAddressFeatures.bufferDeviceAddress = VK_TRUE;
+    bufferAddressFeatures.pNext = &dynamicRenderFeatures;
+    gpu.m_enabledFeatures.pNext = &bufferAddressFeatures;
+    // scene textures are BC compressed on import where supported, the scene checks the enabled feature
+    gpu.m_optionalFeatures.textureCompressionBC = VK_TRUE;
 
     gpu.m_queueRequirements.push_back({ VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT, 1u });
     gpu.m_enabledExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-    gpu.m_enabledExtensions.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
-    gpu.m_enabledExtensions.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
     gpu.m_enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
-    gpu.m_enabledExtensions.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
-    gpu.m_enabledExtensions.push_back(VK_KHR_RAY_TRACING_POSITION_FETCH_EXTENSION_NAME);
+
+    // ray tracing is optional so software devices (lavapipe, SwiftShader) can run the rasterized path
+    // support for each extension implies support for the ones it depends on, listed before it
+    // ray tracing work has to check Device::isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) first
+    VkPhysicalDeviceAccelerationStructureFeaturesKHR ASFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR };
+    ASFeatures.accelerationStructure = VK_TRUE;
+    VkPhysicalDeviceRayTracingPipelineFeaturesKHR RTPipelineFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR };
+    RTPipelineFeatures.rayTracingPipeline = VK_TRUE;
+    VkPhysicalDeviceRayTracingPositionFetchFeaturesKHR positionFetchFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_POSITION_FETCH_FEATURES_KHR };
+    positionFetchFeatures.rayTracingPositionFetch = VK_TRUE;
+    gpu.m_optionalExtensions.push_back({ VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME, nullptr });
+    gpu.m_optionalExtensions.push_back({ VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, &ASFeatures });
+    gpu.m_optionalExtensions.push_back({ VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, &RTPipelineFeatures });
+    gpu.m_optionalExtensions.push_back({ VK_KHR_RAY_TRACING_POSITION_FETCH_EXTENSION_NAME, &positionFetchFeatures });
+
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT };
+    hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+    gpu.m_optionalExtensions.push_back({ VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME, &hostImageCopyFeatures });
+    gpu.m_optionalExtensions.push_back({ VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, nullptr });
 
     if (!gpu.create())
     {
@@ -70,17 +146,106 @@ int main()
         return 1;
     }
 
-    while (!glfwWindowShouldClose(window))
+    if (vk::CallRecorder::s_enabled)
+        vk::CallRecorder::report("init");
+
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    bool binary = sceneFilename.size() >= 4u && sceneFilename.compare(sceneFilename.size() - 4u, 4u, ".glb") == 0;
+    if (!renderer.loadScene(sceneFilename, binary, lazy, geometryBudget, compressVertices, quantizePositions))
+    {
+        LOGE("Failed to load scene.");
+        return 1;
+    }
+
+    // the scene loads in the background, frames show whatever is resident so far
+    bool loadFailed = false;
+    bool switchingScene = false;
+    int pressedKey = -1;
+    Renderer::LoadState loadState = Renderer::LoadState::Loading;
+    int frameCount = 0;
+    glm::vec3 viewPosition(0.0f);
+    std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point frameStart = renderStart;
+    while (!glfwWindowShouldClose(window) && frameCount != frameLimit)
     {
         glfwPollEvents();
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        float step = VIEW_SPEED * std::chrono::duration<float>(now - frameStart).count();
+        frameStart = now;
+        glm::vec3 move(0.0f);
+        move.x = (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS ? 1.0f : 0.0f) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS ? 1.0f : 0.0f);
+        move.y = (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS ? 1.0f : 0.0f) - (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS ? 1.0f : 0.0f);
+        move.z = (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS ? 1.0f : 0.0f) - (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS ? 1.0f : 0.0f);
+        viewPosition += step * move;
+        // the streamer only wakes up when the position actually changed
+        renderer.setViewPosition(viewPosition);
+
         if (!renderer.render())
         {
             LOGE("Failed to render frame.");
             break;
         }
+        frameCount++;
+
+        // keys act once when pressed, not on every frame they are held
+        if (pressedKey >= 0 && glfwGetKey(window, pressedKey) == GLFW_RELEASE)
+            pressedKey = -1;
+        if (loadState != Renderer::LoadState::Loading && pressedKey < 0)
+        {
+            bool started = false;
+            if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+            {
+                pressedKey = GLFW_KEY_R;
+                started = renderer.reloadScene();
+            }
+            for (int key = GLFW_KEY_1; lazy && pressedKey < 0 && key <= GLFW_KEY_9; key++)
+            {
+                if (glfwGetKey(window, key) == GLFW_PRESS)
+                {
+                    pressedKey = key;
+                    started = renderer.selectScene(key - GLFW_KEY_1);
+                }
+            }
+            if (started)
+            {
+                switchingScene = true;
+                loadState = Renderer::LoadState::Loading;
+                loadStart = std::chrono::steady_clock::now();
+            }
+        }
+
+        if (loadState == Renderer::LoadState::Loading && renderer.getLoadState() != loadState)
+        {
+            loadState = renderer.getLoadState();
+            // a failed switch or reload keeps showing the previous scene
+            if (loadState == Renderer::LoadState::Failed && switchingScene)
+            {
+                LOGE("Failed to switch or reload scene.");
+                continue;
+            }
+            if (loadState == Renderer::LoadState::Failed)
+            {
+                LOGE("Failed to load scene.");
+                loadFailed = true;
+                break;
+            }
+            if (vk::CallRecorder::s_enabled)
+            {
+                // the calls of the frames rendered meanwhile are included
+                LOG("Scene loaded in " + std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()) + " ms, " + std::to_string(frameCount) + " frames rendered meanwhile.");
+                vk::CallRecorder::report("scene load");
+            }
+        }
     }
     gpu.waitIdle();
+    if (vk::CallRecorder::s_enabled && frameCount > 0)
+    {
+        LOG("Rendered " + std::to_string(frameCount) + " frames, " + std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count() / frameCount) + " ms per frame.");
+        vk::CallRecorder::report(std::to_string(frameCount) + " frames");
+    }
 
     glfwDestroyWindow(window);
     glfwTerminate();
+    return loadFailed ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+// read-only mapping of a whole file, pages are only read from disk when first touched
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    bool open(const std::string& filename);
+    void close();
+    const unsigned char* getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+
+    static size_t getPageSize();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0u;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
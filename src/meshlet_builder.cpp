@@ -0,0 +1,183 @@
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint8_t NO_SLOT = 0xffu;
+
+// sphere around the box of the meshlet's vertices, then the cone of its non degenerate triangle normals
+static Meshlet meshletBounds(const glm::vec3* positions, const uint32_t* vertices, uint32_t vertexCount, const uint8_t* triangles, uint32_t triangleCount)
+{
+    Meshlet m{};
+    glm::vec3 lo = positions[vertices[0]];
+    glm::vec3 hi = lo;
+    for (uint32_t v = 1u; v < vertexCount; v++)
+    {
+        lo = glm::min(lo, positions[vertices[v]]);
+        hi = glm::max(hi, positions[vertices[v]]);
+    }
+    m.center = 0.5f * (lo + hi);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        m.radius = std::max(m.radius, glm::length(positions[vertices[v]] - m.center));
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangleCount);
+    glm::vec3 sum(0.0f);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        glm::vec3 a = positions[vertices[triangles[3u * t]]];
+        glm::vec3 b = positions[vertices[triangles[3u * t + 1u]]];
+        glm::vec3 c = positions[vertices[triangles[3u * t + 2u]]];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float area = glm::length(n);
+        if (area <= 0.0f)
+            continue;
+        normals.push_back(n / area);
+        sum += normals.back();
+    }
+
+    m.coneAxis = glm::vec3(0.0f);
+    m.coneCutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if (normals.empty() || sumLength <= 0.0f)
+        return m;
+
+    glm::vec3 axis = sum / sumLength;
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+        minDot = std::min(minDot, glm::dot(axis, n));
+    // a cone of 90 degrees or wider always has a triangle facing the viewer
+    if (minDot <= 0.0f)
+        return m;
+
+    m.coneAxis = axis;
+    m.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+    return m;
+}
+
+bool buildMeshlets(const glm::vec3* positions, uint32_t vertexCount, const uint32_t* indices, size_t indexCount, MeshletSet& out)
+{
+    out.meshlets.clear();
+    out.vertices.clear();
+    out.triangles.clear();
+    size_t triangleCount = indexCount / 3u;
+    for (size_t i = 0; i < 3u * triangleCount; i++)
+    {
+        if (indices[i] >= vertexCount)
+            return false;
+    }
+
+    // triangles around each vertex, in index order
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1u, 0u);
+    for (size_t i = 0; i < 3u * triangleCount; i++)
+        adjacencyOffsets[indices[i] + 1u]++;
+    for (uint32_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1u] += adjacencyOffsets[v];
+    std::vector<uint32_t> adjacency(3u * triangleCount);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < 3u * triangleCount; i++)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3u);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    // the vertex's index in the meshlet being grown, NO_SLOT if it isn't in it
+    std::vector<uint8_t> slots(vertexCount, NO_SLOT);
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+    std::vector<uint32_t> candidates;
+    size_t scan = 0u;
+
+    auto newVertexCount = [&](uint32_t t) {
+        uint32_t a = indices[3u * t], b = indices[3u * t + 1u], c = indices[3u * t + 2u];
+        return (slots[a] == NO_SLOT ? 1u : 0u) + (slots[b] == NO_SLOT && b != a ? 1u : 0u) + (slots[c] == NO_SLOT && c != a && c != b ? 1u : 0u);
+    };
+
+    auto flush = [&]() {
+        if (triangles.empty())
+            return;
+
+        Meshlet m = meshletBounds(positions, vertices.data(), static_cast<uint32_t>(vertices.size()), triangles.data(), static_cast<uint32_t>(triangles.size() / 3u));
+        m.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+        m.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+        m.vertexCount = static_cast<uint32_t>(vertices.size());
+        m.triangleCount = static_cast<uint32_t>(triangles.size() / 3u);
+        out.meshlets.push_back(m);
+        out.vertices.insert(out.vertices.end(), vertices.begin(), vertices.end());
+        out.triangles.insert(out.triangles.end(), triangles.begin(), triangles.end());
+        out.triangles.resize((out.triangles.size() + 3u) & ~size_t(3u), 0u);
+
+        for (uint32_t v : vertices)
+            slots[v] = NO_SLOT;
+        vertices.clear();
+        triangles.clear();
+        candidates.clear();
+    };
+
+    for (;;)
+    {
+        // the first candidate adding the fewest vertices, emitted ones are dropped on the way
+        uint32_t best = ~0u;
+        uint32_t bestNew = 4u;
+        size_t kept = 0u;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            uint32_t t = candidates[i];
+            if (emitted[t])
+                continue;
+            candidates[kept++] = t;
+            uint32_t added = newVertexCount(t);
+            if (added < bestNew && vertices.size() + added <= MESHLET_MAX_VERTICES)
+            {
+                best = t;
+                bestNew = added;
+            }
+        }
+        candidates.resize(kept);
+
+        // nothing adjacent fits, carry on with the next triangle in index order so disconnected pieces still share meshlets
+        if (best == ~0u)
+        {
+            while (scan < triangleCount && emitted[scan])
+                scan++;
+            if (scan == triangleCount)
+                break;
+            best = static_cast<uint32_t>(scan);
+            if (vertices.size() + newVertexCount(best) > MESHLET_MAX_VERTICES)
+            {
+                flush();
+                continue;
+            }
+        }
+
+        emitted[best] = true;
+        for (uint32_t k = 0; k < 3u; k++)
+        {
+            uint32_t v = indices[3u * best + k];
+            if (slots[v] == NO_SLOT)
+            {
+                slots[v] = static_cast<uint8_t>(vertices.size());
+                vertices.push_back(v);
+                for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1u]; a++)
+                {
+                    if (!emitted[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+                }
+            }
+            triangles.push_back(slots[v]);
+        }
+
+        if (triangles.size() == 3u * MESHLET_MAX_TRIANGLES)
+            flush();
+    }
+    flush();
+    return true;
+}
+
+// every point p of the meshlet is within radius of center and every normal within the cone's half angle of its axis
+// so the view direction to p makes less than 90 degrees with every normal once dot(p - view, axis) > coneCutoff * |p - view|
+bool meshletBackfacing(const Meshlet& meshlet, const glm::vec3& viewPosition)
+{
+    glm::vec3 d = meshlet.center - viewPosition;
+    return glm::dot(d, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(d) + meshlet.radius * (1.0f + meshlet.coneCutoff);
+}
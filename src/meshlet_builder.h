@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// splits triangle lists into meshlets for cluster culling and mesh shading
+// the result only depends on the input, meshes can be built on any thread
+
+const uint32_t MESHLET_MAX_VERTICES = 64u;
+const uint32_t MESHLET_MAX_TRIANGLES = 124u;
+
+// std430 compatible, bounds and cone are in the mesh's object space
+struct Meshlet
+{
+    glm::vec3 center;
+    float radius;
+    // every triangle's normal is within the cone around coneAxis, coneCutoff is the sine of its half angle
+    // a zero axis with a cutoff of 1 marks meshlets whose triangles face too many ways for the cone to cull them
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    uint32_t vertexOffset; // into MeshletSet::vertices
+    uint32_t triangleOffset; // into MeshletSet::triangles, in bytes, always a multiple of 4
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 48u, "Meshlet must match its std430 layout");
+
+struct MeshletSet
+{
+    std::vector<Meshlet> meshlets;
+    // mesh vertex index of every meshlet vertex
+    std::vector<uint32_t> vertices;
+    // three meshlet vertex indices per triangle, each meshlet's run padded to 4 bytes
+    std::vector<uint8_t> triangles;
+};
+
+// greedily grows each meshlet over triangles sharing its vertices, taking the ones adding the fewest new vertices first
+// false if an index is out of range
+bool buildMeshlets(const glm::vec3* positions, uint32_t vertexCount, const uint32_t* indices, size_t indexCount, MeshletSet& out);
+
+// true if no triangle of the meshlet can face a viewer at viewPosition (object space), conservative
+bool meshletBackfacing(const Meshlet& meshlet, const glm::vec3& viewPosition);
@@ -0,0 +1,499 @@
+#include "meshopt_decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHOPT_DECODE_SSE2
+#include <emmintrin.h>
+#endif
+
+// vertex data is split into blocks of up to 256 vertices, each byte of the vertex is stored per block as groups of 16 deltas
+static const unsigned char VERTEX_HEADER = 0xA0;
+static const size_t VERTEX_BLOCK_BYTES = 8192u;
+static const size_t VERTEX_BLOCK_MAX_COUNT = 256u;
+static const size_t BYTE_GROUP_SIZE = 16u;
+// longest byte group (4-bit selectors and 16 literals), checked before each group is read
+static const size_t BYTE_GROUP_MAX_BYTES = 24u;
+// the first vertex closes the stream, padded to at least 32 bytes
+static const size_t VERTEX_TAIL_MIN_BYTES = 32u;
+
+static const unsigned char TRIANGLES_HEADER = 0xE0;
+static const unsigned char INDICES_HEADER = 0xD0;
+
+bool parseMeshoptMode(const std::string& name, MeshoptMode& mode)
+{
+    if (name == "ATTRIBUTES")
+        mode = MeshoptMode::Attributes;
+    else if (name == "TRIANGLES")
+        mode = MeshoptMode::Triangles;
+    else if (name == "INDICES")
+        mode = MeshoptMode::Indices;
+    else
+        return false;
+    return true;
+}
+
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter)
+{
+    if (name.empty() || name == "NONE")
+        filter = MeshoptFilter::None;
+    else if (name == "OCTAHEDRAL")
+        filter = MeshoptFilter::Octahedral;
+    else if (name == "QUATERNION")
+        filter = MeshoptFilter::Quaternion;
+    else if (name == "EXPONENTIAL")
+        filter = MeshoptFilter::Exponential;
+    else
+        return false;
+    return true;
+}
+
+// 16 values of 0, 2, 4 or 8 bits, MSB first, 2 and 4 bit values of all ones are escapes for literal bytes following the selectors
+static const unsigned char* decodeBytesGroup(const unsigned char* data, unsigned char* dst, uint32_t bitsLog2)
+{
+    if (bitsLog2 == 0u)
+    {
+        memset(dst, 0, BYTE_GROUP_SIZE);
+        return data;
+    }
+    if (bitsLog2 == 3u)
+    {
+        memcpy(dst, data, BYTE_GROUP_SIZE);
+        return data + BYTE_GROUP_SIZE;
+    }
+
+    uint32_t bits = 1u << bitsLog2;
+    uint32_t escape = (1u << bits) - 1u;
+    const unsigned char* literals = data + 2u * bits;
+    for (uint32_t i = 0u; i < BYTE_GROUP_SIZE; i++)
+    {
+        uint32_t value = (data[i * bits / 8u] >> (8u - bits - (i * bits) % 8u)) & escape;
+        dst[i] = value == escape ? *literals++ : static_cast<unsigned char>(value);
+    }
+    return literals;
+}
+
+// one byte of every vertex in the block, groupCount groups with their 2-bit sizes up front
+static const unsigned char* decodeBytes(const unsigned char* data, const unsigned char* end, unsigned char* dst, size_t groupCount)
+{
+    const unsigned char* header = data;
+    size_t headerSize = (groupCount + 3u) / 4u;
+    if (static_cast<size_t>(end - data) < headerSize)
+        return nullptr;
+    data += headerSize;
+
+    for (size_t g = 0; g < groupCount; g++)
+    {
+        if (static_cast<size_t>(end - data) < BYTE_GROUP_MAX_BYTES)
+            return nullptr;
+        uint32_t bitsLog2 = (header[g / 4u] >> ((g % 4u) * 2u)) & 3u;
+        data = decodeBytesGroup(data, dst + g * BYTE_GROUP_SIZE, bitsLog2);
+    }
+    return data;
+}
+
+// zigzag deltas against the previous vertex, lastVertex carries over between blocks
+static const unsigned char* decodeVertexBlock(const unsigned char* data, const unsigned char* end, unsigned char* dst, size_t count, size_t byteStride, unsigned char* lastVertex)
+{
+    unsigned char deltas[VERTEX_BLOCK_MAX_COUNT];
+    size_t groupCount = (count + BYTE_GROUP_SIZE - 1u) / BYTE_GROUP_SIZE;
+    for (size_t k = 0; k < byteStride; k++)
+    {
+        data = decodeBytes(data, end, deltas, groupCount);
+        if (!data)
+            return nullptr;
+
+        unsigned char prev = lastVertex[k];
+        for (size_t g = 0; g < groupCount; g++)
+        {
+            unsigned char* group = deltas + g * BYTE_GROUP_SIZE;
+#ifdef MESHOPT_DECODE_SSE2
+            // unzigzag, then a prefix sum over the 16 bytes in four shifted adds
+            const __m128i one = _mm_set1_epi8(1);
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+            __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one));
+            v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x7F)), sign);
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(prev)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(group), v);
+            prev = group[BYTE_GROUP_SIZE - 1u];
+#else
+            for (size_t i = 0; i < BYTE_GROUP_SIZE; i++)
+            {
+                unsigned char delta = static_cast<unsigned char>((group[i] >> 1) ^ (0u - (group[i] & 1u)));
+                prev = group[i] = static_cast<unsigned char>(prev + delta);
+            }
+#endif
+        }
+
+        for (size_t i = 0; i < count; i++)
+            dst[i * byteStride + k] = deltas[i];
+    }
+
+    memcpy(lastVertex, dst + (count - 1u) * byteStride, byteStride);
+    return data;
+}
+
+static bool decodeAttributes(unsigned char* dst, size_t count, size_t byteStride, const unsigned char* src, size_t srcSize)
+{
+    const unsigned char* end = src + srcSize;
+    size_t tailSize = std::max(byteStride, VERTEX_TAIL_MIN_BYTES);
+    if (srcSize < 1u + tailSize || src[0] != VERTEX_HEADER)
+        return false;
+
+    unsigned char lastVertex[256];
+    memcpy(lastVertex, end - byteStride, byteStride);
+
+    size_t blockSize = std::min((VERTEX_BLOCK_BYTES / byteStride) & ~(BYTE_GROUP_SIZE - 1u), VERTEX_BLOCK_MAX_COUNT);
+    const unsigned char* data = src + 1;
+    for (size_t offset = 0; offset < count; offset += blockSize)
+    {
+        data = decodeVertexBlock(data, end, dst + offset * byteStride, std::min(blockSize, count - offset), byteStride, lastVertex);
+        if (!data)
+            return false;
+    }
+
+    return static_cast<size_t>(end - data) == tailSize;
+}
+
+static void writeIndex(unsigned char* dst, size_t i, size_t indexSize, uint32_t index)
+{
+    if (indexSize == 2u)
+    {
+        uint16_t index16 = static_cast<uint16_t>(index);
+        memcpy(dst + i * 2u, &index16, 2u);
+    }
+    else
+    {
+        memcpy(dst + i * 4u, &index, 4u);
+    }
+}
+
+// LEB128 style, at most 5 bytes
+static uint32_t decodeVByte(const unsigned char*& data)
+{
+    unsigned char lead = *data++;
+    if (lead < 128u)
+        return lead;
+
+    uint32_t result = lead & 127u;
+    uint32_t shift = 7u;
+    for (int i = 0; i < 4; i++)
+    {
+        unsigned char group = *data++;
+        result |= static_cast<uint32_t>(group & 127u) << shift;
+        shift += 7u;
+        if (group < 128u)
+            break;
+    }
+    return result;
+}
+
+static uint32_t decodeZigzag(uint32_t v)
+{
+    return (v >> 1) ^ (0u - (v & 1u));
+}
+
+// free indices are zigzag deltas against the previous free index
+static uint32_t decodeIndex(const unsigned char*& data, uint32_t last)
+{
+    return last + decodeZigzag(decodeVByte(data));
+}
+
+// each triangle is a code byte referencing a 16 entry edge FIFO and a 16 entry vertex FIFO, or a new vertex, or explicitly encoded indices
+// the encoder mirrors every FIFO push exactly, so they must not be reordered
+static bool decodeTriangles(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t srcSize)
+{
+    if (count % 3u != 0u || srcSize < 1u + count / 3u + 16u || (src[0] & 0xF0u) != TRIANGLES_HEADER || (src[0] & 0x0Fu) > 1u)
+        return false;
+    // version 1 spends codes 13 and 14 on free indices one below and above the last one
+    uint32_t fecMax = (src[0] & 0x0Fu) >= 1u ? 13u : 15u;
+
+    uint32_t edgeFifo[16][2];
+    uint32_t vertexFifo[16];
+    memset(edgeFifo, 0xFF, sizeof(edgeFifo));
+    memset(vertexFifo, 0xFF, sizeof(vertexFifo));
+    uint32_t edgeOffset = 0u, vertexOffset = 0u;
+    auto pushEdge = [&](uint32_t a, uint32_t b) {
+        edgeFifo[edgeOffset][0] = a;
+        edgeFifo[edgeOffset][1] = b;
+        edgeOffset = (edgeOffset + 1u) & 15u;
+    };
+    auto pushVertex = [&](uint32_t v, bool cond) {
+        vertexFifo[vertexOffset] = v;
+        vertexOffset = (vertexOffset + (cond ? 1u : 0u)) & 15u;
+    };
+
+    uint32_t next = 0u, last = 0u;
+    const unsigned char* code = src + 1;
+    const unsigned char* data = code + count / 3u;
+    // a 16 byte table of common aux codes closes the stream, one triangle reads at most 16 bytes so stopping there keeps reads in range
+    const unsigned char* dataSafeEnd = src + srcSize - 16u;
+    const unsigned char* codeAuxTable = dataSafeEnd;
+
+    for (size_t i = 0; i < count; i += 3u)
+    {
+        if (data > dataSafeEnd)
+            return false;
+
+        uint32_t a, b, c;
+        unsigned char codeTri = *code++;
+        if (codeTri < 0xF0u)
+        {
+            // edge from the FIFO, third vertex from the vertex FIFO, new or free
+            uint32_t fe = codeTri >> 4;
+            a = edgeFifo[(edgeOffset - 1u - fe) & 15u][0];
+            b = edgeFifo[(edgeOffset - 1u - fe) & 15u][1];
+            uint32_t fec = codeTri & 15u;
+            if (fec < fecMax)
+            {
+                c = fec == 0u ? next++ : vertexFifo[(vertexOffset - 1u - fec) & 15u];
+                pushVertex(c, fec == 0u);
+            }
+            else
+            {
+                last = c = fec != 15u ? last + (fec == 13u ? ~0u : 1u) : decodeIndex(data, last);
+                pushVertex(c, true);
+            }
+            pushEdge(c, b);
+            pushEdge(a, c);
+        }
+        else
+        {
+            // no shared edge, the aux byte comes from the table or follows in the data
+            uint32_t codeAux = codeTri < 0xFEu ? codeAuxTable[codeTri & 15u] : *data++;
+            uint32_t feb = codeAux >> 4;
+            uint32_t fec = codeAux & 15u;
+            bool freeA = codeTri == 0xFFu;
+            if (codeTri == 0xFEu && codeAux == 0u)
+                next = 0u;
+
+            // next is advanced for all three vertices before free indices are decoded, as the encoder does
+            a = freeA ? 0u : next++;
+            b = feb == 0u ? next++ : vertexFifo[(vertexOffset - feb) & 15u];
+            c = fec == 0u ? next++ : vertexFifo[(vertexOffset - fec) & 15u];
+            if (codeTri >= 0xFEu)
+            {
+                if (freeA)
+                    last = a = decodeIndex(data, last);
+                if (feb == 15u)
+                    last = b = decodeIndex(data, last);
+                if (fec == 15u)
+                    last = c = decodeIndex(data, last);
+            }
+
+            pushVertex(a, true);
+            pushVertex(b, feb == 0u || (codeTri >= 0xFEu && feb == 15u));
+            pushVertex(c, fec == 0u || (codeTri >= 0xFEu && fec == 15u));
+            pushEdge(b, a);
+            pushEdge(c, b);
+            pushEdge(a, c);
+        }
+
+        writeIndex(dst, i + 0u, indexSize, a);
+        writeIndex(dst, i + 1u, indexSize, b);
+        writeIndex(dst, i + 2u, indexSize, c);
+    }
+
+    return data == dataSafeEnd;
+}
+
+// zigzag deltas against one of two baselines picked by the low bit, the stream ends in 4 padding bytes
+static bool decodeIndices(unsigned char* dst, size_t count, size_t indexSize, const unsigned char* src, size_t srcSize)
+{
+    if (srcSize < 1u + count + 4u || (src[0] & 0xF0u) != INDICES_HEADER || (src[0] & 0x0Fu) > 1u)
+        return false;
+
+    const unsigned char* data = src + 1;
+    const unsigned char* dataSafeEnd = src + srcSize - 4u;
+    uint32_t last[2] = { 0u, 0u };
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data >= dataSafeEnd)
+            return false;
+
+        uint32_t v = decodeVByte(data);
+        uint32_t baseline = v & 1u;
+        last[baseline] += decodeZigzag(v >> 1);
+        writeIndex(dst, i, indexSize, last[baseline]);
+    }
+
+    return data == dataSafeEnd;
+}
+
+// rounds half away from zero
+static int roundToInt(float v)
+{
+    return static_cast<int>(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+#ifdef MESHOPT_DECODE_SSE2
+static __m128i roundToInt4(__m128 v)
+{
+    __m128 half = _mm_or_ps(_mm_and_ps(v, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(_mm_add_ps(v, half));
+}
+#endif
+
+// XY of the octahedral map with Z holding the encoded length of 1, XYZ are rescaled to the full range of T
+template <typename T>
+static void filterOctahedral(unsigned char* data, size_t count)
+{
+    const float maxValue = static_cast<float>((1 << (sizeof(T) * 8u - 1u)) - 1);
+    T* elems = reinterpret_cast<T*>(data);
+    size_t i = 0;
+#ifdef MESHOPT_DECODE_SSE2
+    // four elements per iteration, gathered into lanes
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for (; i + 4u <= count; i += 4u)
+    {
+        T* e = elems + i * 4u;
+        __m128 x = _mm_setr_ps(e[0], e[4], e[8], e[12]);
+        __m128 y = _mm_setr_ps(e[1], e[5], e[9], e[13]);
+        __m128 z = _mm_setr_ps(e[2], e[6], e[10], e[14]);
+        z = _mm_sub_ps(_mm_sub_ps(z, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+
+        // fold back the lower hemisphere
+        __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+        x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, signMask)));
+        y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, signMask)));
+
+        __m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 s = _mm_div_ps(_mm_set1_ps(maxValue), l);
+
+        int32_t xi[4], yi[4], zi[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(xi), roundToInt4(_mm_mul_ps(x, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(yi), roundToInt4(_mm_mul_ps(y, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(zi), roundToInt4(_mm_mul_ps(z, s)));
+        for (int j = 0; j < 4; j++)
+        {
+            e[4 * j + 0] = static_cast<T>(xi[j]);
+            e[4 * j + 1] = static_cast<T>(yi[j]);
+            e[4 * j + 2] = static_cast<T>(zi[j]);
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        T* e = elems + i * 4u;
+        float x = e[0];
+        float y = e[1];
+        float z = e[2] - std::fabs(x) - std::fabs(y);
+
+        float t = std::min(z, 0.0f);
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        float s = maxValue / std::sqrt(x * x + y * y + z * z);
+        e[0] = static_cast<T>(roundToInt(x * s));
+        e[1] = static_cast<T>(roundToInt(y * s));
+        e[2] = static_cast<T>(roundToInt(z * s));
+    }
+}
+
+// three smallest components scaled by 1/sqrt(2), the low 2 bits of W name the dropped largest one and the rest its scale
+static void filterQuaternion(unsigned char* data, size_t count)
+{
+    const float scale = 1.0f / std::sqrt(2.0f);
+    int16_t* elems = reinterpret_cast<int16_t*>(data);
+    for (size_t i = 0; i < count; i++)
+    {
+        int16_t* e = elems + i * 4u;
+        float ss = scale / static_cast<float>(e[3] | 3);
+        float x = e[0] * ss;
+        float y = e[1] * ss;
+        float z = e[2] * ss;
+        float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+        uint32_t maxComponent = e[3] & 3;
+        e[(maxComponent + 1u) & 3u] = static_cast<int16_t>(roundToInt(x * 32767.0f));
+        e[(maxComponent + 2u) & 3u] = static_cast<int16_t>(roundToInt(y * 32767.0f));
+        e[(maxComponent + 3u) & 3u] = static_cast<int16_t>(roundToInt(z * 32767.0f));
+        e[maxComponent] = static_cast<int16_t>(roundToInt(w * 32767.0f));
+    }
+}
+
+// signed 24-bit mantissa scaled by 2^e for the signed exponent in the high byte
+static void filterExponential(unsigned char* data, size_t valueCount)
+{
+    size_t i = 0;
+#ifdef MESHOPT_DECODE_SSE2
+    for (; i + 4u <= valueCount; i += 4u)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4u));
+        __m128i mantissa = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+        __m128i exponent = _mm_srai_epi32(v, 24);
+        __m128 pow2 = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+        _mm_storeu_ps(reinterpret_cast<float*>(data + i * 4u), _mm_mul_ps(pow2, _mm_cvtepi32_ps(mantissa)));
+    }
+#endif
+    for (; i < valueCount; i++)
+    {
+        uint32_t v;
+        memcpy(&v, data + i * 4u, 4u);
+        int32_t mantissa = static_cast<int32_t>(v << 8) >> 8;
+        int32_t exponent = static_cast<int32_t>(v) >> 24;
+        uint32_t pow2Bits = static_cast<uint32_t>(exponent + 127) << 23;
+        float pow2;
+        memcpy(&pow2, &pow2Bits, 4u);
+        float f = pow2 * static_cast<float>(mantissa);
+        memcpy(data + i * 4u, &f, 4u);
+    }
+}
+
+bool decodeMeshopt(unsigned char* dst, size_t count, size_t byteStride, MeshoptMode mode, MeshoptFilter filter, const unsigned char* src, size_t srcSize, std::string& error)
+{
+    bool validStride = mode == MeshoptMode::Attributes ? byteStride > 0u && byteStride <= 256u && byteStride % 4u == 0u : byteStride == 2u || byteStride == 4u;
+    if (filter == MeshoptFilter::Octahedral)
+        validStride = validStride && (byteStride == 4u || byteStride == 8u);
+    else if (filter == MeshoptFilter::Quaternion)
+        validStride = validStride && byteStride == 8u;
+    if (!validStride || (filter != MeshoptFilter::None && mode != MeshoptMode::Attributes))
+    {
+        error = "invalid byteStride " + std::to_string(byteStride) + " or filter for the compression mode.";
+        return false;
+    }
+
+    bool decoded = false;
+    switch (mode)
+    {
+    case MeshoptMode::Attributes:
+        decoded = decodeAttributes(dst, count, byteStride, src, srcSize);
+        break;
+    case MeshoptMode::Triangles:
+        decoded = decodeTriangles(dst, count, byteStride, src, srcSize);
+        break;
+    case MeshoptMode::Indices:
+        decoded = decodeIndices(dst, count, byteStride, src, srcSize);
+        break;
+    }
+    if (!decoded)
+    {
+        error = "malformed compressed data.";
+        return false;
+    }
+
+    switch (filter)
+    {
+    case MeshoptFilter::None:
+        break;
+    case MeshoptFilter::Octahedral:
+        if (byteStride == 4u)
+            filterOctahedral<int8_t>(dst, count);
+        else
+            filterOctahedral<int16_t>(dst, count);
+        break;
+    case MeshoptFilter::Quaternion:
+        filterQuaternion(dst, count);
+        break;
+    case MeshoptFilter::Exponential:
+        filterExponential(dst, count * byteStride / 4u);
+        break;
+    }
+    return true;
+}
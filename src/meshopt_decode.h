@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// EXT_meshopt_compression buffer view decoding, the bitstreams of the extension's spec
+// src holds the compressed range of the view, dst receives count * byteStride bytes
+
+enum class MeshoptMode
+{
+    Attributes, // vertex data, byteStride a multiple of 4 up to 256
+    Triangles, // triangle list indices, byteStride 2 or 4
+    Indices, // any other index sequence, byteStride 2 or 4
+};
+
+enum class MeshoptFilter
+{
+    None,
+    Octahedral, // normalized vectors, 4 or 8 byte elements of signed 8 or 16 bit XYZ and an untouched W
+    Quaternion, // unit quaternions, 8 byte elements of signed 16 bit XYZW
+    Exponential, // floats stored as 8-bit exponent and 24-bit mantissa, byteStride a multiple of 4
+};
+
+bool parseMeshoptMode(const std::string& name, MeshoptMode& mode);
+bool parseMeshoptFilter(const std::string& name, MeshoptFilter& filter);
+
+// decodes and applies the filter, false with error set if the stream is malformed or the stride doesn't suit mode and filter
+bool decodeMeshopt(unsigned char* dst, size_t count, size_t byteStride, MeshoptMode mode, MeshoptFilter filter, const unsigned char* src, size_t srcSize, std::string& error);
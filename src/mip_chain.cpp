@@ -0,0 +1,136 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = 1u;
+    for (uint32_t size = std::max(width, height); size > 1u; size >>= 1)
+        levelCount++;
+    return levelCount;
+}
+
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t levelCount, size_t texelSize)
+{
+    size_t size = 0u;
+    for (uint32_t level = 0u; level < levelCount; level++)
+    {
+        size += static_cast<size_t>(width) * height * texelSize;
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+    }
+    return size;
+}
+
+// 16-bit linear encodings of every sRGB byte and the sRGB byte nearest to every 16-bit linear value
+struct SrgbTables
+{
+    uint16_t toLinear[256];
+    uint8_t fromLinear[65536];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            double c = i / 255.0;
+            double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            toLinear[i] = static_cast<uint16_t>(l * 65535.0 + 0.5);
+        }
+        for (int i = 0; i < 65536; i++)
+        {
+            double l = i / 65535.0;
+            double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            fromLinear[i] = static_cast<uint8_t>(std::min(c, 1.0) * 255.0 + 0.5);
+        }
+    }
+};
+
+static const SrgbTables& srgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+// row0 and row1 are the two source rows feeding one destination row, they alias for 1 texel high sources
+static void downsampleRowUnorm(unsigned char* dst, const unsigned char* row0, const unsigned char* row1, uint32_t srcWidth, uint32_t dstWidth)
+{
+    uint32_t x = 0u;
+#ifdef MIP_CHAIN_SSE2
+    // two destination texels per iteration while both of their 2x2 blocks lie inside the row
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    for (; x + 1u < dstWidth && 2u * x + 3u < srcWidth; x += 2u)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8u * x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8u * x));
+        // vertical sums, widened to 16 bits, texels 0 and 1 in lo, 2 and 3 in hi
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        // horizontal sums end up in the low 64 bits of each
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i avg = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 4u * x), _mm_packus_epi16(avg, avg));
+    }
+#endif
+    for (; x < dstWidth; x++)
+    {
+        uint32_t x0 = 4u * (2u * x);
+        uint32_t x1 = 4u * std::min(2u * x + 1u, srcWidth - 1u);
+        for (uint32_t c = 0u; c < 4u; c++)
+            dst[4u * x + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2u) >> 2);
+    }
+}
+
+static void downsampleRowSrgb(unsigned char* dst, const unsigned char* row0, const unsigned char* row1, uint32_t srcWidth, uint32_t dstWidth)
+{
+    const SrgbTables& tables = srgbTables();
+    for (uint32_t x = 0u; x < dstWidth; x++)
+    {
+        uint32_t x0 = 4u * (2u * x);
+        uint32_t x1 = 4u * std::min(2u * x + 1u, srcWidth - 1u);
+        for (uint32_t c = 0u; c < 3u; c++)
+        {
+            uint32_t sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+            dst[4u * x + c] = tables.fromLinear[(sum + 2u) >> 2];
+        }
+        dst[4u * x + 3u] = static_cast<unsigned char>((row0[x0 + 3u] + row0[x1 + 3u] + row1[x0 + 3u] + row1[x1 + 3u] + 2u) >> 2);
+    }
+}
+
+void generateMipLevel(unsigned char* dst, const unsigned char* src, uint32_t width, uint32_t height, bool srgb)
+{
+    uint32_t dstWidth = std::max(width >> 1, 1u);
+    uint32_t dstHeight = std::max(height >> 1, 1u);
+    size_t srcPitch = static_cast<size_t>(width) * 4u;
+    for (uint32_t y = 0u; y < dstHeight; y++)
+    {
+        const unsigned char* row0 = src + srcPitch * (2u * y);
+        const unsigned char* row1 = src + srcPitch * std::min(2u * y + 1u, height - 1u);
+        unsigned char* dstRow = dst + static_cast<size_t>(dstWidth) * 4u * y;
+        if (srgb)
+            downsampleRowSrgb(dstRow, row0, row1, width, dstWidth);
+        else
+            downsampleRowUnorm(dstRow, row0, row1, width, dstWidth);
+    }
+}
+
+void generateMipChain(unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, bool srgb)
+{
+    const unsigned char* src = chain;
+    for (uint32_t level = 1u; level < levelCount; level++)
+    {
+        unsigned char* dst = chain + mipChainSize(width, height, 1u) + (src - chain);
+        generateMipLevel(dst, src, width, height, srgb);
+
+        src = dst;
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+    }
+}
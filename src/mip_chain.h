@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU mip generation for RGBA8 textures
+// a chain is every level tightly packed one after the other, level 0 first, each level half the size of the one above rounded down (at least 1)
+
+// levels down to 1x1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t levelCount, size_t texelSize = 4u);
+
+// writes the level below the width x height RGBA8 level src into dst, 2x2 box filtered
+// srgb averages colour in linear space, alpha is always averaged as is
+void generateMipLevel(unsigned char* dst, const unsigned char* src, uint32_t width, uint32_t height, bool srgb);
+// fills levels 1 .. levelCount - 1 of chain by 2x2 box filtering the level above, level 0 must already be written
+void generateMipChain(unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, bool srgb);
@@ -2,20 +2,53 @@
 
 Renderer::~Renderer()
 {
+    // the loader may be waiting for room in the event queue, keep draining it until it is done
+    if (m_loader.joinable())
+    {
+        while (m_loadState == LoadState::Loading)
+        {
+            processSceneEvents();
+            std::this_thread::yield();
+        }
+        m_scene->stopStreaming();
+        m_loader.join();
+    }
+    m_materialViews.clear();
+    m_materials.clear();
+    m_instanceTable.reset();
+    m_meshes.reset();
+    m_animator.reset();
+
+    // scene resources must be freed before the allocator
+    m_scene.reset();
+    if (m_allocator != VK_NULL_HANDLE)
+        vmaDestroyAllocator(m_allocator);
     if (m_cmdPool != VK_NULL_HANDLE)
-        vkDestroyCommandPool(*m_gpu, m_cmdPool, nullptr);
+        VK_CALL(vkDestroyCommandPool, *m_gpu, m_cmdPool, nullptr);
     if (!m_swapchainViews.empty())
     {
         for (VkImageView view : m_swapchainViews)
-            vkDestroyImageView(*m_gpu, view, nullptr);
+            VK_CALL(vkDestroyImageView, *m_gpu, view, nullptr);
     }
-    vkDestroySemaphore(*m_gpu, m_imageAcquired, nullptr);
-    vkDestroySemaphore(*m_gpu, m_renderDone, nullptr);
-    vkDestroyFence(*m_gpu, m_renderFence, nullptr);
+    VK_CALL(vkDestroySemaphore, *m_gpu, m_imageAcquired, nullptr);
+    VK_CALL(vkDestroySemaphore, *m_gpu, m_renderDone, nullptr);
+    VK_CALL(vkDestroyFence, *m_gpu, m_renderFence, nullptr);
 }
 
 bool Renderer::init()
 {
+    // create allocator
+    VmaAllocatorCreateInfo allocatorInfo{};
+    allocatorInfo.instance = *m_gpu->m_instance;
+    allocatorInfo.physicalDevice = m_gpu->m_physicalDevice;
+    allocatorInfo.device = *m_gpu;
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+    allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+
+    VkResult res = vmaCreateAllocator(&allocatorInfo, &m_allocator);
+    if (res != VK_SUCCESS)
+        return false;
+
     // create swapchain
     m_swapchain = std::make_unique<vk::Swapchain>(m_gpu);
     if (!m_swapchain->create(m_window, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT))
@@ -37,7 +70,7 @@ bool Renderer::init()
         viewInfo.subresourceRange = subRange;
 
         VkImageView view;
-        VkResult res = vkCreateImageView(*m_gpu, &viewInfo, nullptr, &view);
+        res = VK_CALL(vkCreateImageView, *m_gpu, &viewInfo, nullptr, &view);
         if (res != VK_SUCCESS)
             return false;
         m_swapchainViews.push_back(view);
@@ -82,7 +115,7 @@ bool Renderer::init()
     cmdPoolInfo.queueFamilyIndex = m_gpu->m_queueFlagsToQueueFamily.at(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
     cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-    VkResult res = vkCreateCommandPool(*m_gpu, &cmdPoolInfo, nullptr, &m_cmdPool);
+    res = VK_CALL(vkCreateCommandPool, *m_gpu, &cmdPoolInfo, nullptr, &m_cmdPool);
     if (res != VK_SUCCESS)
         return false;
 
@@ -93,31 +126,227 @@ bool Renderer::init()
 
     // create sync objects
     VkSemaphoreCreateInfo semaphoreInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-    res = vkCreateSemaphore(*m_gpu, &semaphoreInfo, nullptr, &m_imageAcquired);
+    res = VK_CALL(vkCreateSemaphore, *m_gpu, &semaphoreInfo, nullptr, &m_imageAcquired);
     if (res != VK_SUCCESS)
         return false;
-    res = vkCreateSemaphore(*m_gpu, &semaphoreInfo, nullptr, &m_renderDone);
+    res = VK_CALL(vkCreateSemaphore, *m_gpu, &semaphoreInfo, nullptr, &m_renderDone);
     if (res != VK_SUCCESS)
         return false;
 
     VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    res = vkCreateFence(*m_gpu, &fenceInfo, nullptr, &m_renderFence);
+    res = VK_CALL(vkCreateFence, *m_gpu, &fenceInfo, nullptr, &m_renderFence);
     if (res != VK_SUCCESS)
         return false;
 
+    // nothing is ray traced yet, so the pipeline path is exercised once here on devices that enable it
+    if (m_gpu->isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) && !checkRayTracing())
+    {
+        LOGE("Ray tracing check failed.");
+        return false;
+    }
+
+    return true;
+}
+
+bool Renderer::loadScene(const std::string& gltfFilename, bool binary, bool lazy, VkDeviceSize geometryBudget, bool compressVertices, bool quantizePositions)
+{
+    uint32_t queueFamilyIdx = m_gpu->m_queueFlagsToQueueFamily.at(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+    if (m_scene)
+    {
+        LOGE("A scene has already been loaded.");
+        return false;
+    }
+
+    // uploads share m_gct with rendering, vk::Device serializes the submissions
+    m_scene = std::make_unique<Scene>(m_gpu, m_allocator, m_gct, queueFamilyIdx);
+    m_scene->m_events = &m_sceneEvents;
+    m_scene->m_lazy = lazy;
+    m_scene->m_geometryBudget = geometryBudget;
+    m_scene->m_compressVertices = compressVertices;
+    m_scene->m_quantizePositions = quantizePositions;
+    m_loadState = LoadState::Loading;
+    // the loader thread stays on to stream geometry until the scene changes again
+    m_loader = std::thread([this, gltfFilename, binary]() {
+        m_scene->load(gltfFilename, binary);
+        m_scene->streamGeometry();
+    });
+    return true;
+}
+
+bool Renderer::selectScene(int sceneIdx)
+{
+    return restartLoader([this, sceneIdx]() {
+        m_scene->selectScene(sceneIdx);
+        m_scene->streamGeometry();
+    });
+}
+
+bool Renderer::reloadScene()
+{
+    return restartLoader([this]() {
+        m_scene->reload();
+        m_scene->streamGeometry();
+    });
+}
+
+void Renderer::setViewPosition(const glm::vec3& position)
+{
+    if (m_scene)
+        m_scene->setStreamView(position);
+}
+
+bool Renderer::restartLoader(std::function<void()> job)
+{
+    if (!m_scene || m_loadState == LoadState::Loading)
+    {
+        LOGE("The scene can only be changed once loading has finished.");
+        return false;
+    }
+
+    // the previous load has published its last event, so its thread is done or streaming until told to stop
+    m_scene->stopStreaming();
+    m_loader.join();
+    m_loadState = LoadState::Loading;
+    m_loader = std::thread(job);
+    return true;
+}
+
+bool Renderer::createDeformPipeline()
+{
+    // skinning and morph targets of animated instances, recorded ahead of the frame's other work
+    vk::Shader deformShader(m_gpu);
+    if (!deformShader.create("src/shaders/deform.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT))
+        return false;
+
+    std::unique_ptr<vk::ComputePipeline> pipe = std::make_unique<vk::ComputePipeline>(m_gpu);
+    if (!pipe->create(deformShader))
+        return false;
+
+    m_deformPipe = std::move(pipe);
     return true;
 }
 
+bool Renderer::checkRayTracing()
+{
+    vk::Shader raygenShader(m_gpu);
+    if (!raygenShader.create("src/shaders/smoke.rgen.spv", VK_SHADER_STAGE_RAYGEN_BIT_KHR))
+        return false;
+
+    vk::RayTracingPipeline pipe(m_gpu);
+    vk::RayTracingPipeline::ShaderGroup raygenGroup;
+    raygenGroup.general = &raygenShader;
+    pipe.m_raygenGroups.push_back(raygenGroup);
+    if (!pipe.create())
+        return false;
+
+    vk::ShaderBindingTable sbt(m_gpu, m_allocator);
+    if (!sbt.create(pipe))
+        return false;
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult res = VK_CALL(vkBeginCommandBuffer, *m_cmdBuf, &beginInfo);
+    if (res != VK_SUCCESS)
+        return false;
+
+    m_cmdBuf->bindRayTracingPipeline(&pipe);
+    m_cmdBuf->traceRays(sbt, 1u, 1u);
+
+    res = VK_CALL(vkEndCommandBuffer, *m_cmdBuf);
+    if (res != VK_SUCCESS)
+        return false;
+
+    // the pipeline and SBT are destroyed on return, so the trace has to complete first
+    return m_gpu->submitAndWait(m_gct, *m_cmdBuf);
+}
+
+void Renderer::processSceneEvents()
+{
+    // called once the previous frame has completed, the views replaced here are no longer in use
+    SceneEvent ev;
+    while (m_sceneEvents.tryPop(ev))
+    {
+        switch (ev.type)
+        {
+        case SceneEvent::Type::Material:
+            if (ev.materialIdx >= m_materialViews.size())
+            {
+                m_materialViews.resize(ev.materialIdx + 1u);
+                m_materials.resize(ev.materialIdx + 1u);
+            }
+            m_materialViews[ev.materialIdx] = ev.views;
+            m_materials[ev.materialIdx] = ev.material;
+            break;
+        case SceneEvent::Type::Geometry:
+            m_instanceTable = ev.instanceTable;
+            m_meshes = ev.meshes;
+            m_animator = ev.animator;
+            m_animationStart = glfwGetTime();
+            m_instanceCount = ev.instanceCount;
+            m_materialViews.resize(ev.materialCount);
+            m_materials.resize(ev.materialCount);
+            break;
+        case SceneEvent::Type::Residency:
+            // evicted buffers are released with the previous meshes once the records no longer point at them
+            patchInstanceTable(ev.patches);
+            m_meshes = ev.meshes;
+            break;
+        case SceneEvent::Type::Loaded:
+            m_loadState = LoadState::Loaded;
+            break;
+        case SceneEvent::Type::Failed:
+            m_loadState = LoadState::Failed;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Renderer::patchInstanceTable(const std::vector<RecordPatch>& patches)
+{
+    void* data;
+    if (!m_instanceTable || !m_instanceTable->map(&data))
+        return;
+
+    InstanceRecord* records = static_cast<InstanceRecord*>(data);
+    for (const RecordPatch& patch : patches)
+    {
+        for (uint32_t i = patch.firstRecord; i < patch.firstRecord + patch.recordCount; i++)
+        {
+            records[i].indexAddress = patch.indexAddress;
+            records[i].positionAddress = patch.positionAddress;
+            records[i].normalAddress = patch.normalAddress;
+            records[i].tangentAddress = patch.tangentAddress;
+            records[i].texCoordAddress = patch.texCoordAddress;
+            records[i].vertexFormat = patch.vertexFormat;
+            records[i].texCoordTransform = patch.texCoordTransform;
+        }
+    }
+    m_instanceTable->unmap();
+}
+
 bool Renderer::render()
 {
-    vkWaitForFences(*m_gpu, 1u, &m_renderFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(*m_gpu, 1u, &m_renderFence);
+    VK_CALL(vkWaitForFences, *m_gpu, 1u, &m_renderFence, VK_TRUE, UINT64_MAX);
+    processSceneEvents();
+    // the deform pipeline is created with the first animated scene, static scenes don't need its shader
+    if (m_animator && !m_deformPipe && !createDeformPipeline())
+        return false;
+    VK_CALL(vkResetFences, *m_gpu, 1u, &m_renderFence);
     uint32_t swapIdx;
     m_swapchain->acquireNextImage(&swapIdx, m_imageAcquired);
 
     VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    vkBeginCommandBuffer(*m_cmdBuf, &beginInfo);
+    VK_CALL(vkBeginCommandBuffer, *m_cmdBuf, &beginInfo);
+
+    // the previous frame has completed, so the animator can rewrite the instance table and its parameters in place
+    if (m_animator)
+    {
+        m_animator->update(static_cast<float>(glfwGetTime() - m_animationStart));
+        m_animator->recordDeform(*m_cmdBuf, *m_deformPipe);
+    }
 
     m_cmdBuf->bindGraphicsPipeline(m_gfxPipe.get());
     m_cmdBuf->imageMemoryBarrier(m_swapchain->m_images[swapIdx], VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0u, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL);
@@ -143,13 +372,13 @@ bool Renderer::render()
     renderingInfo.colorAttachmentCount = 1u;
     renderingInfo.pColorAttachments = &attachmentInfo;
 
-    vkCmdBeginRendering(*m_cmdBuf, &renderingInfo);
-    vkCmdDraw(*m_cmdBuf, 3u, 1u, 0u, 0u);
-    vkCmdEndRendering(*m_cmdBuf);
+    VK_CMD(vkCmdBeginRendering, *m_cmdBuf, &renderingInfo);
+    VK_CMD(vkCmdDraw, *m_cmdBuf, 3u, 1u, 0u, 0u);
+    VK_CMD(vkCmdEndRendering, *m_cmdBuf);
 
     m_cmdBuf->imageMemoryBarrier(m_swapchain->m_images[swapIdx], VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0u, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-    vkEndCommandBuffer(*m_cmdBuf);
+    VK_CALL(vkEndCommandBuffer, *m_cmdBuf);
 
     m_gpu->submitToQueue(m_gct, *m_cmdBuf, m_imageAcquired, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_renderDone, m_renderFence);
 
@@ -1,6 +1,10 @@
 #pragma once
 
-#include "vk_graphics.h"
+#include "scene.h"
+#include "animator.h"
+
+#include <functional>
+#include <thread>
 
 class Renderer
 {
@@ -10,8 +14,27 @@ public:
 
     ~Renderer();
 
+    enum class LoadState
+    {
+        None,
+        Loading,
+        Loaded,
+        Failed,
+    };
+
     bool init();
+    // starts loading on a thread of its own and returns, frames keep rendering what is resident meanwhile
+    // lazy glTF loads only take what the selected scene reaches, selectScene() can then switch to another one
+    // a geometry budget in bytes streams glTF meshes in and out around the view position afterwards, see Scene::m_geometryBudget
+    bool loadScene(const std::string& gltfFilename, bool binary = false, bool lazy = false, VkDeviceSize geometryBudget = 0u, bool compressVertices = false,
+        bool quantizePositions = false);
+    bool selectScene(int sceneIdx);
+    // reloads the glTF file on the loader thread, keeping whatever didn't change
+    bool reloadScene();
     bool render();
+    // streamed meshes are prioritized by their distance to this, the origin until it is set
+    void setViewPosition(const glm::vec3& position);
+    LoadState getLoadState() const { return m_loadState; }
 
     Renderer& operator=(const Renderer&) = delete;
 
@@ -20,8 +43,10 @@ private:
     GLFWwindow* m_window;
     uint32_t m_width;
     uint32_t m_height;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
     std::unique_ptr<vk::Swapchain> m_swapchain;
     std::unique_ptr<vk::GraphicsPipeline> m_gfxPipe;
+    std::unique_ptr<vk::ComputePipeline> m_deformPipe;
     VkQueue m_gct = VK_NULL_HANDLE;
     VkCommandPool m_cmdPool = VK_NULL_HANDLE;
     std::unique_ptr<vk::CommandBuffer> m_cmdBuf;
@@ -31,4 +56,26 @@ private:
     VkFence m_renderFence = VK_NULL_HANDLE;
 
     std::vector<VkImageView> m_swapchainViews;
+
+    std::unique_ptr<Scene> m_scene;
+    std::thread m_loader;
+    SpscQueue<SceneEvent> m_sceneEvents{ 256u };
+    LoadState m_loadState = LoadState::None;
+    // the render thread's view of the scene, only updated from m_sceneEvents
+    std::vector<MaterialViews> m_materialViews;
+    std::vector<Material> m_materials;
+    std::shared_ptr<vk::Buffer> m_instanceTable;
+    std::shared_ptr<const std::vector<Mesh>> m_meshes;
+    std::shared_ptr<Animator> m_animator;
+    // glfwGetTime() when the current animator arrived, its animation plays from there
+    double m_animationStart = 0.0;
+    uint32_t m_instanceCount = 0u;
+
+    bool createDeformPipeline();
+    // builds a ray tracing pipeline and SBT for an empty raygen shader and traces it once
+    bool checkRayTracing();
+    void processSceneEvents();
+    // the table is host visible and the previous frame has completed, so records are rewritten in place
+    void patchInstanceTable(const std::vector<RecordPatch>& patches);
+    bool restartLoader(std::function<void()> job);
 };
\ No newline at end of file
@@ -0,0 +1,3020 @@
+#include "scene.h"
+#include "thread_pool.h"
+#include "scene_pack.h"
+#include "mip_chain.h"
+#include "block_compression.h"
+#include "ktx2.h"
+#include "meshopt_decode.h"
+#include "content_hash.h"
+#include "animator.h"
+#include "meshlet_builder.h"
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "tiny_gltf.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <array>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+static void strided_copy(void* dst, const void* src, size_t elem_count, size_t elem_size, size_t byte_stride)
+{
+    for (size_t i = 0; i < elem_count; i++)
+    {
+        memcpy((unsigned char*)dst + i * elem_size, (const unsigned char*)src + i * byte_stride, elem_size);
+    }
+}
+
+// pseudo file name given to images stored in buffer views, "<prefix><buffer>-<byteOffset>-<byteLength>"
+// readBufferImage() copies them straight from the mapped buffers
+static const char* s_bufferImagePrefix = "cray-buffer-image-";
+
+// EXT_meshopt_compression views are decoded up front into buffers of their own, on the thread pool
+// the views are then rewritten to plain views of those buffers, so nothing downstream knows they were compressed
+static bool decodeMeshoptViews(nlohmann::json& doc, std::vector<BufferSpan>& buffers, std::vector<std::vector<unsigned char>>& decodedBuffers)
+{
+    nlohmann::json::iterator bufferViews = doc.find("bufferViews");
+    if (bufferViews == doc.end())
+        return true;
+
+    struct MeshoptView
+    {
+        nlohmann::json* view;
+        const unsigned char* src;
+        size_t srcSize;
+        size_t count;
+        size_t byteStride;
+        MeshoptMode mode;
+        MeshoptFilter filter;
+    };
+    std::vector<MeshoptView> views;
+    for (nlohmann::json& view : *bufferViews)
+    {
+        nlohmann::json::iterator extensions = view.find("extensions");
+        if (extensions == view.end() || !extensions->contains("EXT_meshopt_compression"))
+            continue;
+
+        const nlohmann::json& ext = (*extensions)["EXT_meshopt_compression"];
+        MeshoptView mv;
+        mv.view = &view;
+        size_t buffer = ext.value("buffer", static_cast<size_t>(0u));
+        size_t byteOffset = ext.value("byteOffset", static_cast<size_t>(0u));
+        mv.srcSize = ext.value("byteLength", static_cast<size_t>(0u));
+        mv.count = ext.value("count", static_cast<size_t>(0u));
+        mv.byteStride = ext.value("byteStride", static_cast<size_t>(0u));
+        if (!parseMeshoptMode(ext.value("mode", std::string()), mv.mode) || !parseMeshoptFilter(ext.value("filter", std::string()), mv.filter))
+        {
+            LOGE("Unknown EXT_meshopt_compression mode or filter.");
+            return false;
+        }
+        if (buffer >= buffers.size() || !buffers[buffer].data || byteOffset > buffers[buffer].size || mv.srcSize > buffers[buffer].size - byteOffset)
+        {
+            LOGE("EXT_meshopt_compression buffer view lies outside its buffer.");
+            return false;
+        }
+        mv.src = buffers[buffer].data + byteOffset;
+        views.push_back(mv);
+    }
+    if (views.empty())
+        return true;
+
+    // allocated before any job runs, the spans below point into these
+    size_t firstDecoded = decodedBuffers.size();
+    decodedBuffers.resize(firstDecoded + views.size());
+    for (size_t i = 0; i < views.size(); i++)
+        decodedBuffers[firstDecoded + i].resize(views[i].count * views[i].byteStride);
+
+    std::vector<std::string> errors(views.size());
+    {
+        ThreadPool pool;
+        std::vector<std::future<bool>> results;
+        for (size_t i = 0; i < views.size(); i++)
+        {
+            std::vector<unsigned char>* dst = &decodedBuffers[firstDecoded + i];
+            const MeshoptView* mv = &views[i];
+            std::string* error = &errors[i];
+            results.push_back(pool.submit([dst, mv, error]() { return decodeMeshopt(dst->data(), mv->count, mv->byteStride, mv->mode, mv->filter, mv->src, mv->srcSize, *error); }));
+        }
+
+        bool decoded = true;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (!results[i].get())
+            {
+                LOGE("Failed to decode EXT_meshopt_compression buffer view: " + errors[i]);
+                decoded = false;
+            }
+        }
+        if (!decoded)
+            return false;
+    }
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        const std::vector<unsigned char>& decoded = decodedBuffers[firstDecoded + i];
+        nlohmann::json& view = *views[i].view;
+        view["buffer"] = buffers.size();
+        view["byteOffset"] = 0u;
+        view["byteLength"] = decoded.size();
+        view["extensions"].erase("EXT_meshopt_compression");
+        buffers.push_back({ decoded.data(), decoded.size(), nullptr, 0u });
+    }
+    return true;
+}
+
+static bool parseBufferImagePath(const std::string& path, size_t* buffer, size_t* offset, size_t* length)
+{
+    size_t pos = path.rfind(s_bufferImagePrefix);
+    if (pos == std::string::npos)
+        return false;
+    return sscanf(path.c_str() + pos + strlen(s_bufferImagePrefix), "%zu-%zu-%zu", buffer, offset, length) == 3;
+}
+
+static bool readBufferImage(std::vector<unsigned char>* out, std::string* err, const std::string& path, const std::vector<BufferSpan>& buffers)
+{
+    size_t buffer, offset, length;
+    if (!parseBufferImagePath(path, &buffer, &offset, &length))
+        return tinygltf::ReadWholeFile(out, err, path, nullptr);
+
+    if (buffer >= buffers.size() || offset + length > buffers[buffer].size)
+    {
+        *err = "image buffer view is out of range";
+        return false;
+    }
+    out->assign(buffers[buffer].data + offset, buffers[buffer].data + offset + length);
+    return true;
+}
+
+Scene::~Scene()
+{
+    if (m_cmdPool != VK_NULL_HANDLE)
+        VK_CALL(vkDestroyCommandPool, *m_gpu, m_cmdPool, nullptr);
+}
+
+// texture decode in flight on the pool, written by startTextureDecode() and drained by finishTextures()
+// one per loadGltfScene(), textures already resident from an earlier one are shared rather than decoded again
+struct Scene::TextureLoad
+{
+    std::vector<TextureFormat> formats;
+    // sources is the image each texture decodes from, -1 if it is skipped or shares another texture's image
+    std::vector<int> sources;
+    std::vector<int> sharedTextures;
+    // per texture, set on the loading thread once its image is uploaded
+    std::vector<bool> resident;
+    // bytes of the images read for this load, released as each one is decoded
+    std::vector<std::vector<unsigned char>> encodedImages;
+    std::mutex decodedMutex;
+    std::condition_variable decodedCond;
+    std::vector<int> decoded;
+    std::vector<DecodedImage> decodedImages;
+    std::vector<std::future<bool>> results;
+    int pendingCount = 0;
+    // declared last so workers are joined before the state they reference is destroyed
+    ThreadPool pool;
+};
+
+// texture indices of the albedo, metallic/roughness, normal and emissive slots, -1 if unset
+static std::array<int, 4> materialTextures(const tinygltf::Material& material)
+{
+    return { { material.pbrMetallicRoughness.baseColorTexture.index, material.pbrMetallicRoughness.metallicRoughnessTexture.index, material.normalTexture.index, material.emissiveTexture.index } };
+}
+
+// false while any texture the material samples is still loading
+static bool texturesResident(const tinygltf::Material& material, const std::vector<bool>& resident)
+{
+    for (int idx : materialTextures(material))
+    {
+        if (idx > -1 && !resident[idx])
+            return false;
+    }
+    return true;
+}
+
+int findTrianglePrimitive(const tinygltf::Mesh& mesh)
+{
+    for (size_t i = 0; i < mesh.primitives.size(); i++)
+    {
+        if (mesh.primitives[i].mode == TINYGLTF_MODE_TRIANGLES)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// count elements of elemSize every byteStride (0 if tightly packed) at offset lie within span, mapped files fault past their end
+static bool spanHolds(const BufferSpan& span, VkDeviceSize offset, size_t elemSize, size_t count, size_t byteStride)
+{
+    size_t stride = byteStride > 0u ? byteStride : elemSize;
+    size_t size = count > 0u ? (count - 1u) * stride + elemSize : 0u;
+    return span.data && offset <= span.size && size <= span.size - offset;
+}
+
+std::vector<float> repeatValue(const float* value, uint32_t components, uint32_t count)
+{
+    std::vector<float> values(static_cast<size_t>(components) * count);
+    for (size_t i = 0; i < values.size(); i += components)
+        memcpy(&values[i], value, sizeof(float) * components);
+    return values;
+}
+
+// count elements of elemSize at byteOffset into a buffer view, null if they lie outside its buffer
+static const unsigned char* viewData(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, int viewIdx, size_t byteOffset, size_t elemSize, size_t count, size_t& stride)
+{
+    if (viewIdx < 0 || viewIdx >= static_cast<int>(model.bufferViews.size()))
+        return nullptr;
+
+    const tinygltf::BufferView& view = model.bufferViews[viewIdx];
+    const BufferSpan& span = buffers[view.buffer];
+    stride = view.byteStride > 0u ? view.byteStride : elemSize;
+    size_t offset = view.byteOffset + byteOffset;
+    size_t size = count > 0u ? (count - 1u) * stride + elemSize : 0u;
+    if (!span.data || offset > span.size || size > span.size - offset)
+        return nullptr;
+    return span.data + offset;
+}
+
+static float readComponent(const unsigned char* src, int componentType, bool normalized)
+{
+    switch (componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+    {
+        int8_t v;
+        memcpy(&v, src, sizeof(v));
+        return normalized ? std::max(v / 127.0f, -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return normalized ? *src / 255.0f : *src;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    {
+        int16_t v;
+        memcpy(&v, src, sizeof(v));
+        return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    {
+        uint16_t v;
+        memcpy(&v, src, sizeof(v));
+        return normalized ? v / 65535.0f : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    {
+        uint32_t v;
+        memcpy(&v, src, sizeof(v));
+        return static_cast<float>(v);
+    }
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    {
+        float v;
+        memcpy(&v, src, sizeof(v));
+        return v;
+    }
+    default:
+        return 0.0f;
+    }
+}
+
+// for the data read on the CPU (animation, skins, morph targets) rather than uploaded as is
+// normalized integers map to [0, 1] or [-1, 1], sparse values are applied over the buffer view or zeros
+bool readAccessor(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, int accessorIdx, std::vector<float>& values)
+{
+    if (accessorIdx < 0 || accessorIdx >= static_cast<int>(model.accessors.size()))
+        return false;
+
+    const tinygltf::Accessor& accessor = model.accessors[accessorIdx];
+    int components = tinygltf::GetNumComponentsInType(accessor.type);
+    int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    if (components <= 0 || componentSize <= 0)
+        return false;
+    size_t elemSize = static_cast<size_t>(components * componentSize);
+
+    values.assign(accessor.count * components, 0.0f);
+    size_t stride;
+    if (accessor.bufferView >= 0)
+    {
+        const unsigned char* src = viewData(model, buffers, accessor.bufferView, accessor.byteOffset, elemSize, accessor.count, stride);
+        if (!src)
+            return false;
+        for (size_t i = 0; i < accessor.count; i++)
+        {
+            for (int c = 0; c < components; c++)
+                values[i * components + c] = readComponent(src + i * stride + c * componentSize, accessor.componentType, accessor.normalized);
+        }
+    }
+
+    if (!accessor.sparse.isSparse)
+        return true;
+
+    const auto& sparse = accessor.sparse;
+    int indexSize = tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+    size_t count = static_cast<size_t>(std::max(sparse.count, 0));
+    size_t indexStride, valueStride;
+    const unsigned char* indices = indexSize > 0 ? viewData(model, buffers, sparse.indices.bufferView, sparse.indices.byteOffset, indexSize, count, indexStride) : nullptr;
+    const unsigned char* src = viewData(model, buffers, sparse.values.bufferView, sparse.values.byteOffset, elemSize, count, valueStride);
+    if (!indices || !src)
+        return false;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t idx = static_cast<size_t>(readComponent(indices + i * indexStride, sparse.indices.componentType, false));
+        if (idx >= accessor.count)
+            return false;
+        for (int c = 0; c < components; c++)
+            values[idx * components + c] = readComponent(src + i * valueStride + c * componentSize, accessor.componentType, accessor.normalized);
+    }
+    return true;
+}
+
+bool readIndices(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, int accessorIdx, std::vector<uint32_t>& indices)
+{
+    if (accessorIdx < 0 || accessorIdx >= static_cast<int>(model.accessors.size()))
+        return false;
+
+    // indices are never sparse in practice and need no conversion beyond widening, float values would lose those past 2^24
+    const tinygltf::Accessor& accessor = model.accessors[accessorIdx];
+    int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    bool unsignedType = accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT ||
+        accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    if (accessor.type != TINYGLTF_TYPE_SCALAR || !unsignedType || accessor.sparse.isSparse)
+        return false;
+
+    size_t stride;
+    const unsigned char* src = viewData(model, buffers, accessor.bufferView, accessor.byteOffset, static_cast<size_t>(componentSize), accessor.count, stride);
+    if (!src)
+        return false;
+
+    indices.resize(accessor.count);
+    for (size_t i = 0; i < accessor.count; i++)
+    {
+        if (componentSize == 4)
+        {
+            memcpy(&indices[i], src + i * stride, sizeof(uint32_t));
+        }
+        else if (componentSize == 2)
+        {
+            uint16_t v;
+            memcpy(&v, src + i * stride, sizeof(v));
+            indices[i] = v;
+        }
+        else
+        {
+            indices[i] = src[i * stride];
+        }
+    }
+    return true;
+}
+
+// EXT_mesh_gpu_instancing TRS attributes, composed into one transform per instance and appended to transforms
+static bool readGpuInstances(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, const tinygltf::Value& ext, std::vector<glm::mat4>& transforms)
+{
+    const tinygltf::Value& attributes = ext.Get("attributes");
+    const char* names[] = { "TRANSLATION", "ROTATION", "SCALE" };
+    const size_t components[] = { 3u, 4u, 3u };
+    std::vector<float> trs[3];
+    size_t count = 0u;
+    bool any = false;
+    for (size_t a = 0; a < 3u; a++)
+    {
+        if (!attributes.Has(names[a]))
+            continue;
+        if (!readAccessor(model, buffers, attributes.Get(names[a]).GetNumberAsInt(), trs[a]) || trs[a].size() % components[a] != 0u)
+            return false;
+
+        size_t n = trs[a].size() / components[a];
+        if (any && n != count)
+            return false;
+        count = n;
+        any = true;
+    }
+    if (!any)
+        return false;
+
+    // composed directly rather than as T * R * S, these can be millions
+    transforms.reserve(transforms.size() + count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const float* t = trs[0].empty() ? nullptr : &trs[0][3u * i];
+        const float* r = trs[1].empty() ? nullptr : &trs[1][4u * i];
+        const float* sc = trs[2].empty() ? nullptr : &trs[2][3u * i];
+        glm::mat4 m = r ? glm::toMat4(glm::quat(r[3], r[0], r[1], r[2])) : glm::mat4(1.0f);
+        if (sc)
+        {
+            m[0] *= sc[0];
+            m[1] *= sc[1];
+            m[2] *= sc[2];
+        }
+        if (t)
+            m[3] = glm::vec4(t[0], t[1], t[2], 1.0f);
+        transforms.push_back(m);
+    }
+    return true;
+}
+
+// the node's morph target weights, or its mesh's, one per target of the primitive createMesh() loads
+static std::vector<float> gltfMorphWeights(const tinygltf::Model& model, const tinygltf::Node& node)
+{
+    if (node.mesh < 0)
+        return {};
+
+    const tinygltf::Mesh& mesh = model.meshes[node.mesh];
+    int primIdx = findTrianglePrimitive(mesh);
+    size_t targetCount = primIdx < 0 ? 0u : mesh.primitives[primIdx].targets.size();
+    const std::vector<double>& src = !node.weights.empty() ? node.weights : mesh.weights;
+    std::vector<float> weights(targetCount, 0.0f);
+    for (size_t i = 0; i < std::min(src.size(), targetCount); i++)
+        weights[i] = static_cast<float>(src[i]);
+    return weights;
+}
+
+// meshes the scene's node trees instance, the materials of their primitives and the textures those sample
+// everything in the file unless loading lazily
+// skinned and morphed meshes keep float streams, the deform pass reads and writes them as such
+static bool isDeformable(const tinygltf::Primitive& prim)
+{
+    return !prim.targets.empty() || prim.attributes.count("JOINTS_0") > 0u;
+}
+
+// 16-bit whenever compressing and the vertex count allows it, the accessor's own type otherwise
+// byte indices are widened to 16-bit, they can't be bound without VK_EXT_index_type_uint8
+static VkIndexType gltfIndexType(const tinygltf::Accessor& indices, size_t vertexCount, bool compress)
+{
+    if (indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT || (compress && vertexCount <= 65536u))
+        return VK_INDEX_TYPE_UINT16;
+    return VK_INDEX_TYPE_UINT32;
+}
+
+// snorm16 positions span the POSITION bounds with one scale on every axis, so normals transformed by the instance transform stay right
+// false if the accessor has no bounds, R16G16B16A16_SNORM is an acceleration structure vertex format so BLAS builds can read them too
+static bool gltfPositionTransform(const tinygltf::Accessor& positions, glm::mat4& transform)
+{
+    if (positions.minValues.size() != 3u || positions.maxValues.size() != 3u)
+        return false;
+
+    glm::vec3 lo(positions.minValues[0], positions.minValues[1], positions.minValues[2]);
+    glm::vec3 hi(positions.maxValues[0], positions.maxValues[1], positions.maxValues[2]);
+    float extent = 0.5f * std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    transform = glm::translate(glm::mat4(1.0f), 0.5f * (lo + hi)) * glm::scale(glm::mat4(1.0f), glm::vec3(extent > 0.0f ? extent : 1.0f));
+    return true;
+}
+
+// octahedral mapping of a unit vector to [-1, 1]^2, see octDecode() in shaders/scene.glsl
+static glm::vec2 octEncode(glm::vec3 n)
+{
+    n /= std::max(std::abs(n.x) + std::abs(n.y) + std::abs(n.z), 1e-20f);
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+    return (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// bytes createMesh() uploads for the primitive, as its accessors give them
+static VkDeviceSize gltfMeshSize(const tinygltf::Model& model, const tinygltf::Primitive& prim, bool compress, bool quantize)
+{
+    auto position = prim.attributes.find("POSITION");
+    VkDeviceSize vertexCount = position != prim.attributes.end() && position->second >= 0 ? model.accessors[position->second].count : 0u;
+    bool packed = compress && !isDeformable(prim);
+    glm::mat4 positionTransform;
+
+    VkDeviceSize size = 0u;
+    if (prim.indices >= 0)
+        size += model.accessors[prim.indices].count * (gltfIndexType(model.accessors[prim.indices], vertexCount, compress) == VK_INDEX_TYPE_UINT16 ? 2u : 4u);
+    size += vertexCount * (packed && quantize && vertexCount > 0u && gltfPositionTransform(model.accessors[position->second], positionTransform) ? 8u : 12u);
+    if (packed)
+        return size + 12u * vertexCount;
+
+    const std::pair<const char*, VkDeviceSize> attributes[] = { { "NORMAL", 12u }, { "TANGENT", 16u }, { "TEXCOORD_0", 8u } };
+    for (const auto& attribute : attributes)
+    {
+        auto it = prim.attributes.find(attribute.first);
+        if (it != prim.attributes.end() && it->second >= 0)
+            size += model.accessors[it->second].count * attribute.second;
+    }
+
+    // skinning and morph target inputs are converted to uvec4/vec4 and three vec3 deltas per target
+    if (prim.attributes.count("JOINTS_0") > 0u && prim.attributes.count("WEIGHTS_0") > 0u)
+        size += 32u * vertexCount;
+    return size + 36u * vertexCount * prim.targets.size();
+}
+
+// object space bounding sphere of the primitive's POSITION bounds, infinite if they are missing
+static glm::vec4 gltfMeshBounds(const tinygltf::Model& model, const tinygltf::Primitive& prim)
+{
+    auto it = prim.attributes.find("POSITION");
+    if (it == prim.attributes.end() || it->second < 0 || model.accessors[it->second].minValues.size() != 3u || model.accessors[it->second].maxValues.size() != 3u)
+        return glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity());
+
+    const tinygltf::Accessor& accessor = model.accessors[it->second];
+    glm::vec3 lo(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
+    glm::vec3 hi(accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]);
+    return glm::vec4(0.5f * (lo + hi), 0.5f * glm::length(hi - lo));
+}
+
+// the radius grows by the largest scale of transform, so the sphere stays conservative under non-uniform scales
+static glm::vec4 worldSphere(const glm::mat4& transform, const glm::vec4& sphere)
+{
+    glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    return glm::vec4(center, sphere.w * scale);
+}
+
+// 0 for the buffers of meshes that aren't resident
+static VkDeviceAddress bufferAddress(const std::shared_ptr<GeometryRange>& buffer)
+{
+    return buffer ? buffer->getDeviceAddress() : 0u;
+}
+
+// what the records of a mesh read from, the record range is left to the caller
+static RecordPatch meshAddresses(const Mesh& m)
+{
+    RecordPatch p{};
+    p.indexAddress = bufferAddress(m.indexBuffer);
+    p.positionAddress = bufferAddress(m.positionBuffer);
+    p.normalAddress = bufferAddress(m.normalBuffer);
+    bool packed = m.normalBuffer && (m.vertexFormat & Mesh::PACKED_ATTRIBUTES) != 0u;
+    p.tangentAddress = packed ? p.normalAddress + 4u : bufferAddress(m.tangentBuffer);
+    p.texCoordAddress = packed ? p.normalAddress + 8u : bufferAddress(m.texCoordBuffer);
+    p.vertexFormat = m.vertexFormat;
+    p.texCoordTransform = m.texCoordTransform;
+    return p;
+}
+
+static void markUsed(const tinygltf::Model& model, const tinygltf::Scene& scene, bool lazy, std::vector<bool>& meshUsed, std::vector<bool>& materialUsed, std::vector<bool>& textureUsed)
+{
+    meshUsed.assign(model.meshes.size(), !lazy);
+    materialUsed.assign(model.materials.size(), !lazy);
+    textureUsed.assign(model.textures.size(), false);
+
+    std::vector<int> stack;
+    if (lazy)
+        stack.assign(scene.nodes.begin(), scene.nodes.end());
+    while (!stack.empty())
+    {
+        const tinygltf::Node& node = model.nodes[stack.back()];
+        stack.pop_back();
+        stack.insert(stack.end(), node.children.begin(), node.children.end());
+        if (node.mesh < 0 || meshUsed[node.mesh])
+            continue;
+
+        meshUsed[node.mesh] = true;
+        int primIdx = findTrianglePrimitive(model.meshes[node.mesh]);
+        size_t materialIdx = primIdx < 0 ? 0u : static_cast<size_t>(std::max(0, model.meshes[node.mesh].primitives[primIdx].material));
+        if (materialIdx < materialUsed.size())
+            materialUsed[materialIdx] = true;
+    }
+
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+        if (!materialUsed[i])
+            continue;
+        for (int idx : materialTextures(model.materials[i]))
+        {
+            if (idx > -1)
+                textureUsed[idx] = true;
+        }
+    }
+}
+
+bool Scene::load(const std::string& gltfFilename, bool binary)
+{
+    // create upload cmd pool and buffer
+    VkCommandPoolCreateInfo cmdPoolInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    cmdPoolInfo.queueFamilyIndex = m_queueFamilyIdx;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    // failures still reach the end, the render thread waits for the Failed event
+    VkResult res = VK_CALL(vkCreateCommandPool, *m_gpu, &cmdPoolInfo, nullptr, &m_cmdPool);
+    bool ret = res == VK_SUCCESS;
+    if (ret)
+    {
+        m_cmdBuf = std::make_unique<vk::CommandBuffer>(m_gpu, m_cmdPool);
+        ret = m_cmdBuf->create();
+    }
+
+    // textures are copied from the host directly if the device can do so into SHADER_READ_ONLY_OPTIMAL
+    if (m_gpu->isExtensionEnabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceHostImageCopyPropertiesEXT hostCopyProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT };
+        VkPhysicalDeviceProperties2 props{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        props.pNext = &hostCopyProps;
+        VK_CALL(vkGetPhysicalDeviceProperties2, m_gpu->m_physicalDevice, &props);
+
+        std::vector<VkImageLayout> dstLayouts(hostCopyProps.copyDstLayoutCount);
+        hostCopyProps.pCopyDstLayouts = dstLayouts.data();
+        VK_CALL(vkGetPhysicalDeviceProperties2, m_gpu->m_physicalDevice, &props);
+
+        for (VkImageLayout layout : dstLayouts)
+        {
+            if (layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+                m_hostImageCopy = true;
+        }
+    }
+
+    // mapped files are imported whole, rounded up to the alignment, which must not reach past their last page
+    if (m_gpu->isExtensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostMemoryProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT };
+        VkPhysicalDeviceProperties2 props{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        props.pNext = &hostMemoryProps;
+        VK_CALL(vkGetPhysicalDeviceProperties2, m_gpu->m_physicalDevice, &props);
+        if (hostMemoryProps.minImportedHostPointerAlignment <= MappedFile::getPageSize())
+            m_hostImportAlignment = hostMemoryProps.minImportedHostPointerAlignment;
+    }
+
+    m_asInputUsage = m_gpu->isExtensionEnabled(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) ? static_cast<VkBufferUsageFlags>(VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR) : 0u;
+    // kept across selectScene() and reload(), meshes taken over from an earlier load still live in it
+    // a budget smaller than a block would otherwise be overshot by the first block alone
+    if (!m_geometryArena)
+        m_geometryArena = std::make_shared<GeometryArena>(m_allocator, m_asInputUsage, m_geometryBudget > 0u ? std::min(m_geometryBudget, GeometryArena::DEFAULT_BLOCK_SIZE) : GeometryArena::DEFAULT_BLOCK_SIZE);
+
+    // BC formats need the textureCompressionBC feature, without it textures stay RGBA8
+    m_blockCompression = m_gpu->m_enabledFeatures.features.textureCompressionBC == VK_TRUE && canSample(VK_FORMAT_BC7_SRGB_BLOCK) && canSample(VK_FORMAT_BC5_UNORM_BLOCK);
+
+    size_t extPos = gltfFilename.rfind('.');
+    ret = ret && (extPos != std::string::npos && gltfFilename.compare(extPos, std::string::npos, ".craypack") == 0 ? loadPack(gltfFilename) : loadGltf(gltfFilename, binary));
+
+    // everything has been uploaded, drop the mappings unless a lazily loaded file keeps them for selectScene()
+    if (!ret || !m_model)
+    {
+        m_model.reset();
+        releaseSourceData();
+    }
+
+    SceneEvent ev;
+    ev.type = ret ? SceneEvent::Type::Loaded : SceneEvent::Type::Failed;
+    publish(std::move(ev));
+    return ret;
+}
+
+bool Scene::selectScene(int sceneIdx)
+{
+    bool ret = m_model != nullptr;
+    if (!ret)
+        LOGE("Only glTF files loaded lazily can switch scenes.");
+    else if (sceneIdx < 0 || sceneIdx >= static_cast<int>(m_model->scenes.size()))
+        ret = false, LOGE("glTF scene " + std::to_string(sceneIdx) + " does not exist.");
+    else
+        ret = loadGltfScene(sceneIdx);
+
+    SceneEvent ev;
+    ev.type = ret ? SceneEvent::Type::Loaded : SceneEvent::Type::Failed;
+    publish(std::move(ev));
+    return ret;
+}
+
+bool Scene::reload()
+{
+    bool ret = !m_filename.empty();
+    if (!ret)
+        LOGE("Only glTF files can be reloaded.");
+    else
+        ret = reloadGltf();
+
+    // as after load(), only lazily loaded files keep their source
+    if (!ret || !m_model)
+    {
+        m_model.reset();
+        releaseSourceData();
+    }
+
+    SceneEvent ev;
+    ev.type = ret ? SceneEvent::Type::Loaded : SceneEvent::Type::Failed;
+    publish(std::move(ev));
+    return ret;
+}
+
+bool Scene::reloadGltf()
+{
+    // what the last load created, by content hash, anything the new file has the same of is taken over
+    std::unordered_map<uint64_t, Mesh> oldMeshes;
+    for (size_t i = 0; i < m_meshes.size(); i++)
+    {
+        if (m_meshHashes[i] != 0u && m_meshes[i].indexBuffer)
+            oldMeshes.emplace(m_meshHashes[i], m_meshes[i]);
+    }
+    std::unordered_map<uint64_t, std::shared_ptr<vk::Image>> oldTextures;
+    for (size_t i = 0; i < m_textures.size(); i++)
+    {
+        if (m_textureHashes[i] != 0u && m_textures[i])
+            oldTextures.emplace(m_textureHashes[i], m_textures[i]);
+    }
+    std::unordered_map<uint64_t, std::pair<Material, MaterialViews>> oldMaterials;
+    for (size_t i = 0; i < m_materials.size(); i++)
+    {
+        if (m_materialCreated[i])
+            oldMaterials.emplace(m_materialHashes[i], std::make_pair(m_materials[i], m_materialViews[i]));
+    }
+
+    m_model.reset();
+    releaseSourceData();
+    m_model = std::make_unique<tinygltf::Model>();
+    if (!parseGltf(m_filename, m_binary, *m_model))
+        return false;
+    tinygltf::Model& model = *m_model;
+    if (model.scenes.empty())
+    {
+        LOGE("glTF file \'" + m_filename + "\' has no scenes.");
+        return false;
+    }
+
+    m_meshes.assign(model.meshes.size(), Mesh{});
+    m_materials.assign(model.materials.size(), Material{});
+    m_materialViews.assign(model.materials.size(), MaterialViews{});
+    m_materialCreated.assign(model.materials.size(), false);
+    m_textures.assign(model.textures.size(), nullptr);
+    m_meshHashes.assign(model.meshes.size(), 0u);
+    m_materialHashes.assign(model.materials.size(), 0u);
+    m_textureHashes.assign(model.textures.size(), 0u);
+    m_canonicalImages.assign(model.images.size(), -1);
+    m_imageHashes.assign(model.images.size(), 0u);
+
+    // a lazily loaded file stays on its selected scene if it still has it
+    int sceneIdx = m_lazy && m_sceneIdx < static_cast<int>(model.scenes.size()) ? m_sceneIdx : std::max(0, model.defaultScene);
+    std::vector<bool> meshUsed, materialUsed, textureUsed;
+    markUsed(model, model.scenes[sceneIdx], m_lazy, meshUsed, materialUsed, textureUsed);
+
+    // images are read and hashed up front, only the textures whose bytes or format changed are decoded again
+    std::vector<TextureFormat> formats = gltfTextureFormats(model, m_blockCompression);
+    std::vector<std::vector<unsigned char>> encodedImages(model.images.size());
+    for (size_t i = 0; i < model.textures.size(); i++)
+    {
+        if (!textureUsed[i] || formats[i].format == VK_FORMAT_UNDEFINED)
+            continue;
+
+        int source = textureSource(model, static_cast<int>(i), encodedImages);
+        if (source < 0 || source >= static_cast<int>(model.images.size()))
+            continue;
+
+        if (m_canonicalImages[source] < 0 && !readCanonicalImage(model, source, encodedImages))
+            return false;
+        source = m_canonicalImages[source];
+        m_textureHashes[i] = textureHash(source, formats[i]);
+
+        auto it = oldTextures.find(m_textureHashes[i]);
+        if (it != oldTextures.end())
+        {
+            m_textures[i] = it->second;
+            m_texturesByPayload.emplace(std::make_tuple(source, formats[i].format, formats[i].firstChannel), static_cast<int>(i));
+        }
+    }
+    encodedImages.clear();
+
+    for (size_t i = 0; i < model.meshes.size(); i++)
+    {
+        if (!meshUsed[i])
+            continue;
+
+        uint64_t hash = meshHash(model, static_cast<uint32_t>(i));
+        auto it = oldMeshes.find(hash);
+        if (it == oldMeshes.end())
+            continue;
+
+        // the material may have changed without the geometry
+        int primIdx = findTrianglePrimitive(model.meshes[i]);
+        m_meshes[i] = it->second;
+        m_meshes[i].materialIdx = static_cast<uint32_t>(std::max(0, model.meshes[i].primitives[primIdx].material));
+        m_meshHashes[i] = hash;
+    }
+
+    // materials sampling the same textures keep their views, they are published again as their index may have changed
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+        if (!materialUsed[i])
+            continue;
+
+        bool texturesKept = true;
+        for (int idx : materialTextures(model.materials[i]))
+            texturesKept = texturesKept && (idx < 0 || m_textures[idx]);
+        uint64_t hash = materialHash(model.materials[i]);
+        auto it = oldMaterials.find(hash);
+        if (it == oldMaterials.end() || !texturesKept)
+            continue;
+
+        m_materials[i] = it->second.first;
+        m_materialViews[i] = it->second.second;
+        m_materialCreated[i] = true;
+        m_materialHashes[i] = hash;
+        publishMaterial(static_cast<uint32_t>(i));
+    }
+
+    // everything not taken over is loaded as if a scene reached it for the first time
+    // the node graph is patched in place if its shape didn't change, the instance table is always rebuilt
+    return loadGltfScene(sceneIdx);
+}
+
+void Scene::releaseSourceData()
+{
+    m_meshBufferCache.clear();
+    m_canonicalImages.clear();
+    m_imagesByHash.clear();
+    m_texturesByPayload.clear();
+    m_imageHashes.clear();
+    m_buffers.clear();
+    m_importedBuffers.clear();
+    m_decodedBuffers.clear();
+    m_mappedFiles.clear();
+}
+
+bool Scene::loadGltf(const std::string& gltfFilename, bool binary)
+{
+    m_filename = gltfFilename;
+    m_binary = binary;
+
+    // parse file, buffers stay in the mapped GLB/.bin files and images are read once a texture needs them
+    m_model = std::make_unique<tinygltf::Model>();
+    if (!parseGltf(gltfFilename, binary, *m_model))
+        return false;
+    if (m_model->scenes.empty())
+    {
+        LOGE("glTF file \'" + gltfFilename + "\' has no scenes.");
+        return false;
+    }
+
+    // resources keep their glTF indices, those no scene has reached yet stay empty
+    m_meshes.resize(m_model->meshes.size());
+    m_materials.resize(m_model->materials.size());
+    m_materialViews.resize(m_model->materials.size());
+    m_materialCreated.assign(m_model->materials.size(), false);
+    m_textures.resize(m_model->textures.size());
+    m_meshHashes.assign(m_model->meshes.size(), 0u);
+    m_materialHashes.assign(m_model->materials.size(), 0u);
+    m_textureHashes.assign(m_model->textures.size(), 0u);
+    m_canonicalImages.assign(m_model->images.size(), -1);
+    m_imageHashes.assign(m_model->images.size(), 0u);
+    if (!createPlaceholders())
+        return false;
+
+    // only load default scene, fallback on scene 0
+    bool ret = loadGltfScene(std::max(0, m_model->defaultScene));
+    if (!m_lazy && m_geometryBudget == 0u)
+        m_model.reset();
+    return ret;
+}
+
+bool Scene::loadGltfScene(int sceneIdx)
+{
+    tinygltf::Model& model = *m_model;
+    tinygltf::Scene& scene = model.scenes[sceneIdx];
+
+    m_sceneIdx = sceneIdx;
+    std::vector<bool> meshUsed, materialUsed, textureUsed;
+    markUsed(model, scene, m_lazy, meshUsed, materialUsed, textureUsed);
+
+    // textures decode on the pool while geometry is uploaded here, materials sample placeholders until theirs land
+    TextureLoad textures;
+    if (!startTextureDecode(model, textureUsed, textures))
+        return false;
+
+    std::vector<bool> pendingMaterials(model.materials.size(), false);
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+        if (!materialUsed[i] || m_materialCreated[i])
+            continue;
+
+        m_materialCreated[i] = true;
+        m_materialHashes[i] = materialHash(model.materials[i]);
+        pendingMaterials[i] = !texturesResident(model.materials[i], textures.resident);
+        if (!setMaterial(static_cast<uint32_t>(i), createMaterial(model.materials[i], pendingMaterials[i])))
+            return false;
+    }
+
+    // streamed meshes are left to streamGeometry(), their records start out without addresses
+    if (streaming() && !initStreaming(model, meshUsed))
+        return false;
+    for (size_t i = 0; i < model.meshes.size() && !streaming(); i++)
+    {
+        if (meshUsed[i] && !m_meshes[i].indexBuffer && !createMesh(model, static_cast<uint32_t>(i)))
+            return false;
+    }
+
+    std::shared_ptr<Animator> animator;
+    if (!createNodes(model, scene) || !createAnimator(model, animator) || !createInstanceTable(animator))
+        return false;
+
+    return finishTextures(model, textures, pendingMaterials);
+}
+
+bool Scene::loadPack(const std::string& packFilename)
+{
+    std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+    if (!file->open(packFilename))
+    {
+        LOGE("Failed to map scene pack \'" + packFilename + "\'.");
+        return false;
+    }
+
+    // validate every table and blob against the mapping before touching it
+    const unsigned char* data = file->getData();
+    size_t size = file->getSize();
+    pack::Header header;
+    if (size < sizeof(header))
+    {
+        LOGE("Invalid scene pack \'" + packFilename + "\'.");
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != pack::SCENE_PACK_MAGIC || header.fileSize != size)
+    {
+        LOGE("Invalid scene pack \'" + packFilename + "\'.");
+        return false;
+    }
+    if (header.version != pack::SCENE_PACK_VERSION)
+    {
+        LOGE("Scene pack \'" + packFilename + "\' is version " + std::to_string(header.version) + ", expected " + std::to_string(pack::SCENE_PACK_VERSION) + ". Rebake it.");
+        return false;
+    }
+
+    auto inRange = [size](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+    if (!inRange(header.meshesOffset, sizeof(pack::MeshRecord) * static_cast<uint64_t>(header.meshCount)) || !inRange(header.texturesOffset, sizeof(pack::TextureRecord) * static_cast<uint64_t>(header.textureCount)) ||
+        !inRange(header.materialsOffset, sizeof(pack::MaterialRecord) * static_cast<uint64_t>(header.materialCount)) || !inRange(header.nodesOffset, sizeof(pack::NodeRecord) * static_cast<uint64_t>(header.nodeCount)))
+    {
+        LOGE("Scene pack \'" + packFilename + "\' is truncated.");
+        return false;
+    }
+    const pack::MeshRecord* meshes = reinterpret_cast<const pack::MeshRecord*>(data + header.meshesOffset);
+    const pack::TextureRecord* textures = reinterpret_cast<const pack::TextureRecord*>(data + header.texturesOffset);
+    const pack::MaterialRecord* materials = reinterpret_cast<const pack::MaterialRecord*>(data + header.materialsOffset);
+    const pack::NodeRecord* nodes = reinterpret_cast<const pack::NodeRecord*>(data + header.nodesOffset);
+
+    m_mappedFiles.push_back(std::move(file));
+    BufferSpan packSpan{ data, size, importMappedFile(*m_mappedFiles.back()), 0u };
+
+    // the baker stores identical chains once, records sharing one share the image too
+    std::map<uint64_t, uint32_t> texturesByOffset;
+    m_textures.resize(header.textureCount);
+    for (uint32_t i = 0; i < header.textureCount; i++)
+    {
+        const pack::TextureRecord& tex = textures[i];
+        if (tex.dataSize == 0u)
+            continue;
+
+        auto shared = texturesByOffset.emplace(tex.dataOffset, i);
+        if (!shared.second)
+        {
+            const pack::TextureRecord& first = textures[shared.first->second];
+            if (first.width == tex.width && first.height == tex.height && first.format == tex.format && first.mipCount == tex.mipCount && first.dataSize == tex.dataSize)
+            {
+                m_textures[i] = m_textures[shared.first->second];
+                continue;
+            }
+        }
+
+        // packs baked without a full chain get the missing levels blitted, which host image copy can't do
+        VkExtent3D extent = { tex.width, tex.height, 1u };
+        uint32_t fullLevelCount = mipLevelCount(tex.width, tex.height);
+        uint32_t levelCount = std::min(std::max(tex.mipCount, 1u), fullLevelCount);
+        VkFormat format = static_cast<VkFormat>(tex.format);
+        VkDeviceSize chainSize = vk::getImageSize(format, extent, levelCount);
+        if (chainSize == 0u || !inRange(tex.dataOffset, tex.dataSize) || chainSize > tex.dataSize)
+        {
+            LOGE("Scene pack \'" + packFilename + "\' is truncated.");
+            return false;
+        }
+        // packs are baked block compressed, there is no RGBA8 fallback for them
+        bool blockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+        if ((blockCompressed && !m_blockCompression) || !canSample(format))
+        {
+            LOGE("Scene pack \'" + packFilename + "\' holds textures in a format the device can't sample.");
+            return false;
+        }
+
+        if (levelCount == fullLevelCount && canHostCopy(format))
+        {
+            m_textures[i] = createTexture(extent, format, levelCount, data + tex.dataOffset);
+        }
+        else if (packSpan.hostBuffer)
+        {
+            m_textures[i] = createTexture(extent, format, levelCount, *packSpan.hostBuffer, tex.dataOffset);
+        }
+        else
+        {
+            vk::Buffer stagingBuf(m_allocator);
+            void* staging;
+            if (!stagingBuf.create(chainSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || !stagingBuf.map(&staging))
+                return false;
+            memcpy(staging, data + tex.dataOffset, static_cast<size_t>(chainSize));
+            stagingBuf.unmap();
+            m_textures[i] = createTexture(extent, format, levelCount, stagingBuf);
+        }
+        if (!m_textures[i])
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        const int32_t slots[] = { materials[i].albedo, materials[i].metallicRoughness, materials[i].normal, materials[i].emissive };
+        std::shared_ptr<vk::Image> images[4];
+        for (int s = 0; s < 4; s++)
+        {
+            if (slots[s] < 0)
+                continue;
+            if (static_cast<uint32_t>(slots[s]) >= header.textureCount || !m_textures[slots[s]])
+            {
+                LOGE("Scene pack material references a missing texture.");
+                return false;
+            }
+            images[s] = m_textures[slots[s]];
+        }
+
+        Material mat;
+        mat.albedo = images[0];
+        mat.metallicRoughness = images[1];
+        mat.normal = images[2];
+        mat.emissive = images[3];
+        if (!addMaterial(mat))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        const pack::MeshRecord& rec = meshes[i];
+        Mesh m;
+        m.indexCount = rec.indexCount;
+        m.vertexCount = rec.vertexCount;
+        m.indexType = static_cast<VkIndexType>(rec.indexType);
+        m.materialIdx = rec.materialIdx;
+
+        size_t indexSize = m.indexType == VK_INDEX_TYPE_UINT16 ? 2u : 4u;
+        if (!inRange(rec.indexOffset, indexSize * rec.indexCount) || !inRange(rec.positionOffset, 12u * static_cast<uint64_t>(rec.vertexCount)) || !inRange(rec.normalOffset, 12u * static_cast<uint64_t>(rec.vertexCount)) ||
+            !inRange(rec.tangentOffset, 16u * static_cast<uint64_t>(rec.vertexCount)) || !inRange(rec.texCoordOffset, 8u * static_cast<uint64_t>(rec.vertexCount)) ||
+            !inRange(rec.meshletOffset, sizeof(Meshlet) * static_cast<uint64_t>(rec.meshletCount)) || !inRange(rec.meshletVertexOffset, 4u * static_cast<uint64_t>(rec.meshletVertexCount)) ||
+            !inRange(rec.meshletTriangleOffset, rec.meshletTriangleSize))
+        {
+            LOGE("Scene pack \'" + packFilename + "\' is truncated.");
+            return false;
+        }
+
+        m.indexBuffer = createBuffer(packSpan, rec.indexOffset, indexSize, rec.indexCount, 0u);
+        m.positionBuffer = createBuffer(packSpan, rec.positionOffset, 3u * sizeof(float), rec.vertexCount, 0u);
+        m.normalBuffer = createBuffer(packSpan, rec.normalOffset, 3u * sizeof(float), rec.vertexCount, 0u);
+        m.tangentBuffer = createBuffer(packSpan, rec.tangentOffset, 4u * sizeof(float), rec.vertexCount, 0u);
+        m.texCoordBuffer = createBuffer(packSpan, rec.texCoordOffset, 2u * sizeof(float), rec.vertexCount, 0u);
+        if (!m.indexBuffer || !m.positionBuffer || !m.normalBuffer || !m.tangentBuffer || !m.texCoordBuffer)
+            return false;
+
+        if (rec.meshletCount > 0u)
+        {
+            m.meshletCount = rec.meshletCount;
+            m.meshletBuffer = createBuffer(packSpan, rec.meshletOffset, sizeof(Meshlet), rec.meshletCount, 0u);
+            m.meshletVertexBuffer = createBuffer(packSpan, rec.meshletVertexOffset, sizeof(uint32_t), rec.meshletVertexCount, 0u);
+            m.meshletTriangleBuffer = createBuffer(packSpan, rec.meshletTriangleOffset, 1u, rec.meshletTriangleSize, 0u);
+            if (!m.meshletBuffer || !m.meshletVertexBuffer || !m.meshletTriangleBuffer)
+                return false;
+        }
+
+        m_meshes.push_back(m);
+    }
+
+    // parents precede children, so the records map one to one onto scene graph nodes
+    for (uint32_t i = 0; i < header.nodeCount; i++)
+    {
+        const pack::NodeRecord& rec = nodes[i];
+        if ((rec.mesh != SceneGraph::NO_MESH && rec.mesh >= m_meshes.size()) || rec.parent >= static_cast<int32_t>(i))
+        {
+            LOGE("Scene pack \'" + packFilename + "\' has an invalid node hierarchy.");
+            return false;
+        }
+        m_sceneGraph.addNode(rec.parent, rec.mesh, glm::make_mat4(rec.localTransform));
+    }
+
+    return createInstanceTable();
+}
+
+const vk::Buffer* Scene::importMappedFile(const MappedFile& file)
+{
+    if (m_hostImportAlignment == 0u || reinterpret_cast<uintptr_t>(file.getData()) % m_hostImportAlignment != 0u)
+        return nullptr;
+
+    VkDeviceSize size = (static_cast<VkDeviceSize>(file.getSize()) + m_hostImportAlignment - 1u) / m_hostImportAlignment * m_hostImportAlignment;
+    std::unique_ptr<vk::Buffer> hostBuf = std::make_unique<vk::Buffer>(m_allocator);
+    // some drivers only import anonymous memory, those fall back to staging copies
+    if (!hostBuf->importHostMemory(file.getData(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
+        return nullptr;
+
+    m_importedBuffers.push_back(std::move(hostBuf));
+    return m_importedBuffers.back().get();
+}
+
+bool Scene::parseGltf(const std::string& gltfFilename, bool binary, tinygltf::Model& model)
+{
+    std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+    if (!file->open(gltfFilename))
+    {
+        LOGE("Failed to map glTF file \'" + gltfFilename + "\'.");
+        return false;
+    }
+
+    const unsigned char* json = file->getData();
+    size_t jsonSize = file->getSize();
+    BufferSpan binChunk{ nullptr, 0u, nullptr, 0u };
+    if (binary)
+    {
+        // 12 byte header, then a JSON chunk and an optional BIN chunk, each preceded by its length and type
+        const unsigned char* data = file->getData();
+        uint32_t totalLength = 0u, jsonLength = 0u, jsonType = 0u;
+        if (file->getSize() >= 20u)
+        {
+            memcpy(&totalLength, data + 8, 4u);
+            memcpy(&jsonLength, data + 12, 4u);
+            memcpy(&jsonType, data + 16, 4u);
+        }
+        if (file->getSize() < 20u || memcmp(data, "glTF", 4u) != 0 || totalLength > file->getSize() || 20u + static_cast<size_t>(jsonLength) > totalLength || jsonType != 0x4E4F534Au)
+        {
+            LOGE("Invalid GLB file \'" + gltfFilename + "\'.");
+            return false;
+        }
+        json = data + 20;
+        jsonSize = jsonLength;
+
+        size_t binOffset = 20u + static_cast<size_t>(jsonLength);
+        if (binOffset + 8u <= totalLength)
+        {
+            uint32_t binLength, binType;
+            memcpy(&binLength, data + binOffset, 4u);
+            memcpy(&binType, data + binOffset + 4, 4u);
+            if (binType == 0x004E4942u && binOffset + 8u + binLength <= totalLength)
+                binChunk = { data + binOffset + 8, binLength, nullptr, binOffset + 8u };
+        }
+    }
+
+    nlohmann::json doc = nlohmann::json::parse(json, json + jsonSize, nullptr, false);
+    if (doc.is_discarded())
+    {
+        LOGE("Failed to parse glTF JSON in \'" + gltfFilename + "\'.");
+        return false;
+    }
+    // imported host memory must outlive its buffer, so the mapping is only imported once the scene keeps it
+    m_mappedFiles.push_back(std::move(file));
+    if (binChunk.data)
+        binChunk.hostBuffer = importMappedFile(*m_mappedFiles.back());
+
+    std::string baseDir = gltfFilename.substr(0, gltfFilename.find_last_of("/\\") + 1);
+
+    // resolve buffers here, tinygltf would read every one of them into a vector
+    nlohmann::json::iterator buffers = doc.find("buffers");
+    if (buffers != doc.end())
+    {
+        for (nlohmann::json& buf : *buffers)
+        {
+            size_t byteLength = buf.value("byteLength", static_cast<size_t>(0u));
+            std::string uri = buf.value("uri", std::string());
+
+            // EXT_meshopt_compression fallback buffers have no data, only the decoded views are read
+            BufferSpan span{ nullptr, 0u, nullptr, 0u };
+            nlohmann::json::const_iterator extensions = buf.find("extensions");
+            if (extensions != buf.end() && extensions->contains("EXT_meshopt_compression") && (*extensions)["EXT_meshopt_compression"].value("fallback", false))
+            {
+                m_buffers.push_back(span);
+                continue;
+            }
+
+            if (uri.empty())
+            {
+                span = binChunk;
+            }
+            else if (uri.compare(0, 5, "data:") == 0)
+            {
+                m_decodedBuffers.emplace_back();
+                std::string mimeType;
+                if (!tinygltf::DecodeDataURI(&m_decodedBuffers.back(), mimeType, uri, byteLength, true))
+                {
+                    LOGE("Failed to decode glTF buffer data URI.");
+                    return false;
+                }
+                span = { m_decodedBuffers.back().data(), m_decodedBuffers.back().size(), nullptr, 0u };
+            }
+            else
+            {
+                std::string path;
+                tinygltf::URIDecode(uri, &path, nullptr);
+                std::unique_ptr<MappedFile> binFile = std::make_unique<MappedFile>();
+                if (!binFile->open(baseDir + path))
+                {
+                    LOGE("Failed to map glTF buffer \'" + baseDir + path + "\'.");
+                    return false;
+                }
+                m_mappedFiles.push_back(std::move(binFile));
+                span = { m_mappedFiles.back()->getData(), m_mappedFiles.back()->getSize(), importMappedFile(*m_mappedFiles.back()), 0u };
+            }
+
+            if (span.size < byteLength)
+            {
+                LOGE("glTF buffer is smaller than its byteLength.");
+                return false;
+            }
+            span.size = byteLength;
+            m_buffers.push_back(span);
+        }
+        doc.erase(buffers);
+    }
+
+    if (!decodeMeshoptViews(doc, m_buffers, m_decodedBuffers))
+        return false;
+
+    // no Draco decoder is built in, files only usable with it are rejected here rather than read as garbage
+    nlohmann::json::iterator required = doc.find("extensionsRequired");
+    if (required != doc.end() && std::find(required->begin(), required->end(), "KHR_draco_mesh_compression") != required->end())
+    {
+        LOGE("glTF file \'" + gltfFilename + "\' requires KHR_draco_mesh_compression, which is not supported.");
+        return false;
+    }
+
+    // images are kept out of tinygltf, which would read every one of them, readImage() reads them on demand
+    // without buffers tinygltf couldn't resolve buffer view images anyway, they become pseudo paths into the mapped buffers
+    std::vector<tinygltf::Image> gltfImages;
+    nlohmann::json::iterator images = doc.find("images");
+    nlohmann::json::iterator bufferViews = doc.find("bufferViews");
+    if (images != doc.end())
+    {
+        for (nlohmann::json& img : *images)
+        {
+            nlohmann::json::iterator bufferView = img.find("bufferView");
+            if (bufferView == img.end())
+                continue;
+
+            size_t viewIdx = bufferView->get<size_t>();
+            if (bufferViews == doc.end() || viewIdx >= bufferViews->size())
+            {
+                LOGE("glTF image references a missing buffer view.");
+                return false;
+            }
+            const nlohmann::json& view = (*bufferViews)[viewIdx];
+            img.erase(bufferView);
+            img["uri"] = s_bufferImagePrefix + std::to_string(view.value("buffer", 0)) + "-" + std::to_string(view.value("byteOffset", static_cast<size_t>(0u))) + "-" + std::to_string(view.value("byteLength", static_cast<size_t>(0u)));
+        }
+
+        // file URIs are resolved against the glTF's directory here, data URIs and buffer views are kept as they are
+        for (const nlohmann::json& img : *images)
+        {
+            tinygltf::Image image;
+            image.name = img.value("name", std::string());
+            image.mimeType = img.value("mimeType", std::string());
+            std::string uri = img.value("uri", std::string());
+            size_t buffer, offset, length;
+            if (uri.empty())
+            {
+                LOGE("glTF image has neither a uri nor a buffer view.");
+                return false;
+            }
+            else if (uri.compare(0, 5, "data:") == 0 || parseBufferImagePath(uri, &buffer, &offset, &length))
+            {
+                image.uri = uri;
+            }
+            else
+            {
+                std::string path;
+                tinygltf::URIDecode(uri, &path, nullptr);
+                image.uri = baseDir + path;
+            }
+            gltfImages.push_back(image);
+        }
+        doc.erase(images);
+    }
+
+    tinygltf::TinyGLTF loader;
+
+    std::string gltfJson = doc.dump();
+    std::string warn;
+    std::string err;
+    bool ret = loader.LoadASCIIFromString(&model, &err, &warn, gltfJson.c_str(), static_cast<unsigned int>(gltfJson.size()), baseDir);
+    if (!warn.empty())
+        LOGW(warn);
+    if (!err.empty())
+        LOGE(err);
+    if (!ret)
+    {
+        LOGE("Failed to parse glTF file \'" + gltfFilename + "\'.");
+        return false;
+    }
+    model.images = std::move(gltfImages);
+
+    return true;
+}
+
+bool Scene::readImage(const tinygltf::Image& image, std::vector<unsigned char>& bytes) const
+{
+    std::string err;
+    std::string mimeType;
+    bool ret = image.uri.compare(0, 5, "data:") == 0 ? tinygltf::DecodeDataURI(&bytes, mimeType, image.uri, 0u, false) : readBufferImage(&bytes, &err, image.uri, m_buffers);
+    if (!ret || bytes.empty())
+    {
+        LOGE("Failed to read glTF image \'" + (image.uri.compare(0, 5, "data:") == 0 ? image.name : image.uri) + "\'" + (err.empty() ? "." : ": " + err));
+        return false;
+    }
+    return true;
+}
+
+bool Scene::canHostCopy(VkFormat format) const
+{
+    if (!m_hostImageCopy)
+        return false;
+
+    VkFormatProperties3 formatProps3{ VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3 };
+    VkFormatProperties2 formatProps{ VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2 };
+    formatProps.pNext = &formatProps3;
+    VK_CALL(vkGetPhysicalDeviceFormatProperties2, m_gpu->m_physicalDevice, format, &formatProps);
+    return (formatProps3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT) != 0u;
+}
+
+bool Scene::canBlitMips(VkFormat format) const
+{
+    VkFormatProperties formatProps;
+    VK_CALL(vkGetPhysicalDeviceFormatProperties, m_gpu->m_physicalDevice, format, &formatProps);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProps.optimalTilingFeatures & required) == required;
+}
+
+bool Scene::canSample(VkFormat format) const
+{
+    VkFormatProperties formatProps;
+    VK_CALL(vkGetPhysicalDeviceFormatProperties, m_gpu->m_physicalDevice, format, &formatProps);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (formatProps.optimalTilingFeatures & required) == required;
+}
+
+bool Scene::beginUpload()
+{
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult res = VK_CALL(vkBeginCommandBuffer, *m_cmdBuf, &beginInfo);
+    return res == VK_SUCCESS;
+}
+
+bool Scene::endUpload()
+{
+    VkResult res = VK_CALL(vkEndCommandBuffer, *m_cmdBuf);
+    if (res != VK_SUCCESS)
+        return false;
+
+    return m_gpu->submitAndWait(m_queue, *m_cmdBuf);
+}
+
+std::vector<TextureFormat> gltfTextureFormats(const tinygltf::Model& model, bool compressed)
+{
+    // colour textures are sRGB, the rest linear
+    // compressed colour is BC7, normals keep XY and roughness/metallic (G/B in glTF) their two channels in BC5
+    std::vector<TextureFormat> formats(model.textures.size(), { VK_FORMAT_UNDEFINED, 0u });
+    for (const tinygltf::Material& mat : model.materials)
+    {
+        if (mat.pbrMetallicRoughness.baseColorTexture.index > -1)
+            formats[mat.pbrMetallicRoughness.baseColorTexture.index] = { compressed ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB, 0u };
+        if (mat.pbrMetallicRoughness.metallicRoughnessTexture.index > -1)
+            formats[mat.pbrMetallicRoughness.metallicRoughnessTexture.index] = { compressed ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM, 1u };
+        if (mat.normalTexture.index > -1)
+            formats[mat.normalTexture.index] = { compressed ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM, 0u };
+        if (mat.emissiveTexture.index > -1)
+            formats[mat.emissiveTexture.index] = { compressed ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB, 0u };
+    }
+    return formats;
+}
+
+bool isSrgbFormat(VkFormat format)
+{
+    return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// the sRGB or UNORM variant of a raw KTX2 format, as the texture sampling it asks for, formats without one are returned as is
+static VkFormat colorSpaceVariant(VkFormat format, bool srgb)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+        return srgb ? VK_FORMAT_BC2_SRGB_BLOCK : VK_FORMAT_BC2_UNORM_BLOCK;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    default:
+        return format;
+    }
+}
+
+void encodeTexture(const TextureFormat& format, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, unsigned char* dst)
+{
+    switch (format.format)
+    {
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        compressBC5(dst, chain, width, height, levelCount, format.firstChannel);
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        compressBC7(dst, chain, width, height, levelCount);
+        break;
+    default:
+        memcpy(dst, chain, mipChainSize(width, height, levelCount));
+        break;
+    }
+}
+
+glm::mat4 gltfLocalTransform(const tinygltf::Node& node)
+{
+    if (!node.matrix.empty())
+        return glm::make_mat4(node.matrix.data());
+
+    glm::mat4 T(1.0f), R(1.0f), S(1.0f);
+    if (!node.translation.empty())
+        T = glm::translate(glm::mat4(1.0f), glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
+    if (!node.rotation.empty())
+        R = glm::toMat4(glm::quat(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2])));
+    if (!node.scale.empty())
+        S = glm::scale(glm::mat4(1.0f), glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+
+    return T * R * S;
+}
+
+bool Scene::readCanonicalImage(const tinygltf::Model& model, int imageIdx, std::vector<std::vector<unsigned char>>& encodedImages)
+{
+    std::vector<unsigned char>& bytes = encodedImages[imageIdx];
+    if (bytes.empty() && !readImage(model.images[imageIdx], bytes))
+        return false;
+
+    // images read earlier have released their bytes and are only matched by the ones read along with them
+    m_canonicalImages[imageIdx] = imageIdx;
+    m_imageHashes[imageIdx] = hashBytes(bytes.data(), bytes.size());
+    auto range = m_imagesByHash.equal_range(m_imageHashes[imageIdx]);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (encodedImages[it->second] == bytes)
+        {
+            m_canonicalImages[imageIdx] = it->second;
+            std::vector<unsigned char>().swap(bytes);
+            break;
+        }
+    }
+    if (m_canonicalImages[imageIdx] == imageIdx)
+        m_imagesByHash.emplace(m_imageHashes[imageIdx], imageIdx);
+    return true;
+}
+
+int Scene::textureSource(const tinygltf::Model& model, int textureIdx, std::vector<std::vector<unsigned char>>& encodedImages)
+{
+    // KHR_texture_basisu points at the KTX2 image, source is then a fallback for loaders without KTX2 support, if present at all
+    const tinygltf::Texture& texture = model.textures[textureIdx];
+    tinygltf::ExtensionMap::const_iterator basisu = texture.extensions.find("KHR_texture_basisu");
+    if (basisu == texture.extensions.end() || !basisu->second.Has("source"))
+        return texture.source;
+
+    int source = basisu->second.Get("source").GetNumberAsInt();
+    int imageCount = static_cast<int>(model.images.size());
+    if (source < 0 || source >= imageCount || texture.source < 0 || texture.source >= imageCount)
+        return source;
+
+    // BasisLZ, UASTC and other payloads decodeKtx2() rejects use the PNG/JPEG fallback instead
+    std::vector<unsigned char>& bytes = encodedImages[source];
+    bool read = bytes.empty();
+    if (read && !readImage(model.images[source], bytes))
+        return texture.source;
+
+    bool decodable = true;
+    Ktx2Image ktx;
+    std::string error;
+    if (isKtx2(bytes.data(), bytes.size()))
+        decodable = parseKtx2(bytes.data(), bytes.size(), ktx, error) && canDecodeKtx2(ktx, error);
+
+    // the bytes are only kept for readCanonicalImage(), images matched earlier don't read them again
+    if (!decodable || (read && m_canonicalImages[source] >= 0))
+        std::vector<unsigned char>().swap(bytes);
+    if (!decodable)
+    {
+        LOGW("glTF texture " + std::to_string(textureIdx) + " falls back to its plain source, " + error);
+        return texture.source;
+    }
+    return source;
+}
+
+uint64_t Scene::textureHash(int canonicalImage, const TextureFormat& format) const
+{
+    return hashBytes(&format, sizeof(format), m_imageHashes[canonicalImage]);
+}
+
+uint64_t Scene::materialHash(const tinygltf::Material& material) const
+{
+    // textures are all that is read of a material so far, slots without one hash as 0
+    uint64_t slots[4];
+    std::array<int, 4> textures = materialTextures(material);
+    for (size_t i = 0; i < textures.size(); i++)
+        slots[i] = textures[i] > -1 ? m_textureHashes[textures[i]] : 0u;
+    return hashBytes(slots, sizeof(slots));
+}
+
+uint64_t Scene::meshHash(const tinygltf::Model& model, uint32_t meshIdx) const
+{
+    // the attributes createMesh() reads, including the shape of their accessors, 0 if any of them can't be read
+    // missing attributes only count as missing
+    const tinygltf::Mesh& mesh = model.meshes[meshIdx];
+    int primIdx = findTrianglePrimitive(mesh);
+    if (primIdx == -1)
+        return 0u;
+
+    const tinygltf::Primitive& prim = mesh.primitives[primIdx];
+    std::vector<int> accessors = { prim.indices };
+    for (const char* attribute : { "POSITION", "NORMAL", "TANGENT", "TEXCOORD_0", "JOINTS_0", "WEIGHTS_0" })
+    {
+        auto it = prim.attributes.find(attribute);
+        accessors.push_back(it != prim.attributes.end() ? it->second : -1);
+    }
+    for (const std::map<std::string, int>& target : prim.targets)
+    {
+        for (const char* attribute : { "POSITION", "NORMAL", "TANGENT" })
+        {
+            auto it = target.find(attribute);
+            accessors.push_back(it != target.end() ? it->second : -1);
+        }
+    }
+
+    uint64_t hash = 0u;
+    for (int a : accessors)
+    {
+        if (a < 0)
+        {
+            hash = hashBytes(&a, sizeof(a), hash);
+            continue;
+        }
+        if (model.accessors[a].bufferView < 0)
+            return 0u;
+
+        const tinygltf::Accessor& accessor = model.accessors[a];
+        const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+        const BufferSpan& span = m_buffers[view.buffer];
+        size_t elemSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type));
+        size_t stride = view.byteStride > 0u ? view.byteStride : elemSize;
+        size_t offset = view.byteOffset + accessor.byteOffset;
+        size_t size = accessor.count > 0u ? (accessor.count - 1u) * stride + elemSize : 0u;
+        if (!span.data || offset > span.size || size > span.size - offset)
+            return 0u;
+
+        // interleaved views hash the attributes in between too, which can only cost a needless upload
+        uint64_t shape[] = { accessor.count, static_cast<uint64_t>(accessor.componentType), elemSize, stride };
+        hash = hashBytes(shape, sizeof(shape), hash);
+        hash = hashBytes(span.data + offset, size, hash);
+    }
+    return hash;
+}
+
+bool Scene::startTextureDecode(tinygltf::Model& model, const std::vector<bool>& textureUsed, TextureLoad& load)
+{
+    // textures no material samples are skipped, formats depend on every material so they don't change between scenes
+    load.formats = gltfTextureFormats(model, m_blockCompression);
+    load.encodedImages.resize(model.images.size());
+    load.sources.assign(model.textures.size(), -1);
+    load.sharedTextures.assign(model.textures.size(), -1);
+    load.resident.resize(model.textures.size());
+    for (size_t i = 0; i < model.textures.size(); i++)
+        load.resident[i] = m_textures[i] != nullptr;
+
+    for (size_t i = 0; i < model.textures.size(); i++)
+    {
+        if (!textureUsed[i] || load.resident[i] || load.formats[i].format == VK_FORMAT_UNDEFINED)
+            continue;
+
+        int source = textureSource(model, static_cast<int>(i), load.encodedImages);
+        if (source < 0 || source >= static_cast<int>(model.images.size()))
+            continue;
+
+        if (m_canonicalImages[source] < 0 && !readCanonicalImage(model, source, load.encodedImages))
+            return false;
+        source = m_canonicalImages[source];
+        m_textureHashes[i] = textureHash(source, load.formats[i]);
+
+        // one texture is decoded per image and format, the others sampling the same payload share its image
+        auto inserted = m_texturesByPayload.emplace(std::make_tuple(source, load.formats[i].format, load.formats[i].firstChannel), static_cast<int>(i));
+        int owner = inserted.first->second;
+        if (!inserted.second && load.resident[owner])
+        {
+            m_textures[i] = m_textures[owner];
+            load.resident[i] = true;
+        }
+        else if (!inserted.second)
+        {
+            load.sharedTextures[i] = owner;
+        }
+        else
+        {
+            // the canonical image may have been decoded for another format by an earlier scene
+            if (load.encodedImages[source].empty() && !readImage(model.images[source], load.encodedImages[source]))
+                return false;
+            load.sources[i] = source;
+        }
+    }
+
+    // an image is copied from the host only if every texture sampling it can be
+    std::vector<bool> imageUsed(model.images.size(), false);
+    std::vector<bool> imageHostCopy(model.images.size(), true);
+    for (size_t i = 0; i < model.textures.size(); i++)
+    {
+        if (load.sources[i] < 0)
+            continue;
+
+        imageUsed[load.sources[i]] = true;
+        imageHostCopy[load.sources[i]] = imageHostCopy[load.sources[i]] && canHostCopy(load.formats[i].format);
+    }
+
+    // images decode on the pool in any order, finishTextures() uploads each one as soon as it completes
+    load.decodedImages.resize(model.images.size());
+    load.results.resize(model.images.size());
+    for (int i = 0; i < static_cast<int>(model.images.size()); i++)
+    {
+        if (!imageUsed[i])
+            continue;
+
+        load.pendingCount++;
+        bool hostCopy = imageHostCopy[i];
+        load.results[i] = load.pool.submit([this, &load, i, hostCopy]() {
+            bool ret = decodeImage(load.sources, i, load.formats, hostCopy, load.encodedImages[i], load.decodedImages[i]);
+            {
+                std::lock_guard<std::mutex> lock(load.decodedMutex);
+                load.decoded.push_back(i);
+            }
+            load.decodedCond.notify_one();
+            return ret;
+        });
+    }
+    return true;
+}
+
+bool Scene::finishTextures(tinygltf::Model& model, TextureLoad& load, std::vector<bool>& pendingMaterials)
+{
+    for (; load.pendingCount > 0; load.pendingCount--)
+    {
+        int imageIdx;
+        {
+            std::unique_lock<std::mutex> lock(load.decodedMutex);
+            load.decodedCond.wait(lock, [&load]() { return !load.decoded.empty(); });
+            imageIdx = load.decoded.back();
+            load.decoded.pop_back();
+        }
+
+        DecodedImage& img = load.decodedImages[imageIdx];
+        if (!load.results[imageIdx].get())
+        {
+            tinygltf::Image& gltfImg = model.images[imageIdx];
+            LOGE("Failed to load glTF image \'" + (gltfImg.uri.empty() ? gltfImg.name : gltfImg.uri) + "\': " + img.error);
+            return false;
+        }
+
+        // host copied textures were already created on the worker
+        for (std::pair<size_t, std::unique_ptr<vk::Buffer>>& staging : img.staging)
+        {
+            VkFormat format = load.formats[staging.first].format;
+            if (img.format != VK_FORMAT_UNDEFINED)
+                format = colorSpaceVariant(img.format, isSrgbFormat(format));
+            m_textures[staging.first] = createTexture(img.extent, format, img.levelCount, *staging.second);
+            if (!m_textures[staging.first])
+                return false;
+        }
+        img.staging.clear();
+
+        // the textures decoded from the image and the ones sharing them are resident now
+        for (size_t i = 0; i < model.textures.size(); i++)
+        {
+            size_t owner = load.sharedTextures[i] >= 0 ? static_cast<size_t>(load.sharedTextures[i]) : i;
+            if (load.sources[owner] != imageIdx)
+                continue;
+
+            m_textures[i] = m_textures[owner];
+            load.resident[i] = true;
+        }
+
+        // swap the placeholders of every material whose textures are all resident
+        for (size_t i = 0; i < model.materials.size(); i++)
+        {
+            if (!pendingMaterials[i] || !texturesResident(model.materials[i], load.resident))
+                continue;
+
+            pendingMaterials[i] = false;
+            if (!setMaterial(static_cast<uint32_t>(i), createMaterial(model.materials[i], false)))
+                return false;
+        }
+    }
+
+    for (size_t i = 0; i < model.materials.size(); i++)
+    {
+        if (pendingMaterials[i])
+        {
+            LOGE("glTF material \'" + model.materials[i].name + "\' samples a texture without an image.");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// expands 8-bit grey, grey-alpha, RGB or RGBA texels to tightly packed RGBA, alpha defaults to opaque
+static void expandToRGBA(unsigned char* dst, const unsigned char* src, size_t texelCount, int comp)
+{
+    if (comp == 4)
+    {
+        memcpy(dst, src, texelCount * 4u);
+        return;
+    }
+
+    for (size_t i = 0; i < texelCount; i++, dst += 4, src += comp)
+    {
+        dst[0] = src[0];
+        dst[1] = comp >= 3 ? src[1] : src[0];
+        dst[2] = comp >= 3 ? src[2] : src[0];
+        dst[3] = comp == 2 ? src[1] : 255u;
+    }
+}
+
+bool Scene::decodeImage(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, std::vector<unsigned char>& encoded, DecodedImage& decoded)
+{
+    if (isKtx2(encoded.data(), encoded.size()))
+    {
+        bool ret = decodeKtx2(sources, imageIdx, formats, hostCopy, encoded, decoded);
+        std::vector<unsigned char>().swap(encoded);
+        return ret;
+    }
+
+    // decode in the file's channel count, RGBA expansion happens while building the mip chain
+    int width, height, comp;
+    stbi_uc* texels = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &width, &height, &comp, 0);
+    std::vector<unsigned char>().swap(encoded);
+    if (!texels)
+    {
+        decoded.error = stbi_failure_reason();
+        return false;
+    }
+
+    bool ret = encodeImage(sources, imageIdx, formats, hostCopy, texels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), comp, decoded);
+    stbi_image_free(texels);
+    return ret;
+}
+
+bool Scene::canDecodeKtx2(const Ktx2Image& ktx, std::string& error) const
+{
+    // raw BCn and RGBA8 containers only, Basis Universal (BasisLZ, UASTC) needs its transcoder and Zstandard/ZLIB their decompressors
+    if (ktx.supercompressionScheme != 0u || ktx.format == VK_FORMAT_UNDEFINED)
+    {
+        error = "Basis Universal and supercompressed KTX2 are not supported, only raw BCn and RGBA8.";
+        return false;
+    }
+
+    if (ktx.format == VK_FORMAT_R8G8B8A8_UNORM || ktx.format == VK_FORMAT_R8G8B8A8_SRGB)
+        return true;
+
+    if (ktx.format < VK_FORMAT_BC1_RGB_UNORM_BLOCK || ktx.format > VK_FORMAT_BC7_SRGB_BLOCK)
+    {
+        error = "KTX2 format " + std::to_string(ktx.format) + " is neither BCn nor RGBA8.";
+        return false;
+    }
+
+    // either variant may be asked for by the textures sampling the image
+    if (!m_blockCompression || !canSample(colorSpaceVariant(ktx.format, false)) || !canSample(colorSpaceVariant(ktx.format, true)))
+    {
+        error = "KTX2 format " + std::to_string(ktx.format) + " can't be sampled by the device.";
+        return false;
+    }
+    return true;
+}
+
+bool Scene::decodeKtx2(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, const std::vector<unsigned char>& encoded, DecodedImage& decoded)
+{
+    Ktx2Image ktx;
+    if (!parseKtx2(encoded.data(), encoded.size(), ktx, decoded.error))
+        return false;
+
+    if (!canDecodeKtx2(ktx, decoded.error))
+        return false;
+
+    // plain RGBA8 gets the same mip generation and compression as any decoded image
+    if (ktx.format == VK_FORMAT_R8G8B8A8_UNORM || ktx.format == VK_FORMAT_R8G8B8A8_SRGB)
+    {
+        if (ktx.levels[0].size < static_cast<uint64_t>(ktx.width) * ktx.height * 4u)
+        {
+            decoded.error = "truncated KTX2 level 0.";
+            return false;
+        }
+        return encodeImage(sources, imageIdx, formats, hostCopy, encoded.data() + ktx.levels[0].offset, ktx.width, ktx.height, 4, decoded);
+    }
+
+    // block compressed levels are uploaded as stored, in the sRGB or UNORM variant of the container's format each texture asks for
+    decoded.extent = { ktx.width, ktx.height, 1u };
+    decoded.levelCount = std::min(static_cast<uint32_t>(ktx.levels.size()), mipLevelCount(ktx.width, ktx.height));
+    decoded.format = ktx.format;
+
+    // levels are stored smallest first, the upload wants them level 0 first
+    std::vector<unsigned char> chain(static_cast<size_t>(vk::getImageSize(ktx.format, decoded.extent, decoded.levelCount)));
+    size_t chainOffset = 0u;
+    for (uint32_t level = 0u; level < decoded.levelCount; level++)
+    {
+        VkExtent3D levelExtent = { std::max(ktx.width >> level, 1u), std::max(ktx.height >> level, 1u), 1u };
+        size_t levelSize = static_cast<size_t>(vk::getImageSize(ktx.format, levelExtent));
+        if (ktx.levels[level].size < levelSize)
+        {
+            decoded.error = "truncated KTX2 level " + std::to_string(level) + ".";
+            return false;
+        }
+        memcpy(chain.data() + chainOffset, encoded.data() + ktx.levels[level].offset, levelSize);
+        chainOffset += levelSize;
+    }
+
+    // host image copy can't generate the levels a container leaves out
+    bool fullChain = decoded.levelCount == mipLevelCount(ktx.width, ktx.height);
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (sources[i] != imageIdx)
+            continue;
+
+        VkFormat format = colorSpaceVariant(ktx.format, isSrgbFormat(formats[i].format));
+        if (hostCopy && fullChain && canHostCopy(format))
+        {
+            m_textures[i] = createTexture(decoded.extent, format, decoded.levelCount, chain.data());
+            if (!m_textures[i])
+            {
+                decoded.error = "host image copy failed.";
+                return false;
+            }
+        }
+        else
+        {
+            std::unique_ptr<vk::Buffer> staging = std::make_unique<vk::Buffer>(m_allocator);
+            void* data;
+            if (!staging->create(static_cast<VkDeviceSize>(chain.size()), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || !staging->map(&data))
+            {
+                decoded.error = "failed to create staging buffer.";
+                return false;
+            }
+            memcpy(data, chain.data(), chain.size());
+            staging->unmap();
+            decoded.staging.emplace_back(i, std::move(staging));
+        }
+    }
+
+    return true;
+}
+
+bool Scene::encodeImage(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, const unsigned char* texels, uint32_t width, uint32_t height, int comp, DecodedImage& decoded)
+{
+    decoded.extent = { width, height, 1u };
+    decoded.levelCount = mipLevelCount(width, height);
+
+    // every texture sampling the image is encoded in its own format, straight into its staging memory, which is only ever written
+    // host image copy needs the whole encoded chain on the host instead
+    struct Target
+    {
+        size_t texture;
+        std::unique_ptr<vk::Buffer> staging;
+        std::vector<unsigned char> host;
+        unsigned char* data = nullptr;
+        VkDeviceSize levelOffset = 0u;
+    };
+    std::vector<Target> targets;
+    auto unmapTargets = [&targets]() {
+        for (Target& t : targets)
+        {
+            if (t.staging && t.data)
+                t.staging->unmap();
+        }
+    };
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (sources[i] != imageIdx)
+            continue;
+
+        targets.emplace_back();
+        Target& t = targets.back();
+        t.texture = i;
+        VkDeviceSize size = vk::getImageSize(formats[i].format, decoded.extent, decoded.levelCount);
+        if (hostCopy)
+        {
+            t.host.resize(static_cast<size_t>(size));
+            t.data = t.host.data();
+            continue;
+        }
+
+        t.staging = std::make_unique<vk::Buffer>(m_allocator);
+        void* data;
+        if (!t.staging->create(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || !t.staging->map(&data))
+        {
+            unmapTargets();
+            decoded.error = "failed to create staging buffer.";
+            return false;
+        }
+        t.data = static_cast<unsigned char*>(data);
+    }
+
+    // the chain is built a level at a time in scratch holding at most two levels, once per colour space the image is sampled in
+    // sRGB textures filter colour in linear space, UNORM ones as stored
+    std::vector<unsigned char> level, next;
+    for (int srgb = 0; srgb < 2; srgb++)
+    {
+        bool sampled = false;
+        for (const Target& t : targets)
+            sampled = sampled || isSrgbFormat(formats[t.texture].format) == (srgb != 0);
+        if (!sampled)
+            continue;
+
+        const unsigned char* src = texels;
+        if (comp != 4)
+        {
+            level.resize(static_cast<size_t>(width) * height * 4u);
+            expandToRGBA(level.data(), texels, static_cast<size_t>(width) * height, comp);
+            src = level.data();
+        }
+
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+        for (uint32_t l = 0u; l < decoded.levelCount; l++)
+        {
+            for (Target& t : targets)
+            {
+                const TextureFormat& format = formats[t.texture];
+                if (isSrgbFormat(format.format) != (srgb != 0))
+                    continue;
+                encodeTexture(format, src, levelWidth, levelHeight, 1u, t.data + t.levelOffset);
+                t.levelOffset += vk::getImageSize(format.format, { levelWidth, levelHeight, 1u });
+            }
+
+            if (l + 1u == decoded.levelCount)
+                break;
+            next.resize(mipChainSize(std::max(levelWidth >> 1, 1u), std::max(levelHeight >> 1, 1u), 1u));
+            generateMipLevel(next.data(), src, levelWidth, levelHeight, srgb != 0);
+            level.swap(next);
+            src = level.data();
+            levelWidth = std::max(levelWidth >> 1, 1u);
+            levelHeight = std::max(levelHeight >> 1, 1u);
+        }
+    }
+
+    for (Target& t : targets)
+    {
+        if (hostCopy)
+        {
+            m_textures[t.texture] = createTexture(decoded.extent, formats[t.texture].format, decoded.levelCount, t.host.data());
+            if (!m_textures[t.texture])
+            {
+                decoded.error = "host image copy failed.";
+                return false;
+            }
+        }
+        else
+        {
+            t.staging->unmap();
+            decoded.staging.emplace_back(t.texture, std::move(t.staging));
+        }
+    }
+
+    return true;
+}
+
+std::shared_ptr<vk::Image> Scene::createTexture(VkExtent3D extent, VkFormat format, uint32_t levelCount, const void* texels)
+{
+    // host image copy path: write texels straight into the optimal tiled image, no staging, command buffer or submission
+    std::shared_ptr<vk::Image> texImg = std::make_shared<vk::Image>(m_allocator);
+    texImg->m_createInfo.format = format;
+    texImg->m_createInfo.mipLevels = levelCount;
+    if (!texImg->create(extent, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u))
+        return nullptr;
+    if (!texImg->copyFromHost(texels, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount))
+        return nullptr;
+
+    return texImg;
+}
+
+std::shared_ptr<vk::Image> Scene::createTexture(VkExtent3D extent, VkFormat format, uint32_t levelCount, const vk::Buffer& staging, VkDeviceSize stagingOffset)
+{
+    // levels the source lacks are blitted on the device, formats that can't be blitted keep the shorter chain
+    uint32_t fullLevelCount = mipLevelCount(extent.width, extent.height);
+    bool blit = levelCount < fullLevelCount && canBlitMips(format);
+
+    std::shared_ptr<vk::Image> texImg = std::make_shared<vk::Image>(m_allocator);
+    texImg->m_createInfo.format = format;
+    texImg->m_createInfo.mipLevels = blit ? fullLevelCount : levelCount;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | (blit ? static_cast<VkImageUsageFlags>(VK_IMAGE_USAGE_TRANSFER_SRC_BIT) : 0u);
+    if (!texImg->create(extent, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_LAYOUT_UNDEFINED, usage, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0u, 0u))
+        return nullptr;
+
+    if (!beginUpload())
+        return nullptr;
+    m_cmdBuf->imageMemoryBarrier(*texImg, VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_2_NONE, 0u, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    m_cmdBuf->copyBufferToImage(*texImg, staging, VK_IMAGE_ASPECT_COLOR_BIT, stagingOffset, levelCount);
+    if (blit)
+        m_cmdBuf->generateMipLevels(*texImg, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+    m_cmdBuf->imageMemoryBarrier(*texImg, VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_NONE, 0u, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (!endUpload())
+        return nullptr;
+
+    return texImg;
+}
+
+bool Scene::createPlaceholders()
+{
+    // neutral values: white albedo, factor-only roughness/metallic, flat normal and no emission
+    const unsigned char white[4] = { 255u, 255u, 255u, 255u };
+    const unsigned char flatNormal[4] = { 128u, 128u, 255u, 255u };
+    const unsigned char black[4] = { 0u, 0u, 0u, 255u };
+    std::pair<std::shared_ptr<vk::Image>*, std::pair<VkFormat, const unsigned char*>> slots[] = {
+        { &m_placeholders.albedo, { VK_FORMAT_R8G8B8A8_SRGB, white } },
+        { &m_placeholders.metallicRoughness, { VK_FORMAT_R8G8B8A8_UNORM, white } },
+        { &m_placeholders.normal, { VK_FORMAT_R8G8B8A8_UNORM, flatNormal } },
+        { &m_placeholders.emissive, { VK_FORMAT_R8G8B8A8_SRGB, black } }
+    };
+    for (auto& slot : slots)
+    {
+        VkFormat format = slot.second.first;
+        const unsigned char* texel = slot.second.second;
+        if (canHostCopy(format))
+        {
+            *slot.first = createTexture({ 1u, 1u, 1u }, format, 1u, texel);
+        }
+        else
+        {
+            vk::Buffer staging(m_allocator);
+            void* data;
+            if (!staging.create(4u, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || !staging.map(&data))
+                return false;
+            memcpy(data, texel, 4u);
+            staging.unmap();
+            *slot.first = createTexture({ 1u, 1u, 1u }, format, 1u, staging);
+        }
+        if (!*slot.first)
+            return false;
+    }
+    return true;
+}
+
+Material Scene::createMaterial(const tinygltf::Material& material, bool placeholder) const
+{
+    // TODO multiple tex coords
+    // TODO texture factors
+    // TODO 2 channels w/ 16-bits per channel?
+    Material mat;
+    std::pair<int, std::shared_ptr<vk::Image> Material::*> slots[] = {
+        { material.pbrMetallicRoughness.baseColorTexture.index, &Material::albedo },
+        { material.pbrMetallicRoughness.metallicRoughnessTexture.index, &Material::metallicRoughness },
+        { material.normalTexture.index, &Material::normal },
+        { material.emissiveTexture.index, &Material::emissive }
+    };
+    for (auto& slot : slots)
+    {
+        if (slot.first > -1)
+            mat.*slot.second = placeholder ? m_placeholders.*slot.second : m_textures[slot.first];
+    }
+    return mat;
+}
+
+bool Scene::addMaterial(const Material& mat)
+{
+    m_materials.emplace_back();
+    m_materialViews.emplace_back();
+    return setMaterial(static_cast<uint32_t>(m_materials.size() - 1u), mat);
+}
+
+bool Scene::setMaterial(uint32_t idx, const Material& mat)
+{
+    MaterialViews matViews;
+    std::pair<const std::shared_ptr<vk::Image>*, std::shared_ptr<vk::ImageView>*> slots[] = {
+        { &mat.albedo, &matViews.albedo },
+        { &mat.metallicRoughness, &matViews.metallicRoughness },
+        { &mat.normal, &matViews.normal },
+        { &mat.emissive, &matViews.emissive }
+    };
+    for (auto& slot : slots)
+    {
+        if (!*slot.first)
+            continue;
+
+        *slot.second = std::make_shared<vk::ImageView>(m_gpu, **slot.first);
+        // BC5 roughness/metallic sit in red/green, shaders read them from green/blue as in glTF
+        if (slot.first == &mat.metallicRoughness && (*slot.first)->m_createInfo.format == VK_FORMAT_BC5_UNORM_BLOCK)
+        {
+            (*slot.second)->m_createInfo.components.g = VK_COMPONENT_SWIZZLE_R;
+            (*slot.second)->m_createInfo.components.b = VK_COMPONENT_SWIZZLE_G;
+        }
+        if (!(*slot.second)->create(VK_IMAGE_ASPECT_COLOR_BIT))
+            return false;
+    }
+
+    m_materials[idx] = mat;
+    m_materialViews[idx] = matViews;
+    publishMaterial(idx);
+    return true;
+}
+
+void Scene::publishMaterial(uint32_t idx)
+{
+    SceneEvent ev;
+    ev.type = SceneEvent::Type::Material;
+    ev.materialIdx = idx;
+    ev.views = m_materialViews[idx];
+    ev.material = m_materials[idx];
+    publish(std::move(ev));
+}
+
+void Scene::publish(SceneEvent&& ev)
+{
+    if (!m_events)
+        return;
+
+    // the render thread drains the queue once per frame, wait for it rather than drop the event
+    while (!m_events->tryPush(std::move(ev)))
+        std::this_thread::yield();
+}
+
+std::shared_ptr<GeometryRange> Scene::createMeshBuffer(tinygltf::Model& model, tinygltf::Accessor& accessor, size_t elemSize)
+{
+    // sparse-only accessors, or ones only filled in by an unsupported extension
+    if (accessor.bufferView < 0)
+    {
+        LOGE("glTF accessor without a buffer view is not supported.");
+        return nullptr;
+    }
+    tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    return createBuffer(m_buffers[view.buffer], static_cast<VkDeviceSize>(accessor.byteOffset + view.byteOffset), elemSize, accessor.count, view.byteStride);
+}
+
+std::shared_ptr<GeometryRange> Scene::createBuffer(const BufferSpan& src, VkDeviceSize srcOffset, size_t elemSize, size_t count, size_t byteStride)
+{
+    size_t byteCount = elemSize * count;
+    if (byteStride == elemSize)
+        byteStride = 0u;
+    if (!spanHolds(src, srcOffset, elemSize, count, byteStride))
+    {
+        LOGE("Mesh data reaches past the end of its buffer.");
+        return nullptr;
+    }
+
+    // the same payload is uploaded once however many accessors or meshes reference it
+    // data the device copies straight from an imported mapping is keyed by range, hashing it would read it all on the CPU
+    const unsigned char* srcData = src.data + srcOffset;
+    size_t srcBytes = byteStride > 0u && count > 0u ? (count - 1u) * byteStride + elemSize : byteCount;
+    bool byContent = !src.hostBuffer || byteStride > 0u;
+    uint64_t hash = byContent ? hashBytes(srcData, srcBytes) : hashBytes(&srcData, sizeof(srcData));
+    auto range = m_meshBufferCache.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const CachedMeshBuffer& cached = it->second;
+        if (cached.byContent == byContent && cached.elemSize == elemSize && cached.count == count && cached.byteStride == byteStride &&
+            (cached.src == srcData || (byContent && memcmp(cached.src, srcData, srcBytes) == 0)))
+            return cached.buffer;
+    }
+
+    std::shared_ptr<GeometryRange> meshBuf = uploadBuffer(src, srcOffset, elemSize, count, byteStride);
+    if (meshBuf)
+        m_meshBufferCache.emplace(hash, CachedMeshBuffer{ srcData, elemSize, count, byteStride, byContent, meshBuf });
+    return meshBuf;
+}
+
+std::shared_ptr<GeometryRange> Scene::uploadBuffer(const BufferSpan& src, VkDeviceSize srcOffset, size_t elemSize, size_t count, size_t byteStride)
+{
+    size_t byteCount = elemSize * count;
+    if (!spanHolds(src, srcOffset, elemSize, count, byteStride))
+    {
+        LOGE("Mesh data reaches past the end of its buffer.");
+        return nullptr;
+    }
+
+    // arena blocks are addressable so shaders can fetch attributes through the instance table
+    std::shared_ptr<GeometryRange> meshBuf = m_geometryArena->allocate(static_cast<VkDeviceSize>(byteCount));
+    if (!meshBuf)
+        return nullptr;
+
+    // tightly packed data is copied by the device straight out of the imported file mapping, no CPU copy at all
+    if (src.hostBuffer && byteStride == 0u)
+    {
+        if (!beginUpload())
+            return nullptr;
+        m_cmdBuf->copyBuffer(meshBuf->getBuffer(), *src.hostBuffer, byteCount, meshBuf->getOffset(), src.hostOffset + srcOffset);
+        if (!endUpload())
+            return nullptr;
+
+        return meshBuf;
+    }
+
+    vk::Buffer stagingBuf(m_allocator);
+    if (!stagingBuf.create(static_cast<VkDeviceSize>(byteCount), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        return nullptr;
+
+    void* data;
+    if (!stagingBuf.map(&data))
+        return nullptr;
+
+    // points straight into the mapped file, only the pages read here are faulted in
+    const unsigned char* bufData = src.data + srcOffset;
+    if (byteStride > 0u)
+    {
+        strided_copy(data, bufData, count, elemSize, byteStride);
+    }
+    else
+    {
+        memcpy(data, bufData, byteCount);
+    }
+    stagingBuf.unmap();
+
+    if (!beginUpload())
+        return nullptr;
+    m_cmdBuf->copyBuffer(meshBuf->getBuffer(), stagingBuf, byteCount, meshBuf->getOffset());
+    if (!endUpload())
+        return nullptr;
+
+    return meshBuf;
+}
+
+std::shared_ptr<GeometryRange> Scene::createDefaultStream(const float* value, uint32_t components, uint32_t vertexCount)
+{
+    std::vector<float> values = repeatValue(value, components, vertexCount);
+    return uploadBuffer({ reinterpret_cast<const unsigned char*>(values.data()), sizeof(float) * values.size(), nullptr, 0u }, 0u, sizeof(float) * components, vertexCount, 0u);
+}
+
+bool Scene::createMesh(tinygltf::Model& model, uint32_t meshIdx)
+{
+    // only consider first primitive that is a triangle mesh
+    tinygltf::Mesh& mesh = model.meshes[meshIdx];
+    int primIdx = findTrianglePrimitive(mesh);
+    if (primIdx == -1)
+    {
+        LOGE("Unsupported glTF mesh primitive mode, or primitive mode unspecified.");
+        return false;
+    }
+
+    tinygltf::Primitive& prim = mesh.primitives[primIdx];
+
+    // meshes without TANGENT or TEXCOORD_0 get a constant stream in their place
+    auto position = prim.attributes.find("POSITION");
+    auto normal = prim.attributes.find("NORMAL");
+    if (prim.indices < 0 || position == prim.attributes.end() || normal == prim.attributes.end())
+    {
+        LOGE("glTF mesh \'" + mesh.name + "\' has no indices, POSITION or NORMAL attribute.");
+        return false;
+    }
+    auto tangent = prim.attributes.find("TANGENT");
+    // TODO multiple texture coordinates
+    auto texCoord = prim.attributes.find("TEXCOORD_0");
+
+    tinygltf::Accessor& indexAccessor = model.accessors[prim.indices];
+    tinygltf::Accessor& positionAccessor = model.accessors[position->second];
+    tinygltf::Accessor& normalAccessor = model.accessors[normal->second];
+
+    // TODO don't duplicate or allocate too much data unnecessarily
+    Mesh m;
+    m.indexCount = static_cast<uint32_t>(indexAccessor.count);
+    m.vertexCount = static_cast<uint32_t>(positionAccessor.count);
+    m.indexType = gltfIndexType(indexAccessor, m.vertexCount, m_compressVertices);
+
+    if (m.indexType == VK_INDEX_TYPE_UINT16 && indexAccessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+    {
+        std::vector<float> values;
+        if (!readAccessor(model, m_buffers, prim.indices, values))
+        {
+            LOGE("glTF mesh has unreadable indices.");
+            return false;
+        }
+        std::vector<uint16_t> indices(values.begin(), values.end());
+        m.indexBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(indices.data()), sizeof(uint16_t) * indices.size(), nullptr, 0u }, 0u, sizeof(uint16_t), indices.size(), 0u);
+    }
+    else
+    {
+        m.indexBuffer = createMeshBuffer(model, indexAccessor, m.indexType == VK_INDEX_TYPE_UINT16 ? 2u : 4u);
+    }
+
+    bool packed = m_compressVertices && !isDeformable(prim);
+    if (packed)
+    {
+        if (!createPackedAttributes(model, prim, m))
+            return false;
+    }
+    else
+    {
+        m.positionBuffer = createMeshBuffer(model, positionAccessor, 3u * sizeof(float));
+        m.normalBuffer = createMeshBuffer(model, normalAccessor, 3u * sizeof(float));
+        // TODO different component types?
+        m.tangentBuffer = tangent != prim.attributes.end() ? createMeshBuffer(model, model.accessors[tangent->second], 4u * sizeof(float)) : createDefaultStream(DEFAULT_TANGENT, 4u, m.vertexCount);
+        m.texCoordBuffer = texCoord != prim.attributes.end() ? createMeshBuffer(model, model.accessors[texCoord->second], 2u * sizeof(float)) : createDefaultStream(DEFAULT_TEX_COORD, 2u, m.vertexCount);
+    }
+    if (!m.indexBuffer || !m.positionBuffer || !m.normalBuffer || (!packed && (!m.tangentBuffer || !m.texCoordBuffer)))
+        return false;
+
+    // skinning and morph target inputs are converted on the CPU to the one layout the deform pass reads
+    auto joints = prim.attributes.find("JOINTS_0");
+    auto weights = prim.attributes.find("WEIGHTS_0");
+    if (joints != prim.attributes.end() && weights != prim.attributes.end())
+    {
+        std::vector<float> jointValues, weightValues;
+        if (!readAccessor(model, m_buffers, joints->second, jointValues) || !readAccessor(model, m_buffers, weights->second, weightValues) ||
+            jointValues.size() != 4u * m.vertexCount || weightValues.size() != 4u * m.vertexCount)
+        {
+            LOGE("glTF skinned mesh has unreadable JOINTS_0 or WEIGHTS_0.");
+            return false;
+        }
+
+        std::vector<uint32_t> jointIndices(jointValues.size());
+        for (size_t i = 0; i < jointValues.size(); i++)
+        {
+            jointIndices[i] = static_cast<uint32_t>(jointValues[i]);
+            m.jointCount = std::max(m.jointCount, jointIndices[i] + 1u);
+        }
+        m.jointBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(jointIndices.data()), sizeof(uint32_t) * jointIndices.size(), nullptr, 0u }, 0u, 4u * sizeof(uint32_t), m.vertexCount, 0u);
+        m.weightBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(weightValues.data()), sizeof(float) * weightValues.size(), nullptr, 0u }, 0u, 4u * sizeof(float), m.vertexCount, 0u);
+        if (!m.jointBuffer || !m.weightBuffer)
+            return false;
+    }
+
+    if (!prim.targets.empty())
+    {
+        // attributes a target doesn't move stay 0
+        size_t targetSize = 3u * 3u * static_cast<size_t>(m.vertexCount);
+        std::vector<float> deltas(prim.targets.size() * targetSize, 0.0f);
+        const char* attributes[] = { "POSITION", "NORMAL", "TANGENT" };
+        for (size_t t = 0; t < prim.targets.size(); t++)
+        {
+            for (size_t a = 0; a < 3u; a++)
+            {
+                auto it = prim.targets[t].find(attributes[a]);
+                if (it == prim.targets[t].end())
+                    continue;
+
+                std::vector<float> values;
+                if (!readAccessor(model, m_buffers, it->second, values) || values.size() != 3u * m.vertexCount)
+                {
+                    LOGE("glTF morph target " + std::to_string(t) + " has an unreadable " + attributes[a] + " accessor.");
+                    return false;
+                }
+                std::copy(values.begin(), values.end(), deltas.begin() + t * targetSize + a * 3u * m.vertexCount);
+            }
+        }
+        m.morphTargetCount = static_cast<uint32_t>(prim.targets.size());
+        m.morphTargetBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(deltas.data()), sizeof(float) * deltas.size(), nullptr, 0u }, 0u, 3u * sizeof(float), deltas.size() / 3u, 0u);
+        if (!m.morphTargetBuffer)
+            return false;
+    }
+
+    m.materialIdx = static_cast<uint32_t>(std::max(0, prim.material));
+
+    m_meshes[meshIdx] = m;
+    m_meshHashes[meshIdx] = meshHash(model, meshIdx);
+    return true;
+}
+
+bool Scene::createPackedAttributes(tinygltf::Model& model, tinygltf::Primitive& prim, Mesh& m)
+{
+    // createMesh() has checked POSITION and NORMAL, missing tangents and uvs are packed from the same defaults it uploads unpacked
+    auto tangent = prim.attributes.find("TANGENT");
+    auto texCoord = prim.attributes.find("TEXCOORD_0");
+    std::vector<float> normals, tangents, texCoords;
+    bool read = readAccessor(model, m_buffers, prim.attributes.find("NORMAL")->second, normals);
+    if (tangent != prim.attributes.end())
+        read = read && readAccessor(model, m_buffers, tangent->second, tangents);
+    else
+        tangents = repeatValue(DEFAULT_TANGENT, 4u, m.vertexCount);
+    if (texCoord != prim.attributes.end())
+        read = read && readAccessor(model, m_buffers, texCoord->second, texCoords);
+    else
+        texCoords = repeatValue(DEFAULT_TEX_COORD, 2u, m.vertexCount);
+    if (!read || normals.size() != 3u * m.vertexCount || tangents.size() != 4u * m.vertexCount || texCoords.size() != 2u * m.vertexCount)
+    {
+        LOGE("glTF mesh has unreadable NORMAL, TANGENT or TEXCOORD_0 attributes.");
+        return false;
+    }
+
+    // uvs are quantized like positions, unorm16 over the mesh's uv bounds keeps the step size independent of where they lie
+    glm::vec2 uvMin(std::numeric_limits<float>::max());
+    glm::vec2 uvMax(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < m.vertexCount; v++)
+    {
+        uvMin = glm::min(uvMin, glm::make_vec2(&texCoords[2u * v]));
+        uvMax = glm::max(uvMax, glm::make_vec2(&texCoords[2u * v]));
+    }
+    glm::vec2 uvScale = m.vertexCount > 0u ? uvMax - uvMin : glm::vec2(1.0f);
+    uvScale = glm::vec2(uvScale.x > 0.0f ? uvScale.x : 1.0f, uvScale.y > 0.0f ? uvScale.y : 1.0f);
+    glm::vec2 uvOffset = m.vertexCount > 0u ? uvMin : glm::vec2(0.0f);
+    std::vector<uint32_t> packed(3u * static_cast<size_t>(m.vertexCount));
+    for (size_t v = 0; v < m.vertexCount; v++)
+    {
+        glm::vec4 tangent = glm::make_vec4(&tangents[4u * v]);
+        glm::vec2 texCoord = (glm::make_vec2(&texCoords[2u * v]) - uvOffset) / uvScale;
+        packed[3u * v] = glm::packSnorm2x16(octEncode(glm::make_vec3(&normals[3u * v])));
+        // the bitangent sign takes the lowest bit of the tangent's second component
+        packed[3u * v + 1u] = (glm::packSnorm2x16(octEncode(glm::vec3(tangent))) & ~0x10000u) | (tangent.w < 0.0f ? 0x10000u : 0u);
+        packed[3u * v + 2u] = glm::packUnorm2x16(texCoord);
+    }
+    m.normalBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(packed.data()), sizeof(uint32_t) * packed.size(), nullptr, 0u }, 0u, 3u * sizeof(uint32_t), m.vertexCount, 0u);
+    m.vertexFormat |= Mesh::PACKED_ATTRIBUTES;
+    m.texCoordTransform = glm::vec4(uvOffset, uvScale);
+
+    int positionIdx = prim.attributes.find("POSITION")->second;
+    tinygltf::Accessor& positionAccessor = model.accessors[positionIdx];
+    glm::mat4 positionTransform;
+    if (!m_quantizePositions || !gltfPositionTransform(positionAccessor, positionTransform))
+    {
+        m.positionBuffer = createMeshBuffer(model, positionAccessor, 3u * sizeof(float));
+        return m.normalBuffer && m.positionBuffer;
+    }
+
+    std::vector<float> positions;
+    if (!readAccessor(model, m_buffers, positionIdx, positions) || positions.size() != 3u * m.vertexCount)
+    {
+        LOGE("glTF mesh has unreadable POSITION attributes.");
+        return false;
+    }
+    // the w component only pads to R16G16B16A16_SNORM
+    glm::mat4 toStored = glm::inverse(positionTransform);
+    std::vector<uint32_t> quantized(2u * static_cast<size_t>(m.vertexCount));
+    for (size_t v = 0; v < m.vertexCount; v++)
+    {
+        glm::vec3 q = glm::vec3(toStored * glm::vec4(glm::make_vec3(&positions[3u * v]), 1.0f));
+        quantized[2u * v] = glm::packSnorm2x16(glm::vec2(q.x, q.y));
+        quantized[2u * v + 1u] = glm::packSnorm2x16(glm::vec2(q.z, 1.0f));
+    }
+    m.positionBuffer = uploadBuffer({ reinterpret_cast<const unsigned char*>(quantized.data()), sizeof(uint32_t) * quantized.size(), nullptr, 0u }, 0u, 2u * sizeof(uint32_t), m.vertexCount, 0u);
+    m.positionTransform = positionTransform;
+    m.vertexFormat |= Mesh::QUANTIZED_POSITIONS;
+    return m.normalBuffer && m.positionBuffer;
+}
+
+// meshless nodes stay in the graph as transforms of their subtrees
+bool Scene::createNodes(const tinygltf::Model& model, const tinygltf::Scene& scene)
+{
+    struct FlatNode
+    {
+        int32_t parent;
+        uint32_t mesh;
+        glm::mat4 localTransform;
+        int gltfNode;
+    };
+
+    // parents first, in the order addNode() assigns the ids
+    std::vector<FlatNode> nodes;
+    std::vector<std::pair<int, int32_t>> stack;
+    for (auto it = scene.nodes.rbegin(); it != scene.nodes.rend(); ++it)
+        stack.emplace_back(*it, -1);
+    while (!stack.empty())
+    {
+        int gltfNode = stack.back().first;
+        const tinygltf::Node& node = model.nodes[gltfNode];
+        int32_t parent = stack.back().second;
+        stack.pop_back();
+
+        int32_t n = static_cast<int32_t>(nodes.size());
+        nodes.push_back({ parent, node.mesh >= 0 ? static_cast<uint32_t>(node.mesh) : SceneGraph::NO_MESH, gltfLocalTransform(node), gltfNode });
+        for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+            stack.emplace_back(*it, n);
+    }
+
+    // a graph of the same shape, e.g. after reload() of a file whose nodes only moved, is patched in place
+    // so updateTransforms() only recomputes the subtrees below changed nodes
+    m_nodeIds.assign(model.nodes.size(), -1);
+    for (size_t i = 0; i < nodes.size(); i++)
+        m_nodeIds[nodes[i].gltfNode] = static_cast<int32_t>(i);
+
+    // EXT_mesh_gpu_instancing instances only become transforms in one packed array, not nodes of their own
+    m_instanceRanges.assign(nodes.size(), std::make_pair(0u, 0u));
+    m_instanceTransforms.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const tinygltf::Node& node = model.nodes[nodes[i].gltfNode];
+        auto ext = node.extensions.find("EXT_mesh_gpu_instancing");
+        if (node.mesh < 0 || ext == node.extensions.end())
+            continue;
+
+        uint32_t first = static_cast<uint32_t>(m_instanceTransforms.size());
+        if (!readGpuInstances(model, m_buffers, ext->second, m_instanceTransforms))
+        {
+            LOGE("glTF node \'" + node.name + "\' has unreadable EXT_mesh_gpu_instancing attributes.");
+            return false;
+        }
+        m_instanceRanges[i] = std::make_pair(first, static_cast<uint32_t>(m_instanceTransforms.size()) - first);
+    }
+
+    bool sameShape = nodes.size() == m_sceneGraph.size();
+    for (uint32_t i = 0; sameShape && i < nodes.size(); i++)
+        sameShape = nodes[i].parent == m_sceneGraph.getParent(i) && nodes[i].mesh == m_sceneGraph.getMesh(i);
+
+    if (sameShape)
+    {
+        for (uint32_t i = 0; i < nodes.size(); i++)
+        {
+            if (nodes[i].localTransform != m_sceneGraph.getLocalTransform(i))
+                m_sceneGraph.setLocalTransform(i, nodes[i].localTransform);
+        }
+        return true;
+    }
+
+    m_sceneGraph.clear();
+    for (const FlatNode& node : nodes)
+        m_sceneGraph.addNode(node.parent, node.mesh, node.localTransform);
+    return true;
+}
+
+bool Scene::createAnimator(const tinygltf::Model& model, std::shared_ptr<Animator>& animator)
+{
+    animator.reset();
+    std::vector<int> gltfNodes(m_sceneGraph.size(), -1);
+    for (size_t i = 0; i < m_nodeIds.size(); i++)
+    {
+        if (m_nodeIds[i] >= 0)
+            gltfNodes[m_nodeIds[i]] = static_cast<int>(i);
+    }
+
+    std::shared_ptr<Animator> anim = std::make_shared<Animator>(m_allocator, m_asInputUsage);
+
+    // channels targeting nodes outside the scene, or through extensions, are dropped
+    std::vector<bool> posed(m_sceneGraph.size(), false);
+    for (const tinygltf::Animation& src : model.animations)
+    {
+        Animator::Animation a;
+        a.name = src.name;
+        a.duration = 0.0f;
+        for (const tinygltf::AnimationSampler& srcSampler : src.samplers)
+        {
+            Animator::Sampler sampler;
+            sampler.interpolation = srcSampler.interpolation == "STEP" ? Animator::Interpolation::Step : srcSampler.interpolation == "CUBICSPLINE" ? Animator::Interpolation::CubicSpline : Animator::Interpolation::Linear;
+            if (!readAccessor(model, m_buffers, srcSampler.input, sampler.times) || !readAccessor(model, m_buffers, srcSampler.output, sampler.values))
+            {
+                LOGE("glTF animation \'" + src.name + "\' has an unreadable sampler.");
+                return false;
+            }
+            size_t valuesPerKey = sampler.times.empty() ? 0u : sampler.values.size() / sampler.times.size();
+            sampler.components = static_cast<uint32_t>(sampler.interpolation == Animator::Interpolation::CubicSpline ? valuesPerKey / 3u : valuesPerKey);
+            if (!sampler.times.empty())
+                a.duration = std::max(a.duration, sampler.times.back());
+            a.samplers.push_back(std::move(sampler));
+        }
+
+        for (const tinygltf::AnimationChannel& srcChannel : src.channels)
+        {
+            if (srcChannel.target_node < 0 || srcChannel.target_node >= static_cast<int>(m_nodeIds.size()) || m_nodeIds[srcChannel.target_node] < 0 ||
+                srcChannel.sampler < 0 || srcChannel.sampler >= static_cast<int>(a.samplers.size()))
+                continue;
+
+            Animator::Channel channel;
+            channel.node = static_cast<uint32_t>(m_nodeIds[srcChannel.target_node]);
+            channel.sampler = static_cast<uint32_t>(srcChannel.sampler);
+            uint32_t components = a.samplers[channel.sampler].components;
+            if (srcChannel.target_path == "translation" && components == 3u)
+                channel.path = Animator::Path::Translation;
+            else if (srcChannel.target_path == "rotation" && components == 4u)
+                channel.path = Animator::Path::Rotation;
+            else if (srcChannel.target_path == "scale" && components == 3u)
+                channel.path = Animator::Path::Scale;
+            else if (srcChannel.target_path == "weights")
+                channel.path = Animator::Path::Weights;
+            else
+                continue;
+
+            a.channels.push_back(channel);
+            posed[channel.node] = true;
+        }
+
+        if (!a.channels.empty())
+            anim->m_animations.push_back(std::move(a));
+    }
+
+    // glTF only animates nodes given as TRS
+    for (uint32_t i = 0; i < posed.size(); i++)
+    {
+        if (!posed[i])
+            continue;
+
+        const tinygltf::Node& node = model.nodes[gltfNodes[i]];
+        Animator::NodePose pose;
+        pose.node = i;
+        pose.translation = node.translation.size() == 3u ? glm::vec3(node.translation[0], node.translation[1], node.translation[2]) : glm::vec3(0.0f);
+        pose.rotation = node.rotation.size() == 4u ? glm::quat(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2])) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        pose.scale = node.scale.size() == 3u ? glm::vec3(node.scale[0], node.scale[1], node.scale[2]) : glm::vec3(1.0f);
+        pose.weights = gltfMorphWeights(model, node);
+        anim->m_poses.push_back(std::move(pose));
+    }
+
+    // every skinned or morphed instance gets its own deformed attributes, skins are shared by the instances using them
+    std::vector<int32_t> skins(model.skins.size(), -1);
+    for (uint32_t i = 0; i < m_sceneGraph.size(); i++)
+    {
+        uint32_t meshIdx = m_sceneGraph.getMesh(i);
+        if (meshIdx == SceneGraph::NO_MESH)
+            continue;
+
+        const Mesh& m = m_meshes[meshIdx];
+        const tinygltf::Node& node = model.nodes[gltfNodes[i]];
+        int32_t skinIdx = -1;
+        if (m.jointBuffer && node.skin >= 0 && node.skin < static_cast<int>(model.skins.size()))
+        {
+            if (skins[node.skin] < 0)
+            {
+                const tinygltf::Skin& src = model.skins[node.skin];
+                Animator::Skin skin;
+                for (int joint : src.joints)
+                {
+                    if (joint < 0 || joint >= static_cast<int>(m_nodeIds.size()) || m_nodeIds[joint] < 0)
+                    {
+                        LOGE("glTF skin \'" + src.name + "\' has joints outside the scene.");
+                        return false;
+                    }
+                    skin.joints.push_back(static_cast<uint32_t>(m_nodeIds[joint]));
+                }
+
+                skin.inverseBindMatrices.assign(skin.joints.size(), glm::mat4(1.0f));
+                std::vector<float> matrices;
+                if (src.inverseBindMatrices >= 0 && (!readAccessor(model, m_buffers, src.inverseBindMatrices, matrices) || matrices.size() != 16u * skin.joints.size()))
+                {
+                    LOGE("glTF skin \'" + src.name + "\' has unreadable inverse bind matrices.");
+                    return false;
+                }
+                for (size_t j = 0; j < skin.joints.size() && !matrices.empty(); j++)
+                    skin.inverseBindMatrices[j] = glm::make_mat4(matrices.data() + 16u * j);
+
+                skins[node.skin] = static_cast<int32_t>(anim->m_skins.size());
+                anim->m_skins.push_back(std::move(skin));
+            }
+            skinIdx = skins[node.skin];
+
+            // the deform pass indexes the joint matrices with JOINTS_0 as it is
+            if (anim->m_skins[skinIdx].joints.size() < m.jointCount)
+            {
+                LOGE("glTF mesh references joints its skin doesn't have.");
+                return false;
+            }
+        }
+        if (skinIdx < 0 && m.morphTargetCount == 0u)
+            continue;
+
+        Animator::DeformedInstance inst{};
+        inst.node = i;
+        inst.mesh = meshIdx;
+        inst.skin = skinIdx;
+        inst.weights = gltfMorphWeights(model, node);
+        anim->m_deformed.push_back(std::move(inst));
+    }
+
+    if (anim->empty())
+        return true;
+
+    anim->m_sceneGraph = m_sceneGraph;
+    if (!anim->create(m_meshes))
+        return false;
+    animator = anim;
+    return true;
+}
+
+bool Scene::createInstanceTable(std::shared_ptr<Animator> animator)
+{
+    // transforms are propagated on a pool only for graphs large enough to amortize starting one
+    std::unique_ptr<ThreadPool> pool = m_sceneGraph.size() >= SceneGraph::PARALLEL_MIN_NODES ? std::make_unique<ThreadPool>() : nullptr;
+    m_sceneGraph.updateTransforms(pool.get());
+
+    // one record per mesh node, or per instance of nodes using EXT_mesh_gpu_instancing
+    std::vector<uint32_t> nodeRecords(m_sceneGraph.size(), ~0u);
+    uint32_t recordCount = 0u;
+    for (uint32_t i = 0; i < m_sceneGraph.size(); i++)
+    {
+        if (m_sceneGraph.getMesh(i) == SceneGraph::NO_MESH)
+            continue;
+        nodeRecords[i] = recordCount;
+        recordCount += i < m_instanceRanges.size() && m_instanceRanges[i].second > 0u ? m_instanceRanges[i].second : 1u;
+    }
+
+    // table is read from shaders only, keep it host visible rather than staging it
+    VkDeviceSize size = std::max<VkDeviceSize>(sizeof(InstanceRecord) * recordCount, sizeof(InstanceRecord));
+    m_instanceTable = std::make_shared<vk::Buffer>(m_allocator);
+    if (!m_instanceTable->create(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        return false;
+
+    void* data;
+    if (!m_instanceTable->map(&data))
+        return false;
+
+    // stream passes find the records of each streamed mesh and the spheres they cover from here
+    bool stream = streaming();
+    if (stream)
+    {
+        m_meshRecords.assign(m_meshes.size(), {});
+        m_streamedInstances.clear();
+    }
+
+    // records are written straight into the mapping in order, GPU instances never exist as anything but their record
+    InstanceRecord* dst = static_cast<InstanceRecord*>(data);
+    for (uint32_t i = 0; i < m_sceneGraph.size(); i++)
+    {
+        uint32_t meshIdx = m_sceneGraph.getMesh(i);
+        if (meshIdx == SceneGraph::NO_MESH)
+            continue;
+        const Mesh* m = &m_meshes[meshIdx];
+
+        RecordPatch addresses = meshAddresses(*m);
+        InstanceRecord r{};
+        r.indexAddress = addresses.indexAddress;
+        r.positionAddress = addresses.positionAddress;
+        r.normalAddress = addresses.normalAddress;
+        r.tangentAddress = addresses.tangentAddress;
+        r.texCoordAddress = addresses.texCoordAddress;
+        r.indexType = m->indexType == VK_INDEX_TYPE_UINT16 ? 0u : 1u;
+        r.materialIdx = m->materialIdx;
+        r.vertexFormat = m->vertexFormat;
+        r.texCoordTransform = addresses.texCoordTransform;
+
+        // the instances of a deformed node share its deformed attributes
+        int32_t deformed = animator ? animator->getDeformedInstance(i) : -1;
+        if (deformed >= 0)
+        {
+            const Animator::DeformedInstance& inst = animator->m_deformed[deformed];
+            r.positionAddress = inst.positionBuffer->getDeviceAddress();
+            r.normalAddress = inst.normalBuffer->getDeviceAddress();
+            r.tangentAddress = inst.tangentBuffer->getDeviceAddress();
+        }
+
+        uint32_t instanceCount = i < m_instanceRanges.size() ? m_instanceRanges[i].second : 0u;
+        bool streamed = stream && !m_meshResidency[meshIdx].pinned;
+        if (streamed)
+            m_meshRecords[meshIdx].emplace_back(nodeRecords[i], std::max(instanceCount, 1u));
+        glm::mat4 world = m_sceneGraph.getWorldTransform(i);
+        if (instanceCount == 0u)
+        {
+            if (streamed)
+                m_streamedInstances.push_back({ worldSphere(world, m_meshResidency[meshIdx].bounds), meshIdx });
+            r.transform = world * m->positionTransform;
+            memcpy(dst++, &r, sizeof(r));
+            continue;
+        }
+
+        const glm::mat4* local = m_instanceTransforms.data() + m_instanceRanges[i].first;
+        for (uint32_t k = 0; k < instanceCount; k++)
+        {
+            glm::mat4 instanceWorld = world * local[k];
+            if (streamed)
+                m_streamedInstances.push_back({ worldSphere(instanceWorld, m_meshResidency[meshIdx].bounds), meshIdx });
+            r.transform = instanceWorld * m->positionTransform;
+            memcpy(dst++, &r, sizeof(r));
+        }
+    }
+    m_instanceTable->unmap();
+
+    SceneEvent ev;
+    ev.type = SceneEvent::Type::Geometry;
+    ev.instanceTable = m_instanceTable;
+    ev.meshes = std::make_shared<const std::vector<Mesh>>(m_meshes);
+    if (animator)
+        animator->setInstanceTable(m_instanceTable, ev.meshes, nodeRecords, m_instanceRanges, m_instanceTransforms);
+    ev.animator = animator;
+    ev.materialCount = static_cast<uint32_t>(m_materials.size());
+    ev.instanceCount = recordCount;
+    publish(std::move(ev));
+
+    // the records hold all there is of the GPU instances now
+    m_instanceRanges.clear();
+    std::vector<glm::mat4>().swap(m_instanceTransforms);
+    return true;
+}
+
+// uploads per stream pass, so the nearest meshes show up first rather than all at once when the view jumps
+static const VkDeviceSize STREAM_PASS_BYTES = 64u << 20;
+
+bool Scene::initStreaming(tinygltf::Model& model, const std::vector<bool>& meshUsed)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_streamStop = false;
+        m_streamViewChanged = true;
+    }
+
+    // meshes resident from an earlier scene or load count against the budget until they are evicted
+    m_meshResidency.assign(model.meshes.size(), MeshResidency{});
+    m_residentBytes = 0u;
+    m_pinnedBytes = 0u;
+    m_streamPass = 0u;
+    for (uint32_t i = 0; i < model.meshes.size(); i++)
+    {
+        int primIdx = findTrianglePrimitive(model.meshes[i]);
+        if (primIdx == -1)
+        {
+            if (!meshUsed[i])
+                continue;
+            LOGE("Unsupported glTF mesh primitive mode, or primitive mode unspecified.");
+            return false;
+        }
+
+        // the deform pass reads skinned and morphed meshes every frame, they aren't streamed
+        tinygltf::Primitive& prim = model.meshes[i].primitives[primIdx];
+        MeshResidency& res = m_meshResidency[i];
+        res.size = gltfMeshSize(model, prim, m_compressVertices, m_quantizePositions);
+        res.bounds = gltfMeshBounds(model, prim);
+        res.pinned = meshUsed[i] && (!prim.targets.empty() || prim.attributes.count("JOINTS_0") > 0u);
+        if (res.pinned && !m_meshes[i].indexBuffer && !createMesh(model, i))
+            return false;
+        if (res.pinned)
+            m_pinnedBytes += res.size;
+        if (m_meshes[i].indexBuffer)
+        {
+            m_residentBytes += res.size;
+            continue;
+        }
+        if (!meshUsed[i])
+            continue;
+
+        auto position = prim.attributes.find("POSITION");
+        if (prim.indices < 0 || position == prim.attributes.end())
+        {
+            LOGE("glTF mesh \'" + model.meshes[i].name + "\' has no indices or POSITION attribute.");
+            return false;
+        }
+
+        // what the instance table needs of a mesh before it is resident, as createMesh() will pick it
+        // patches rewrite addresses, the vertex format and the uv transform, not the transform quantized positions fold into
+        Mesh& m = m_meshes[i];
+        const tinygltf::Accessor& indexAccessor = model.accessors[prim.indices];
+        m.indexCount = static_cast<uint32_t>(indexAccessor.count);
+        m.vertexCount = static_cast<uint32_t>(model.accessors[position->second].count);
+        m.indexType = gltfIndexType(indexAccessor, m.vertexCount, m_compressVertices);
+        m.materialIdx = static_cast<uint32_t>(std::max(0, prim.material));
+        if (m_compressVertices && m_quantizePositions && !res.pinned)
+            gltfPositionTransform(model.accessors[position->second], m.positionTransform);
+    }
+
+    if (m_pinnedBytes > m_geometryBudget)
+        LOGW("Skinned and morphed meshes alone exceed the geometry budget, no other mesh will be streamed in.");
+    return true;
+}
+
+void Scene::streamGeometry()
+{
+    if (!streaming())
+        return;
+
+    bool pending = false;
+    for (;;)
+    {
+        glm::vec3 view;
+        {
+            std::unique_lock<std::mutex> lock(m_streamMutex);
+            m_streamCond.wait(lock, [this, pending]() { return m_streamStop || m_streamViewChanged || pending; });
+            if (m_streamStop)
+                return;
+            view = m_streamView;
+            m_streamViewChanged = false;
+        }
+
+        if (!streamPass(view, pending))
+        {
+            LOGE("Failed to stream geometry, the scene keeps what is resident.");
+            return;
+        }
+    }
+}
+
+void Scene::setStreamView(const glm::vec3& position)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    if (position == m_streamView)
+        return;
+    m_streamView = position;
+    m_streamViewChanged = true;
+    m_streamCond.notify_one();
+}
+
+void Scene::stopStreaming()
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_streamStop = true;
+    m_streamCond.notify_one();
+}
+
+bool Scene::streamStopped()
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    return m_streamStop;
+}
+
+bool Scene::streamPass(const glm::vec3& view, bool& pending)
+{
+    pending = false;
+    m_streamPass++;
+
+    // a mesh is as near as the bounding sphere of its nearest instance, animated ones count where the scene was loaded
+    const float noInstance = std::numeric_limits<float>::max();
+    std::vector<float> distances(m_meshes.size(), noInstance);
+    for (const StreamedInstance& inst : m_streamedInstances)
+    {
+        float distance = std::max(0.0f, glm::length(glm::vec3(inst.sphere) - view) - inst.sphere.w);
+        distances[inst.mesh] = std::min(distances[inst.mesh], distance);
+    }
+    std::vector<uint32_t> nearest;
+    for (uint32_t i = 0; i < m_meshes.size(); i++)
+    {
+        if (distances[i] < noInstance)
+            nearest.push_back(i);
+    }
+    std::sort(nearest.begin(), nearest.end(), [&distances](uint32_t a, uint32_t b) { return distances[a] < distances[b] || (distances[a] == distances[b] && a < b); });
+
+    // the nearest meshes that fit the budget together are wanted, a mesh too large to fit leaves room for further ones
+    VkDeviceSize wantedBytes = m_pinnedBytes;
+    std::vector<uint32_t> missing;
+    for (uint32_t i : nearest)
+    {
+        MeshResidency& res = m_meshResidency[i];
+        if (wantedBytes + res.size > m_geometryBudget)
+            continue;
+        wantedBytes += res.size;
+        res.lastWanted = m_streamPass;
+        if (!m_meshes[i].indexBuffer)
+            missing.push_back(i);
+    }
+    if (missing.empty())
+        return true;
+
+    // anything resident but not wanted can go, least recently wanted first
+    // the wanted meshes fit the budget together, so evicting all of these always makes room
+    std::vector<uint32_t> victims;
+    for (uint32_t i = 0; i < m_meshes.size(); i++)
+    {
+        if (m_meshes[i].indexBuffer && !m_meshResidency[i].pinned && m_meshResidency[i].lastWanted < m_streamPass)
+            victims.push_back(i);
+    }
+    std::sort(victims.begin(), victims.end(), [this](uint32_t a, uint32_t b) { return m_meshResidency[a].lastWanted > m_meshResidency[b].lastWanted; });
+
+    std::vector<uint32_t> changed;
+    bool evicted = false;
+    VkDeviceSize uploaded = 0u;
+    for (uint32_t i : missing)
+    {
+        if (uploaded >= STREAM_PASS_BYTES)
+        {
+            pending = true;
+            break;
+        }
+        while (m_residentBytes + m_meshResidency[i].size > m_geometryBudget && !victims.empty())
+        {
+            evictMesh(victims.back());
+            changed.push_back(victims.back());
+            victims.pop_back();
+            evicted = true;
+        }
+
+        if (!createMesh(*m_model, i))
+            return false;
+        m_residentBytes += m_meshResidency[i].size;
+        uploaded += m_meshResidency[i].size;
+        changed.push_back(i);
+    }
+
+    // buffers of evicted meshes no other mesh shares only live on in the cache
+    if (evicted)
+    {
+        std::unordered_set<const GeometryRange*> resident;
+        for (const Mesh& m : m_meshes)
+        {
+            for (const GeometryRange* buf : { m.indexBuffer.get(), m.positionBuffer.get(), m.normalBuffer.get(), m.tangentBuffer.get(), m.texCoordBuffer.get() })
+                resident.insert(buf);
+        }
+        for (auto it = m_meshBufferCache.begin(); it != m_meshBufferCache.end();)
+            it = resident.count(it->second.buffer.get()) > 0u ? std::next(it) : m_meshBufferCache.erase(it);
+    }
+
+    SceneEvent ev;
+    ev.type = SceneEvent::Type::Residency;
+    for (uint32_t i : changed)
+    {
+        RecordPatch patch = meshAddresses(m_meshes[i]);
+        for (const std::pair<uint32_t, uint32_t>& run : m_meshRecords[i])
+        {
+            patch.firstRecord = run.first;
+            patch.recordCount = run.second;
+            ev.patches.push_back(patch);
+        }
+    }
+    // the render thread's copy keeps the evicted buffers alive until it has patched the table
+    ev.meshes = std::make_shared<const std::vector<Mesh>>(m_meshes);
+
+    // unlike publish() this gives up once stopped, the render thread may be waiting for this thread rather than draining events
+    // whatever loads next builds a table of its own from m_meshes
+    while (m_events && !m_events->tryPush(std::move(ev)))
+    {
+        if (streamStopped())
+            return true;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void Scene::evictMesh(uint32_t meshIdx)
+{
+    // counts, index type and material stay for the instance table
+    Mesh& m = m_meshes[meshIdx];
+    m.indexBuffer.reset();
+    m.positionBuffer.reset();
+    m.normalBuffer.reset();
+    m.tangentBuffer.reset();
+    m.texCoordBuffer.reset();
+    m.jointBuffer.reset();
+    m.weightBuffer.reset();
+    m.jointCount = 0u;
+    m.morphTargetBuffer.reset();
+    m.morphTargetCount = 0u;
+    m_meshHashes[meshIdx] = 0u;
+    m_residentBytes -= m_meshResidency[meshIdx].size;
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+#include "vk_graphics.h"
+#include "geometry_arena.h"
+#include "tiny_gltf.h"
+#include "mapped_file.h"
+#include "scene_graph.h"
+#include "spsc_queue.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+struct Material
+{
+    // TODO below should be clearly named as textures, e.g. texAlbedo
+    // and also include flat values if available, e.g. vec3 albedo
+    std::shared_ptr<vk::Image> albedo;
+    std::shared_ptr<vk::Image> metallicRoughness;
+    std::shared_ptr<vk::Image> normal;
+    std::shared_ptr<vk::Image> emissive;
+};
+
+// TODO maybe this should be the only thing exposed (i.e. this should be Material, rather than above) - store scene images somewhere else
+struct MaterialViews
+{
+    std::shared_ptr<vk::ImageView> albedo;
+    std::shared_ptr<vk::ImageView> metallicRoughness;
+    std::shared_ptr<vk::ImageView> normal;
+    std::shared_ptr<vk::ImageView> emissive;
+};
+
+// every buffer of a mesh is a range of the scene's GeometryArena
+struct Mesh
+{
+    // bits of vertexFormat, decoded by shaders/scene.glsl, see Scene::m_compressVertices
+    static const uint32_t QUANTIZED_POSITIONS = 1u; // snorm16x4, positionTransform maps them back to object space
+    static const uint32_t PACKED_ATTRIBUTES = 2u; // normalBuffer interleaves oct normal, oct tangent and unorm16 uv in 12 bytes per vertex, texCoordTransform maps the uv back
+
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    VkIndexType indexType;
+    std::shared_ptr<GeometryRange> indexBuffer;
+    std::shared_ptr<GeometryRange> positionBuffer;
+    std::shared_ptr<GeometryRange> normalBuffer;
+    std::shared_ptr<GeometryRange> tangentBuffer;
+    std::shared_ptr<GeometryRange> texCoordBuffer;
+    // skinned meshes only, JOINTS_0 as uvec4 and WEIGHTS_0 as vec4, jointCount is one past the largest joint index
+    std::shared_ptr<GeometryRange> jointBuffer;
+    std::shared_ptr<GeometryRange> weightBuffer;
+    uint32_t jointCount = 0u;
+    // position, normal and tangent deltas (vec3) of each morph target in turn, each vertexCount long
+    std::shared_ptr<GeometryRange> morphTargetBuffer;
+    uint32_t morphTargetCount = 0u;
+    uint32_t vertexFormat = 0u;
+    // meshes loaded from a scene pack only, Meshlet descriptors, their vertex indices and their triangles, see meshlet_builder.h
+    std::shared_ptr<GeometryRange> meshletBuffer;
+    std::shared_ptr<GeometryRange> meshletVertexBuffer;
+    std::shared_ptr<GeometryRange> meshletTriangleBuffer;
+    uint32_t meshletCount = 0u;
+    // from stored positions to object space, folded into the transforms of the mesh's instance records
+    glm::mat4 positionTransform = glm::mat4(1.0f);
+    // packed uvs are in [0, 1] over the mesh's uv bounds, uv = xy + zw * stored
+    glm::vec4 texCoordTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    uint32_t materialIdx;
+};
+
+class Animator;
+struct Ktx2Image;
+
+// instance records of a streamed mesh and the addresses they read from now, all 0 if it was evicted
+struct RecordPatch
+{
+    uint32_t firstRecord;
+    uint32_t recordCount;
+    VkDeviceAddress indexAddress;
+    VkDeviceAddress positionAddress;
+    VkDeviceAddress normalAddress;
+    VkDeviceAddress tangentAddress;
+    VkDeviceAddress texCoordAddress;
+    uint32_t vertexFormat;
+    glm::vec4 texCoordTransform;
+};
+
+// handed from the loading thread to the render thread as resources become resident
+struct SceneEvent
+{
+    enum class Type
+    {
+        None,
+        Material, // views of materialIdx, placeholders at first, replaced once its textures land
+        Geometry, // meshes and the instance table are resident, materials past materialCount are gone
+        Residency, // meshes were streamed in or out, patches apply to the instance table of the last Geometry event
+        Loaded,
+        Failed,
+    };
+
+    Type type = Type::None;
+    uint32_t materialIdx = 0u;
+    MaterialViews views;
+    // the images behind the views, released with them
+    Material material;
+    // shared so a table and the meshes it points at, replaced by selectScene() or reload(), live until the render thread lets go of them
+    std::shared_ptr<vk::Buffer> instanceTable;
+    std::shared_ptr<const std::vector<Mesh>> meshes;
+    // plays the scene's animations and deforms its skinned and morphed instances, null if it has none
+    std::shared_ptr<Animator> animator;
+    std::vector<RecordPatch> patches;
+    uint32_t instanceCount = 0u;
+    uint32_t materialCount = 0u;
+};
+
+// one record per mesh instance, indexed by the TLAS instance custom index
+// the EXT_mesh_gpu_instancing instances of a node follow each other, so one instanced draw or TLAS range covers them
+// the transform includes the mesh's positionTransform, packed attributes share normalAddress + 0, 4 and 8
+// must match InstanceRecord in shaders/scene.glsl (std430)
+struct InstanceRecord
+{
+    glm::mat4 transform;
+    VkDeviceAddress indexAddress;
+    VkDeviceAddress positionAddress;
+    VkDeviceAddress normalAddress;
+    VkDeviceAddress tangentAddress;
+    VkDeviceAddress texCoordAddress;
+    uint32_t indexType; // 0 = uint16, 1 = uint32
+    uint32_t materialIdx;
+    uint32_t vertexFormat; // Mesh::vertexFormat
+    uint32_t pad[3];
+    glm::vec4 texCoordTransform; // Mesh::texCoordTransform
+};
+static_assert(sizeof(InstanceRecord) == 144u, "InstanceRecord must match its std430 layout");
+
+// storage of a glTF texture, picked from the material slots sampling it
+struct TextureFormat
+{
+    VkFormat format; // VK_FORMAT_UNDEFINED if no material samples the texture
+    uint32_t firstChannel; // source of the first channel of BC5, the second one follows it
+};
+
+// RGBA8 or, if compressed, BCn format per glTF texture
+std::vector<TextureFormat> gltfTextureFormats(const tinygltf::Model& model, bool compressed);
+bool isSrgbFormat(VkFormat format);
+// writes an RGBA8 mip chain (see mip_chain.h) in the texture's format, dst holds vk::getImageSize() bytes for it
+void encodeTexture(const TextureFormat& format, const unsigned char* chain, uint32_t width, uint32_t height, uint32_t levelCount, unsigned char* dst);
+glm::mat4 gltfLocalTransform(const tinygltf::Node& node);
+
+// bytes of one glTF buffer, pointing into a mapped GLB/.bin file or a decoded data URI
+// hostBuffer is set if the mapped file was imported as a transfer source, data sits at hostOffset in it
+struct BufferSpan
+{
+    const unsigned char* data;
+    size_t size;
+    const vk::Buffer* hostBuffer;
+    VkDeviceSize hostOffset;
+};
+
+// glTF reading shared by Scene and the scene pack baker
+// what meshes without TANGENT or TEXCOORD_0 read instead, a tangent along +X with a right handed bitangent
+const float DEFAULT_TANGENT[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+const float DEFAULT_TEX_COORD[] = { 0.0f, 0.0f };
+
+std::vector<float> repeatValue(const float* value, uint32_t components, uint32_t count);
+// the primitive createMesh() loads, the first triangle list, -1 if there is none
+int findTrianglePrimitive(const tinygltf::Mesh& mesh);
+// an accessor's components as floats, converting integer and normalized component types and applying sparse values
+bool readAccessor(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, int accessorIdx, std::vector<float>& values);
+// a scalar index accessor of any unsigned component type, widened to 32 bits
+bool readIndices(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, int accessorIdx, std::vector<uint32_t>& indices);
+
+class Scene
+{
+public:
+    Scene(vk::Device* gpu, VmaAllocator allocator, VkQueue queue, uint32_t queueFamilyIdx) : m_gpu(gpu), m_allocator(allocator), m_queue(queue), m_queueFamilyIdx(queueFamilyIdx) {}
+    Scene(const Scene&) = delete;
+
+    ~Scene();
+
+    // .craypack files are loaded as baked scene packs, anything else as glTF
+    bool load(const std::string& gltfFilename, bool binary = false);
+    // switches to another scene of a lazily loaded glTF file, loading what it reaches that isn't resident yet
+    bool selectScene(int sceneIdx);
+    // reads the glTF file again, only uploading the meshes, materials and textures whose content changed
+    // nodes are patched in place if the graph kept its shape, the instance table is always rebuilt
+    bool reload();
+
+    // runs a stream pass whenever the view moved, and until every wanted mesh is resident, until stopStreaming()
+    // returns at once unless a glTF file was loaded with m_geometryBudget
+    void streamGeometry();
+    // may be called from any thread
+    void setStreamView(const glm::vec3& position);
+    void stopStreaming();
+
+    VkDeviceAddress getInstanceTableAddress() const { return m_instanceTable->getDeviceAddress(); }
+
+    Scene& operator=(const Scene&) = delete;
+
+    std::vector<Mesh> m_meshes;
+    SceneGraph m_sceneGraph;
+    // receives SceneEvents if set, load() can then run on a thread of its own, it waits while the queue is full
+    SpscQueue<SceneEvent>* m_events = nullptr;
+    // glTF files only load the meshes, materials and textures the selected scene reaches and are kept for selectScene()
+    bool m_lazy = false;
+    // out-of-core geometry, glTF meshes are only uploaded once streamGeometry() finds them near the view
+    // and the least recently wanted ones are evicted to stay under this many bytes, 0 uploads every mesh up front
+    // skinned and morphed meshes always stay resident for the deform pass, scene packs are always loaded whole
+    VkDeviceSize m_geometryBudget = 0u;
+    // glTF meshes that aren't skinned or morphed store oct encoded normals and tangents and 16-bit uvs in one interleaved stream
+    // and 16-bit indices if they have few enough vertices, m_quantizePositions additionally stores positions as snorm16
+    bool m_compressVertices = false;
+    bool m_quantizePositions = false;
+
+private:
+    vk::Device* m_gpu;
+    VmaAllocator m_allocator;
+    VkQueue m_queue;
+    uint32_t m_queueFamilyIdx;
+    VkCommandPool m_cmdPool = VK_NULL_HANDLE;
+    std::unique_ptr<vk::CommandBuffer> m_cmdBuf;
+    // VK_EXT_host_image_copy is enabled and can write shader read only images
+    bool m_hostImageCopy = false;
+    // the device samples the BC formats gltfTextureFormats() picks, textures are compressed on import
+    bool m_blockCompression = false;
+    // AS build input usage for geometry buffers, 0 unless VK_KHR_acceleration_structure is enabled
+    VkBufferUsageFlags m_asInputUsage = 0u;
+
+    // for reload()
+    std::string m_filename;
+    bool m_binary = false;
+    int m_sceneIdx = 0;
+    // content hashes per glTF mesh, material and texture, 0 if not loaded
+    std::vector<uint64_t> m_meshHashes;
+    std::vector<uint64_t> m_materialHashes;
+    std::vector<uint64_t> m_textureHashes;
+
+    // only valid during load(), or until destruction for lazily loaded glTF files
+    std::unique_ptr<tinygltf::Model> m_model;
+    std::vector<std::unique_ptr<MappedFile>> m_mappedFiles;
+    std::vector<std::vector<unsigned char>> m_decodedBuffers;
+    std::vector<BufferSpan> m_buffers;
+    // declared after the mappings so they are released first
+    std::vector<std::unique_ptr<vk::Buffer>> m_importedBuffers;
+    // minImportedHostPointerAlignment if mapped files can be imported via VK_EXT_external_memory_host, 0 otherwise
+    VkDeviceSize m_hostImportAlignment = 0u;
+    // index and attribute data of every mesh, shared with the render thread's copies of the meshes
+    std::shared_ptr<GeometryArena> m_geometryArena;
+    // mesh buffers created during load(), keyed by content hash or, when copied from an imported mapping, source range
+    struct CachedMeshBuffer
+    {
+        const unsigned char* src;
+        size_t elemSize;
+        size_t count;
+        size_t byteStride;
+        bool byContent;
+        std::shared_ptr<GeometryRange> buffer;
+    };
+    std::unordered_multimap<uint64_t, CachedMeshBuffer> m_meshBufferCache;
+    // per glTF image, the first image with the same bytes, -1 until it is read
+    std::vector<int> m_canonicalImages;
+    std::vector<uint64_t> m_imageHashes;
+    std::unordered_multimap<uint64_t, int> m_imagesByHash;
+    // the texture decoded for each canonical image, format and first channel
+    std::map<std::tuple<int, VkFormat, uint32_t>, int> m_texturesByPayload;
+
+    // indexed by glTF texture, null if no material samples it
+    std::vector<std::shared_ptr<vk::Image>> m_textures;
+    std::vector<Material> m_materials;
+    std::vector<MaterialViews> m_materialViews;
+    // per glTF material, set once a scene reached it
+    std::vector<bool> m_materialCreated;
+    // 1x1 stand-ins per slot, sampled by glTF materials until their textures are resident
+    Material m_placeholders;
+
+    std::shared_ptr<vk::Buffer> m_instanceTable;
+    // scene graph node of each glTF node of the current scene, -1 for nodes outside it
+    std::vector<int32_t> m_nodeIds;
+    // EXT_mesh_gpu_instancing, first and count of each scene graph node's transforms in m_instanceTransforms, count 0 for plain nodes
+    // relative to the node, read by createNodes() and released by createInstanceTable()
+    std::vector<std::pair<uint32_t, uint32_t>> m_instanceRanges;
+    std::vector<glm::mat4> m_instanceTransforms;
+
+    // streamed meshes by glTF index, see m_geometryBudget
+    struct MeshResidency
+    {
+        VkDeviceSize size; // of its buffers, estimated from the glTF accessors
+        glm::vec4 bounds; // object space bounding sphere of POSITION
+        uint64_t lastWanted; // stream pass that last found it within the budget
+        bool pinned;
+    };
+    std::vector<MeshResidency> m_meshResidency;
+    VkDeviceSize m_residentBytes = 0u;
+    VkDeviceSize m_pinnedBytes = 0u;
+    uint64_t m_streamPass = 0u;
+    // world space bounding sphere of every instance record of a streamed mesh
+    struct StreamedInstance
+    {
+        glm::vec4 sphere;
+        uint32_t mesh;
+    };
+    std::vector<StreamedInstance> m_streamedInstances;
+    // per mesh, the runs of instance records using it as first, count
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> m_meshRecords;
+    // guard the view and stop request handed in by other threads
+    std::mutex m_streamMutex;
+    std::condition_variable m_streamCond;
+    glm::vec3 m_streamView = glm::vec3(0.0f);
+    bool m_streamViewChanged = false;
+    bool m_streamStop = false;
+
+    bool canHostCopy(VkFormat format) const;
+    bool canBlitMips(VkFormat format) const;
+    bool canSample(VkFormat format) const;
+    bool beginUpload();
+    bool endUpload();
+
+    // one glTF image after decoding, staging holds the encoded chain of every texture sampling it by texture index
+    // it is empty if the textures were copied from the host already
+    struct DecodedImage
+    {
+        VkExtent3D extent;
+        uint32_t levelCount;
+        // the container's format for KTX2 levels uploaded as stored, each texture takes the sRGB or UNORM variant it samples in
+        // VK_FORMAT_UNDEFINED if the textures' own formats apply
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<std::pair<size_t, std::unique_ptr<vk::Buffer>>> staging;
+        std::string error;
+    };
+
+    bool loadGltf(const std::string& gltfFilename, bool binary);
+    bool loadGltfScene(int sceneIdx);
+    bool reloadGltf();
+    void releaseSourceData();
+    bool loadPack(const std::string& packFilename);
+    const vk::Buffer* importMappedFile(const MappedFile& file);
+    bool parseGltf(const std::string& gltfFilename, bool binary, tinygltf::Model& model);
+    bool readImage(const tinygltf::Image& image, std::vector<unsigned char>& bytes) const;
+    // reads the image unless its bytes are there already, hashes it and finds the first image with the same bytes
+    bool readCanonicalImage(const tinygltf::Model& model, int imageIdx, std::vector<std::vector<unsigned char>>& encodedImages);
+    // image a glTF texture samples, the KHR_texture_basisu (KTX2) one unless decodeKtx2() can't read it and there is a fallback source
+    // reads the KTX2 image's bytes into encodedImages to check its payload
+    int textureSource(const tinygltf::Model& model, int textureIdx, std::vector<std::vector<unsigned char>>& encodedImages);
+    uint64_t textureHash(int canonicalImage, const TextureFormat& format) const;
+    uint64_t materialHash(const tinygltf::Material& material) const;
+    uint64_t meshHash(const tinygltf::Model& model, uint32_t meshIdx) const;
+    struct TextureLoad;
+    // reads the images of the used textures that aren't resident yet and submits their decode to the pool
+    // finishTextures() uploads them and swaps the materials' placeholders
+    bool startTextureDecode(tinygltf::Model& model, const std::vector<bool>& textureUsed, TextureLoad& load);
+    bool finishTextures(tinygltf::Model& model, TextureLoad& load, std::vector<bool>& pendingMaterials);
+    bool decodeImage(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, std::vector<unsigned char>& encoded, DecodedImage& decoded);
+    bool canDecodeKtx2(const Ktx2Image& ktx, std::string& error) const;
+    bool decodeKtx2(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, const std::vector<unsigned char>& encoded, DecodedImage& decoded);
+    // builds the mip chain of 8-bit texels with comp channels and encodes it for every texture sampling the image
+    bool encodeImage(const std::vector<int>& sources, int imageIdx, const std::vector<TextureFormat>& formats, bool hostCopy, const unsigned char* texels, uint32_t width, uint32_t height, int comp, DecodedImage& decoded);
+    // texels hold levelCount tightly packed mip levels in format, the staging path blits any missing ones down to 1x1
+    std::shared_ptr<vk::Image> createTexture(VkExtent3D extent, VkFormat format, uint32_t levelCount, const void* texels);
+    std::shared_ptr<vk::Image> createTexture(VkExtent3D extent, VkFormat format, uint32_t levelCount, const vk::Buffer& staging, VkDeviceSize stagingOffset = 0u);
+    std::shared_ptr<GeometryRange> createMeshBuffer(tinygltf::Model& model, tinygltf::Accessor& accessor, size_t elemSize);
+    // returns the range already created for the same payload if there is one
+    std::shared_ptr<GeometryRange> createBuffer(const BufferSpan& src, VkDeviceSize srcOffset, size_t elemSize, size_t count, size_t byteStride);
+    std::shared_ptr<GeometryRange> uploadBuffer(const BufferSpan& src, VkDeviceSize srcOffset, size_t elemSize, size_t count, size_t byteStride);
+    // vertexCount copies of value, for attributes the mesh doesn't have
+    std::shared_ptr<GeometryRange> createDefaultStream(const float* value, uint32_t components, uint32_t vertexCount);
+
+    bool createPlaceholders();
+    Material createMaterial(const tinygltf::Material& material, bool placeholder) const;
+    bool addMaterial(const Material& mat);
+    // creates the views and publishes them
+    bool setMaterial(uint32_t idx, const Material& mat);
+    void publishMaterial(uint32_t idx);
+    void publish(SceneEvent&& ev);
+    bool createMesh(tinygltf::Model& model, uint32_t meshIdx);
+    // normal, tangent and uv interleaved into normalBuffer and the positions, quantized if m_quantizePositions
+    bool createPackedAttributes(tinygltf::Model& model, tinygltf::Primitive& prim, Mesh& m);
+    bool createNodes(const tinygltf::Model& model, const tinygltf::Scene& scene);
+    // animations, skins and deformed instances of the scene graph, animator stays null if there are none
+    bool createAnimator(const tinygltf::Model& model, std::shared_ptr<Animator>& animator);
+    // instances deformed by animator read its copies of their attributes
+    bool createInstanceTable(std::shared_ptr<Animator> animator = nullptr);
+
+    bool streaming() const { return m_geometryBudget > 0u && m_model; }
+    // sizes and bounds the meshes the scene reaches, only uploading the pinned ones
+    bool initStreaming(tinygltf::Model& model, const std::vector<bool>& meshUsed);
+    // uploads the nearest wanted meshes that aren't resident, evicting others, and publishes the records that changed
+    // pending is set if uploads are left over for the next pass
+    bool streamPass(const glm::vec3& view, bool& pending);
+    bool streamStopped();
+    void evictMesh(uint32_t meshIdx);
+};
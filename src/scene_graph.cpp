@@ -0,0 +1,183 @@
+#include "scene_graph.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_GRAPH_SSE2
+#include <emmintrin.h>
+#endif
+
+// dst = a * b for column major matrices, dst may not alias a or b
+static void multiplyTransforms(glm::mat4& dst, const glm::mat4& a, const glm::mat4& b)
+{
+#ifdef SCENE_GRAPH_SSE2
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    float* pd = &dst[0][0];
+    __m128 a0 = _mm_loadu_ps(pa);
+    __m128 a1 = _mm_loadu_ps(pa + 4);
+    __m128 a2 = _mm_loadu_ps(pa + 8);
+    __m128 a3 = _mm_loadu_ps(pa + 12);
+    for (int c = 0; c < 4; c++)
+    {
+        // column c of the product is a's columns weighted by column c of b
+        __m128 col = _mm_mul_ps(a0, _mm_set1_ps(pb[4 * c + 0]));
+        col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(pb[4 * c + 1])));
+        col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(pb[4 * c + 2])));
+        col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(pb[4 * c + 3])));
+        _mm_storeu_ps(pd + 4 * c, col);
+    }
+#else
+    dst = a * b;
+#endif
+}
+
+uint32_t SceneGraph::addNode(int32_t parent, uint32_t mesh, const glm::mat4& localTransform)
+{
+    uint32_t node = static_cast<uint32_t>(m_parents.size());
+    m_parents.push_back(parent);
+    m_meshes.push_back(mesh);
+    m_slots.push_back(node);
+    m_parentSlots.push_back(parent >= 0 ? static_cast<int32_t>(m_slots[parent]) : -1);
+    m_localTransforms.push_back(localTransform);
+    m_worldTransforms.push_back(localTransform);
+    m_dirty.push_back(1u);
+    m_anyDirty = true;
+    m_levelsValid = false;
+    return node;
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+    m_localTransforms[m_slots[node]] = localTransform;
+    m_dirty[m_slots[node]] = 1u;
+    m_anyDirty = true;
+}
+
+void SceneGraph::clear()
+{
+    m_parents.clear();
+    m_meshes.clear();
+    m_slots.clear();
+    m_parentSlots.clear();
+    m_localTransforms.clear();
+    m_worldTransforms.clear();
+    m_dirty.clear();
+    m_levelOffsets.clear();
+    m_levelsValid = true;
+    m_anyDirty = false;
+}
+
+// breadth first reordering of the slots, children grouped in CSR form first
+void SceneGraph::buildLevels()
+{
+    size_t nodeCount = m_parents.size();
+    std::vector<uint32_t> childOffsets(nodeCount + 1u, 0u);
+    for (int32_t parent : m_parents)
+    {
+        if (parent >= 0)
+            childOffsets[parent + 1]++;
+    }
+    for (size_t i = 0; i < nodeCount; i++)
+        childOffsets[i + 1u] += childOffsets[i];
+    std::vector<uint32_t> children(childOffsets[nodeCount]);
+    std::vector<uint32_t> next(childOffsets.begin(), childOffsets.end() - 1);
+    for (uint32_t node = 0; node < nodeCount; node++)
+    {
+        if (m_parents[node] >= 0)
+            children[next[m_parents[node]]++] = node;
+    }
+
+    // roots make up level 0, each further level is the children of the one before in order
+    std::vector<uint32_t> order;
+    order.reserve(nodeCount);
+    for (uint32_t node = 0; node < nodeCount; node++)
+    {
+        if (m_parents[node] < 0)
+            order.push_back(node);
+    }
+    m_levelOffsets.assign(1u, 0u);
+    for (size_t levelBegin = 0; levelBegin < order.size();)
+    {
+        size_t levelEnd = order.size();
+        m_levelOffsets.push_back(levelEnd);
+        for (size_t i = levelBegin; i < levelEnd; i++)
+            order.insert(order.end(), children.begin() + childOffsets[order[i]], children.begin() + childOffsets[order[i] + 1u]);
+        levelBegin = levelEnd;
+    }
+
+    std::vector<int32_t> parentSlots(nodeCount);
+    std::vector<glm::mat4> localTransforms(nodeCount);
+    std::vector<glm::mat4> worldTransforms(nodeCount);
+    std::vector<uint8_t> dirty(nodeCount);
+    std::vector<uint32_t> slots(nodeCount);
+    for (uint32_t slot = 0; slot < nodeCount; slot++)
+        slots[order[slot]] = slot;
+    for (uint32_t slot = 0; slot < nodeCount; slot++)
+    {
+        uint32_t node = order[slot];
+        parentSlots[slot] = m_parents[node] >= 0 ? static_cast<int32_t>(slots[m_parents[node]]) : -1;
+        localTransforms[slot] = m_localTransforms[m_slots[node]];
+        worldTransforms[slot] = m_worldTransforms[m_slots[node]];
+        dirty[slot] = m_dirty[m_slots[node]];
+    }
+    m_slots.swap(slots);
+    m_parentSlots.swap(parentSlots);
+    m_localTransforms.swap(localTransforms);
+    m_worldTransforms.swap(worldTransforms);
+    m_dirty.swap(dirty);
+    m_levelsValid = true;
+}
+
+// parents are one level up and already final, so every slot in the range is independent of the others
+void SceneGraph::updateRange(size_t begin, size_t end)
+{
+    for (size_t slot = begin; slot < end; slot++)
+    {
+        int32_t parent = m_parentSlots[slot];
+        if (parent >= 0)
+            m_dirty[slot] |= m_dirty[parent];
+        if (!m_dirty[slot])
+            continue;
+
+        if (parent >= 0)
+            multiplyTransforms(m_worldTransforms[slot], m_worldTransforms[parent], m_localTransforms[slot]);
+        else
+            m_worldTransforms[slot] = m_localTransforms[slot];
+    }
+}
+
+void SceneGraph::updateTransforms(ThreadPool* pool)
+{
+    if (!m_anyDirty)
+        return;
+    if (!m_levelsValid)
+        buildLevels();
+
+    std::vector<std::future<void>> chunks;
+    for (size_t d = 0; d + 1u < m_levelOffsets.size(); d++)
+    {
+        size_t begin = m_levelOffsets[d];
+        size_t end = m_levelOffsets[d + 1u];
+        if (!pool || end - begin < PARALLEL_MIN_NODES)
+        {
+            updateRange(begin, end);
+            continue;
+        }
+
+        // one chunk per worker, the calling thread takes the last one and then waits for the rest before the next level
+        size_t chunkCount = std::min(static_cast<size_t>(pool->getThreadCount()) + 1u, (end - begin) / (PARALLEL_MIN_NODES / 4u));
+        size_t chunkSize = (end - begin + chunkCount - 1u) / chunkCount;
+        for (size_t chunk = begin; chunk + chunkSize < end; chunk += chunkSize)
+            chunks.push_back(pool->submit([this, chunk, chunkSize]() { updateRange(chunk, chunk + chunkSize); }));
+        updateRange(begin + chunks.size() * chunkSize, end);
+        for (std::future<void>& c : chunks)
+            c.get();
+        chunks.clear();
+    }
+
+    std::fill(m_dirty.begin(), m_dirty.end(), static_cast<uint8_t>(0u));
+    m_anyDirty = false;
+}
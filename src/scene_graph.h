@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// flat scene graph, one entry per node in parallel arrays indexed by node
+// nodes are added parents first, world transforms are only recomputed below nodes whose local transform changed
+class SceneGraph
+{
+public:
+    // mesh of transform-only nodes
+    static const uint32_t NO_MESH = ~0u;
+    // levels smaller than this are updated on the calling thread
+    static const size_t PARALLEL_MIN_NODES = 8192u;
+
+    // parent is -1 for roots and otherwise an index returned earlier
+    uint32_t addNode(int32_t parent, uint32_t mesh, const glm::mat4& localTransform);
+    void setLocalTransform(uint32_t node, const glm::mat4& localTransform);
+    void clear();
+
+    // recomputes the world transforms of dirty nodes and their descendants, level by level, each level split across pool if given
+    void updateTransforms(ThreadPool* pool = nullptr);
+
+    size_t size() const { return m_parents.size(); }
+    int32_t getParent(uint32_t node) const { return m_parents[node]; }
+    uint32_t getMesh(uint32_t node) const { return m_meshes[node]; }
+    const glm::mat4& getLocalTransform(uint32_t node) const { return m_localTransforms[m_slots[node]]; }
+    // only current after updateTransforms()
+    const glm::mat4& getWorldTransform(uint32_t node) const { return m_worldTransforms[m_slots[node]]; }
+
+private:
+    // per node, indexed by the ids addNode returns
+    std::vector<int32_t> m_parents;
+    std::vector<uint32_t> m_meshes;
+    std::vector<uint32_t> m_slots;
+
+    // per slot, slots are assigned breadth first so levels are contiguous and children follow their parents' order
+    // level d is slots m_levelOffsets[d] .. m_levelOffsets[d + 1], nodes added since the last update are appended unordered
+    std::vector<int32_t> m_parentSlots;
+    std::vector<glm::mat4> m_localTransforms;
+    std::vector<glm::mat4> m_worldTransforms;
+    std::vector<uint8_t> m_dirty;
+    std::vector<size_t> m_levelOffsets;
+    bool m_levelsValid = true;
+    bool m_anyDirty = false;
+
+    void buildLevels();
+    void updateRange(size_t begin, size_t end);
+};
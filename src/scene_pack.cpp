@@ -0,0 +1,353 @@
+#include "scene_pack.h"
+#include "scene.h"
+#include "mip_chain.h"
+#include "thread_pool.h"
+#include "ktx2.h"
+#include "content_hash.h"
+#include "meshlet_builder.h"
+
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace pack
+{
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1u) / alignment * alignment;
+}
+
+template <typename T>
+static std::vector<unsigned char> streamBytes(const std::vector<T>& values)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    return std::vector<unsigned char>(bytes, bytes + sizeof(T) * values.size());
+}
+
+struct BakedMesh
+{
+    MeshRecord record;
+    // index, position, normal, tangent, texcoord, meshlets, meshlet vertices, meshlet triangles
+    std::vector<unsigned char> streams[8];
+};
+
+struct BakedTexture
+{
+    TextureRecord record;
+    std::vector<unsigned char> texels;
+};
+
+static bool bakeMesh(const tinygltf::Model& model, const std::vector<BufferSpan>& buffers, const tinygltf::Mesh& mesh, BakedMesh& baked)
+{
+    // same primitive, validation and default streams as Scene::createMesh, attributes are converted to float whatever their component type
+    int primIdx = findTrianglePrimitive(mesh);
+    if (primIdx == -1)
+    {
+        LOGE("Unsupported glTF mesh primitive mode, or primitive mode unspecified.");
+        return false;
+    }
+
+    const tinygltf::Primitive& prim = mesh.primitives[primIdx];
+    auto position = prim.attributes.find("POSITION");
+    auto normal = prim.attributes.find("NORMAL");
+    if (prim.indices < 0 || position == prim.attributes.end() || normal == prim.attributes.end())
+    {
+        LOGE("glTF mesh \'" + mesh.name + "\' has no indices, POSITION or NORMAL attribute.");
+        return false;
+    }
+    auto tangent = prim.attributes.find("TANGENT");
+    auto texCoord = prim.attributes.find("TEXCOORD_0");
+
+    std::vector<float> positions, normals, tangents, texCoords;
+    bool read = readAccessor(model, buffers, position->second, positions) && readAccessor(model, buffers, normal->second, normals);
+    uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3u);
+    if (tangent != prim.attributes.end())
+        read = read && readAccessor(model, buffers, tangent->second, tangents);
+    else
+        tangents = repeatValue(DEFAULT_TANGENT, 4u, vertexCount);
+    if (texCoord != prim.attributes.end())
+        read = read && readAccessor(model, buffers, texCoord->second, texCoords);
+    else
+        texCoords = repeatValue(DEFAULT_TEX_COORD, 2u, vertexCount);
+    if (!read || positions.size() != 3u * vertexCount || normals.size() != 3u * vertexCount || tangents.size() != 4u * vertexCount || texCoords.size() != 2u * vertexCount)
+    {
+        LOGE("glTF mesh \'" + mesh.name + "\' has unreadable POSITION, NORMAL, TANGENT or TEXCOORD_0 attributes.");
+        return false;
+    }
+
+    std::vector<uint32_t> indices;
+    if (!readIndices(model, buffers, prim.indices, indices))
+    {
+        LOGE("glTF mesh \'" + mesh.name + "\' has unreadable indices.");
+        return false;
+    }
+
+    baked.record.indexCount = static_cast<uint32_t>(indices.size());
+    baked.record.vertexCount = vertexCount;
+    baked.record.materialIdx = static_cast<uint32_t>(std::max(0, prim.material));
+    if (model.accessors[prim.indices].componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+    {
+        baked.record.indexType = VK_INDEX_TYPE_UINT32;
+        baked.streams[0] = streamBytes(indices);
+    }
+    else
+    {
+        // byte indices are widened, they can't be bound without VK_EXT_index_type_uint8
+        baked.record.indexType = VK_INDEX_TYPE_UINT16;
+        baked.streams[0] = streamBytes(std::vector<uint16_t>(indices.begin(), indices.end()));
+    }
+    baked.streams[1] = streamBytes(positions);
+    baked.streams[2] = streamBytes(normals);
+    baked.streams[3] = streamBytes(tangents);
+    baked.streams[4] = streamBytes(texCoords);
+
+    MeshletSet meshlets;
+    if (!buildMeshlets(reinterpret_cast<const glm::vec3*>(positions.data()), vertexCount, indices.data(), indices.size(), meshlets))
+    {
+        LOGE("glTF mesh '" + mesh.name + "' has indices past its vertices.");
+        return false;
+    }
+    baked.record.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size());
+    baked.record.meshletVertexCount = static_cast<uint32_t>(meshlets.vertices.size());
+    baked.record.meshletTriangleSize = static_cast<uint32_t>(meshlets.triangles.size());
+    baked.record.pad = 0u;
+    baked.streams[5] = streamBytes(meshlets.meshlets);
+    baked.streams[6] = streamBytes(meshlets.vertices);
+    baked.streams[7] = std::move(meshlets.triangles);
+
+    return true;
+}
+
+// KTX2 images stay undecoded, the baker encodes from the textures' fallback sources
+static bool loadImageSkipKtx2(tinygltf::Image* image, const int imageIdx, std::string* err, std::string* warn, int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData)
+{
+    if (isKtx2(bytes, static_cast<size_t>(size)))
+        return true;
+    return tinygltf::LoadImageData(image, imageIdx, err, warn, reqWidth, reqHeight, bytes, size, userData);
+}
+
+static bool bakeTexture(const tinygltf::Model& model, int textureIdx, const TextureFormat& format, BakedTexture& baked)
+{
+    int source = model.textures[textureIdx].source;
+    if (source < 0 || model.images[source].image.empty())
+    {
+        LOGE("glTF texture " + std::to_string(textureIdx) + " has no image the baker can decode, KHR_texture_basisu needs a PNG/JPEG fallback source.");
+        return false;
+    }
+
+    const tinygltf::Image& img = model.images[source];
+    if (img.component != 4)
+    {
+        LOGE("Failed to decode glTF image \'" + (img.uri.empty() ? img.name : img.uri) + "\'.");
+        return false;
+    }
+
+    baked.record.width = static_cast<uint32_t>(img.width);
+    baked.record.height = static_cast<uint32_t>(img.height);
+    baked.record.format = format.format;
+    baked.record.mipCount = mipLevelCount(baked.record.width, baked.record.height);
+
+    // the chain is built in RGBA8, 16-bit sources keep their high bytes
+    size_t count = static_cast<size_t>(img.width) * static_cast<size_t>(img.height) * 4u;
+    std::vector<unsigned char> chain(mipChainSize(baked.record.width, baked.record.height, baked.record.mipCount));
+    if (img.bits == 16)
+    {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(img.image.data());
+        for (size_t i = 0; i < count; i++)
+            chain[i] = static_cast<unsigned char>(src[i] >> 8);
+    }
+    else
+    {
+        memcpy(chain.data(), img.image.data(), count);
+    }
+    generateMipChain(chain.data(), baked.record.width, baked.record.height, baked.record.mipCount, isSrgbFormat(format.format));
+
+    VkExtent3D extent = { baked.record.width, baked.record.height, 1u };
+    baked.texels.resize(static_cast<size_t>(vk::getImageSize(format.format, extent, baked.record.mipCount)));
+    encodeTexture(format, chain.data(), baked.record.width, baked.record.height, baked.record.mipCount, baked.texels.data());
+    baked.record.dataSize = baked.texels.size();
+
+    return true;
+}
+
+// mirrors Scene::createNodes, meshless nodes are kept as transforms of their subtrees
+static void bakeNode(const tinygltf::Model& model, const tinygltf::Node& node, int32_t parent, std::vector<NodeRecord>& nodes)
+{
+    // packs have no instance transforms, such nodes keep only their own
+    if (node.extensions.count("EXT_mesh_gpu_instancing") > 0u)
+        LOGW("glTF node \'" + node.name + "\' is baked without its EXT_mesh_gpu_instancing instances.");
+
+    NodeRecord record;
+    record.parent = parent;
+    record.mesh = node.mesh >= 0 ? static_cast<uint32_t>(node.mesh) : SceneGraph::NO_MESH;
+    glm::mat4 local = gltfLocalTransform(node);
+    memcpy(record.localTransform, glm::value_ptr(local), sizeof(record.localTransform));
+
+    int32_t idx = static_cast<int32_t>(nodes.size());
+    nodes.push_back(record);
+    for (int c : node.children)
+        bakeNode(model, model.nodes[c], idx, nodes);
+}
+
+bool bakeScenePack(const std::string& gltfFilename, const std::string& packFilename)
+{
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(&loadImageSkipKtx2, nullptr);
+    std::string warn;
+    std::string err;
+    bool binary = gltfFilename.size() >= 4u && gltfFilename.compare(gltfFilename.size() - 4u, 4u, ".glb") == 0;
+    bool ret = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, gltfFilename) : loader.LoadASCIIFromFile(&model, &err, &warn, gltfFilename);
+    if (!warn.empty())
+        LOGW(warn);
+    if (!err.empty())
+        LOGE(err);
+    if (!ret)
+    {
+        LOGE("Failed to parse glTF file \'" + gltfFilename + "\'.");
+        return false;
+    }
+
+    std::vector<BufferSpan> buffers;
+    for (const tinygltf::Buffer& buffer : model.buffers)
+        buffers.push_back({ buffer.data.data(), buffer.data.size(), nullptr, 0u });
+
+    // meshes and their meshlets are built one per pool thread, textures no material samples are baked as empty records to keep glTF texture indices
+    // textures are always block compressed, one texture per pool thread
+    std::vector<BakedMesh> meshes(model.meshes.size());
+    std::vector<TextureFormat> formats = gltfTextureFormats(model, true);
+    std::vector<BakedTexture> textures(model.textures.size());
+    {
+        ThreadPool pool;
+        std::vector<std::future<bool>> results;
+        std::chrono::steady_clock::time_point meshStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < model.meshes.size(); i++)
+            results.push_back(pool.submit([&model, &buffers, &meshes, i]() { return bakeMesh(model, buffers, model.meshes[i], meshes[i]); }));
+
+        bool bakedMeshes = true;
+        for (std::future<bool>& result : results)
+            bakedMeshes = result.get() && bakedMeshes;
+        if (!bakedMeshes)
+            return false;
+        results.clear();
+
+        uint64_t meshletCount = 0u;
+        uint64_t triangleCount = 0u;
+        for (const BakedMesh& mesh : meshes)
+        {
+            meshletCount += mesh.record.meshletCount;
+            triangleCount += mesh.record.indexCount / 3u;
+        }
+        double meshMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshStart).count();
+        LOG("Built " + std::to_string(meshletCount) + " meshlets from " + std::to_string(triangleCount) + " triangles in " + std::to_string(meshMs) + " ms on a pool of " +
+            std::to_string(pool.getThreadCount()) + " threads.");
+
+        for (size_t i = 0; i < model.textures.size(); i++)
+        {
+            textures[i].record = TextureRecord{};
+            if (formats[i].format != VK_FORMAT_UNDEFINED)
+                results.push_back(pool.submit([&model, &formats, &textures, i]() { return bakeTexture(model, static_cast<int>(i), formats[i], textures[i]); }));
+        }
+
+        bool baked = true;
+        for (std::future<bool>& result : results)
+            baked = result.get() && baked;
+        if (!baked)
+            return false;
+    }
+
+    std::vector<MaterialRecord> materials;
+    for (const tinygltf::Material& mat : model.materials)
+        materials.push_back({ mat.pbrMetallicRoughness.baseColorTexture.index, mat.pbrMetallicRoughness.metallicRoughnessTexture.index, mat.normalTexture.index, mat.emissiveTexture.index });
+
+    std::vector<NodeRecord> nodes;
+    const tinygltf::Scene& scene = model.scenes[std::max(0, model.defaultScene)];
+    for (int n : scene.nodes)
+        bakeNode(model, model.nodes[n], -1, nodes);
+
+    // lay out tables then data
+    Header header{};
+    header.magic = SCENE_PACK_MAGIC;
+    header.version = SCENE_PACK_VERSION;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.materialCount = static_cast<uint32_t>(materials.size());
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+
+    uint64_t offset = sizeof(Header);
+    header.meshesOffset = offset = alignUp(offset, SCENE_PACK_TABLE_ALIGNMENT);
+    offset += sizeof(MeshRecord) * meshes.size();
+    header.texturesOffset = offset = alignUp(offset, SCENE_PACK_TABLE_ALIGNMENT);
+    offset += sizeof(TextureRecord) * textures.size();
+    header.materialsOffset = offset = alignUp(offset, SCENE_PACK_TABLE_ALIGNMENT);
+    offset += sizeof(MaterialRecord) * materials.size();
+    header.nodesOffset = offset = alignUp(offset, SCENE_PACK_TABLE_ALIGNMENT);
+    offset += sizeof(NodeRecord) * nodes.size();
+
+    // identical streams and texture chains are stored once, every record with that payload points at the same bytes
+    std::vector<std::pair<uint64_t, const std::vector<unsigned char>*>> blobs;
+    std::unordered_multimap<uint64_t, size_t> blobsByHash;
+    auto placeBlob = [&](const std::vector<unsigned char>& data) {
+        uint64_t hash = hashBytes(data.data(), data.size());
+        auto range = blobsByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (*blobs[it->second].second == data)
+                return blobs[it->second].first;
+        }
+
+        offset = alignUp(offset, SCENE_PACK_DATA_ALIGNMENT);
+        blobsByHash.emplace(hash, blobs.size());
+        blobs.emplace_back(offset, &data);
+        offset += data.size();
+        return blobs.back().first;
+    };
+    for (BakedMesh& mesh : meshes)
+    {
+        uint64_t* streamOffsets[] = { &mesh.record.indexOffset, &mesh.record.positionOffset, &mesh.record.normalOffset, &mesh.record.tangentOffset, &mesh.record.texCoordOffset,
+            &mesh.record.meshletOffset, &mesh.record.meshletVertexOffset, &mesh.record.meshletTriangleOffset };
+        for (int i = 0; i < 8; i++)
+            *streamOffsets[i] = placeBlob(mesh.streams[i]);
+    }
+    for (BakedTexture& tex : textures)
+        tex.record.dataOffset = placeBlob(tex.texels);
+    header.fileSize = offset;
+
+    std::ofstream file(packFilename, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        LOGE("Failed to open \'" + packFilename + "\' for writing.");
+        return false;
+    }
+
+    uint64_t written = 0u;
+    auto writeAt = [&file, &written](uint64_t at, const void* data, size_t size) {
+        static const char zeros[SCENE_PACK_DATA_ALIGNMENT] = {};
+        file.write(zeros, static_cast<std::streamsize>(at - written));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        written = at + size;
+    };
+
+    writeAt(0u, &header, sizeof(header));
+    for (size_t i = 0; i < meshes.size(); i++)
+        writeAt(header.meshesOffset + sizeof(MeshRecord) * i, &meshes[i].record, sizeof(MeshRecord));
+    for (size_t i = 0; i < textures.size(); i++)
+        writeAt(header.texturesOffset + sizeof(TextureRecord) * i, &textures[i].record, sizeof(TextureRecord));
+    writeAt(header.materialsOffset, materials.data(), sizeof(MaterialRecord) * materials.size());
+    writeAt(header.nodesOffset, nodes.data(), sizeof(NodeRecord) * nodes.size());
+    for (const std::pair<uint64_t, const std::vector<unsigned char>*>& blob : blobs)
+        writeAt(blob.first, blob.second->data(), blob.second->size());
+
+    if (!file)
+    {
+        LOGE("Failed to write \'" + packFilename + "\'.");
+        return false;
+    }
+
+    LOG("Baked \'" + gltfFilename + "\' into \'" + packFilename + "\' (" + std::to_string(header.fileSize) + " bytes).");
+    return true;
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+// .craypack: GPU-ready scene baked offline from glTF, loaded by mapping the file and uploading straight from it
+// little endian, all offsets are from the start of the file
+// tables follow the header, each aligned to SCENE_PACK_TABLE_ALIGNMENT
+// every stream and texture blob is aligned to SCENE_PACK_DATA_ALIGNMENT so it can be a copy source as is
+namespace pack
+{
+
+const uint32_t SCENE_PACK_MAGIC = 0x4B505243u; // "CRPK"
+const uint32_t SCENE_PACK_VERSION = 2u;
+const uint64_t SCENE_PACK_TABLE_ALIGNMENT = 16u;
+const uint64_t SCENE_PACK_DATA_ALIGNMENT = 256u;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t materialCount;
+    uint32_t nodeCount;
+    uint64_t meshesOffset;
+    uint64_t texturesOffset;
+    uint64_t materialsOffset;
+    uint64_t nodesOffset;
+    uint64_t fileSize;
+};
+
+// tightly packed streams: uint16/uint32 indices, vec3 positions, vec3 normals, vec4 tangents, vec2 texcoords
+// followed by the mesh's meshlets, their vertices and their triangles, see MeshletSet in meshlet_builder.h
+struct MeshRecord
+{
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t indexType; // VkIndexType
+    uint32_t materialIdx;
+    uint64_t indexOffset;
+    uint64_t positionOffset;
+    uint64_t normalOffset;
+    uint64_t tangentOffset;
+    uint64_t texCoordOffset;
+    uint64_t meshletOffset;
+    uint64_t meshletVertexOffset;
+    uint64_t meshletTriangleOffset;
+    uint32_t meshletCount;
+    uint32_t meshletVertexCount;
+    uint32_t meshletTriangleSize; // in bytes
+    uint32_t pad;
+};
+
+// mip levels tightly packed one after another, level 0 first
+struct TextureRecord
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t format; // VkFormat
+    uint32_t mipCount;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+// texture indices, -1 if absent
+struct MaterialRecord
+{
+    int32_t albedo;
+    int32_t metallicRoughness;
+    int32_t normal;
+    int32_t emissive;
+};
+
+// parents always precede their children
+struct NodeRecord
+{
+    int32_t parent;
+    uint32_t mesh; // ~0u for nodes that only transform their children
+    float localTransform[16];
+};
+
+// CPU only, no device needed
+bool bakeScenePack(const std::string& gltfFilename, const std::string& packFilename);
+
+}
@@ -1,6 +1,8 @@
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe gbuffer.vert -o gbuffer.vert.spv --target-spv=spv1.4
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe gbuffer.frag -o gbuffer.frag.spv --target-spv=spv1.4
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe lighting.comp -o lighting.comp.spv --target-spv=spv1.4
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe deform.comp -o deform.comp.spv --target-spv=spv1.4
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe test.vert -o test.vert.spv --target-spv=spv1.4
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe test.frag -o test.frag.spv --target-spv=spv1.4
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe smoke.rgen -o smoke.rgen.spv --target-spv=spv1.4
 pause
\ No newline at end of file
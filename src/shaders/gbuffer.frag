@@ -26,7 +26,10 @@ void main()
     vec3 tangent = normalize(v_tangent.xyz);
     vec3 bitangent = cross(normal.xyz, tangent) * v_tangent.w;
 
-    vec3 perturb = normalize(texture(normalMap, v_texCoord).xyz * 2.0 - 1.0);
+    // normal maps may be two channel (BC5), Z is rebuilt from XY
+    vec3 perturb;
+    perturb.xy = texture(normalMap, v_texCoord).xy * 2.0 - 1.0;
+    perturb.z = sqrt(max(1.0 - dot(perturb.xy, perturb.xy), 0.0));
     // TODO remove this normalize?
     vec3 n = normalize(normal * perturb.z + tangent * perturb.x + bitangent * perturb.y);
 
@@ -1,35 +1,50 @@
 #version 460
 
 #extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int16 : require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec4 tangent;
-layout(location = 3) in vec2 texCoord;
+#include "scene.glsl"
+
+// vertices are pulled from the streams of the instance's record, so plain and compressed meshes share one pipeline
+// draws pass the record as firstInstance and no vertex buffers
 
 layout(location = 0) out vec3 positionOut;
 layout(location = 1) out vec3 normalOut;
 layout(location = 2) out vec4 tangentOut;
 layout(location = 3) out vec2 texCoordOut;
 
-layout(set = 0, binding = 0, std140) uniform Uniforms 
+layout(set = 0, binding = 0, std140) uniform Uniforms
 {
-    mat4 model;
     mat4 view;
     mat4 proj;
 };
 
-void main() 
+layout(push_constant) uniform DrawParams
+{
+    uint64_t instanceTable;
+} pc;
+
+void main()
 {
-    vec4 worldPos = model * vec4(position, 1.0);
+    // the record's transform includes the mesh's positionTransform, quantized positions are decoded by it
+    InstanceRecord inst = InstanceTable(pc.instanceTable).instances[gl_InstanceIndex];
+    uint v = gl_VertexIndex;
+
+    vec4 worldPos = inst.transform * vec4(fetchPosition(inst, v), 1.0);
     gl_Position = proj * view * worldPos;
 
     positionOut = worldPos.xyz;
 
-    mat3 normalMat = transpose(inverse(mat3(model)));
-    normalOut = normalMat * normal;
+    // the positionTransform's scale is uniform, the fragment shader renormalizes
+    mat3 normalMat = transpose(inverse(mat3(inst.transform)));
+    normalOut = normalMat * fetchNormal(inst, v);
+    vec4 tangent = fetchTangent(inst, v);
     tangentOut.xyz = normalMat * tangent.xyz;
     tangentOut.w = tangent.w;
 
-    texCoordOut = texCoord;
-}
\ No newline at end of file
+    texCoordOut = fetchTexCoord(inst, v);
+}
@@ -0,0 +1,89 @@
+// scene instance table, see InstanceRecord in scene.h
+// include after enabling GL_EXT_buffer_reference, GL_EXT_scalar_block_layout and GL_EXT_shader_explicit_arithmetic_types_int16/int64
+
+layout(buffer_reference, scalar) readonly buffer Indices16 { uint16_t i[]; };
+layout(buffer_reference, scalar) readonly buffer Indices32 { uint i[]; };
+layout(buffer_reference, scalar) readonly buffer Positions { vec3 p[]; };
+layout(buffer_reference, scalar) readonly buffer Normals { vec3 n[]; };
+layout(buffer_reference, scalar) readonly buffer Tangents { vec4 t[]; };
+layout(buffer_reference, scalar) readonly buffer TexCoords { vec2 uv[]; };
+// compressed streams, see Mesh::vertexFormat in scene.h
+layout(buffer_reference, scalar) readonly buffer Words { uint w[]; };
+
+const uint QUANTIZED_POSITIONS = 1u;
+const uint PACKED_ATTRIBUTES = 2u;
+
+struct InstanceRecord
+{
+    mat4 transform;
+    uint64_t indexAddress;
+    uint64_t positionAddress;
+    uint64_t normalAddress;
+    uint64_t tangentAddress;
+    uint64_t texCoordAddress;
+    uint indexType;
+    uint materialIdx;
+    uint vertexFormat;
+    vec4 texCoordTransform;
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceTable { InstanceRecord instances[]; };
+
+uvec3 fetchTriangle(InstanceRecord inst, uint primIdx)
+{
+    if (inst.indexType == 0u)
+    {
+        Indices16 idx = Indices16(inst.indexAddress);
+        return uvec3(idx.i[3u * primIdx], idx.i[3u * primIdx + 1u], idx.i[3u * primIdx + 2u]);
+    }
+    Indices32 idx = Indices32(inst.indexAddress);
+    return uvec3(idx.i[3u * primIdx], idx.i[3u * primIdx + 1u], idx.i[3u * primIdx + 2u]);
+}
+
+// quantized positions are left in [-1, 1], the record's transform includes the mesh's positionTransform
+vec3 fetchPosition(InstanceRecord inst, uint v)
+{
+    if ((inst.vertexFormat & QUANTIZED_POSITIONS) != 0u)
+    {
+        Words p = Words(inst.positionAddress);
+        return vec3(unpackSnorm2x16(p.w[2u * v]), unpackSnorm2x16(p.w[2u * v + 1u]).x);
+    }
+    return Positions(inst.positionAddress).p[v];
+}
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// packed attributes are three words per vertex, the tangent and uv are read 4 and 8 bytes past normalAddress
+vec3 fetchNormal(InstanceRecord inst, uint v)
+{
+    if ((inst.vertexFormat & PACKED_ATTRIBUTES) != 0u)
+        return octDecode(unpackSnorm2x16(Words(inst.normalAddress).w[3u * v]));
+    return Normals(inst.normalAddress).n[v];
+}
+
+vec4 fetchTangent(InstanceRecord inst, uint v)
+{
+    if ((inst.vertexFormat & PACKED_ATTRIBUTES) != 0u)
+    {
+        uint t = Words(inst.tangentAddress).w[3u * v];
+        return vec4(octDecode(unpackSnorm2x16(t)), (t & 0x10000u) != 0u ? -1.0 : 1.0);
+    }
+    return Tangents(inst.tangentAddress).t[v];
+}
+
+vec2 fetchTexCoord(InstanceRecord inst, uint v)
+{
+    if ((inst.vertexFormat & PACKED_ATTRIBUTES) != 0u)
+    {
+        // unorm16 over the mesh's uv bounds
+        vec2 uv = unpackUnorm2x16(Words(inst.texCoordAddress).w[3u * v]);
+        return inst.texCoordTransform.xy + inst.texCoordTransform.zw * uv;
+    }
+    return TexCoords(inst.texCoordAddress).uv[v];
+}
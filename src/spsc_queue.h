@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// bounded lock-free queue between exactly one producer and one consumer thread
+// capacity is rounded up to a power of two, push fails rather than blocks when the queue is full
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity)
+    {
+        while (m_capacity < capacity)
+            m_capacity *= 2u;
+        m_slots = std::make_unique<T[]>(m_capacity);
+    }
+    SpscQueue(const SpscQueue&) = delete;
+
+    // producer only
+    bool tryPush(T&& value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_capacity)
+            return false;
+
+        m_slots[tail & (m_capacity - 1u)] = std::move(value);
+        m_tail.store(tail + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, the popped slot is reset so it doesn't keep resources alive
+    bool tryPop(T& value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        T& slot = m_slots[head & (m_capacity - 1u)];
+        value = std::move(slot);
+        slot = T();
+        m_head.store(head + 1u, std::memory_order_release);
+        return true;
+    }
+
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+private:
+    size_t m_capacity = 1u;
+    std::unique_ptr<T[]> m_slots;
+    // kept on separate cache lines so producer and consumer don't contend on them
+    alignas(64) std::atomic<size_t> m_head{ 0u };
+    alignas(64) std::atomic<size_t> m_tail{ 0u };
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads draining a FIFO of jobs
+// jobs still queued on destruction are dropped (their futures report broken_promise), running ones are joined
+class ThreadPool
+{
+public:
+    ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    template <typename F>
+    std::future<decltype(std::declval<F>()())> submit(F job)
+    {
+        using Result = decltype(job());
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push([task]() { (*task)(); });
+        }
+        m_jobAvailable.notify_one();
+        return result;
+    }
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    bool m_stopping = false;
+
+    void workerLoop();
+};
@@ -2,6 +2,10 @@
 
 #include <spirv_cross/spirv_glsl.hpp>
 #include <fstream>
+#include <mutex>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
@@ -9,6 +13,128 @@
 namespace vk
 {
 
+bool CallRecorder::s_enabled = false;
+bool CallRecorder::s_null = false;
+
+struct CallStats
+{
+    uint64_t count = 0u;
+    std::chrono::nanoseconds elapsed{ 0 };
+};
+
+// calls can come from loader threads
+static std::mutex s_callStatsMutex;
+static std::map<std::string, CallStats> s_callStats;
+
+void CallRecorder::record(const char* name, std::chrono::nanoseconds elapsed)
+{
+    std::lock_guard<std::mutex> lock(s_callStatsMutex);
+    CallStats& stats = s_callStats[name];
+    stats.count++;
+    stats.elapsed += elapsed;
+}
+
+void CallRecorder::report(const std::string& title)
+{
+    std::lock_guard<std::mutex> lock(s_callStatsMutex);
+    std::vector<std::pair<std::string, CallStats>> sorted(s_callStats.begin(), s_callStats.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, CallStats>& a, const std::pair<std::string, CallStats>& b) { return a.second.elapsed > b.second.elapsed; });
+
+    uint64_t totalCount = 0u;
+    std::chrono::nanoseconds totalElapsed{ 0 };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "Vulkan calls (" << title << (s_null ? ", null" : "") << "):\n";
+    for (const std::pair<std::string, CallStats>& entry : sorted)
+    {
+        double ms = std::chrono::duration<double, std::milli>(entry.second.elapsed).count();
+        out << "  " << std::left << std::setw(48) << entry.first << std::right << std::setw(10) << entry.second.count << std::setw(12) << ms << " ms" << std::setw(12) << ms * 1000.0 / entry.second.count << " us/call\n";
+        totalCount += entry.second.count;
+        totalElapsed += entry.second.elapsed;
+    }
+    out << "  " << std::left << std::setw(48) << "total" << std::right << std::setw(10) << totalCount << std::setw(12) << std::chrono::duration<double, std::milli>(totalElapsed).count() << " ms";
+    LOG(out.str());
+
+    s_callStats.clear();
+}
+
+void CallRecorder::reset()
+{
+    std::lock_guard<std::mutex> lock(s_callStatsMutex);
+    s_callStats.clear();
+}
+
+VkDeviceSize getFormatBlockSize(VkFormat format, uint32_t* blockDim)
+{
+    uint32_t dim = 1u;
+    VkDeviceSize size = 0u;
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM:
+        size = 1u;
+        break;
+    case VK_FORMAT_R8G8_UNORM:
+        size = 2u;
+        break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_R32_SFLOAT:
+        size = 4u;
+        break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        size = 8u;
+        break;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        size = 16u;
+        break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        dim = 4u;
+        size = 8u;
+        break;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        dim = 4u;
+        size = 16u;
+        break;
+    default:
+        break;
+    }
+
+    if (blockDim)
+        *blockDim = dim;
+    return size;
+}
+
+VkDeviceSize getImageSize(VkFormat format, VkExtent3D extent, uint32_t levelCount)
+{
+    uint32_t blockDim;
+    VkDeviceSize blockSize = getFormatBlockSize(format, &blockDim);
+
+    // partial blocks at the edges take a whole block
+    VkDeviceSize size = 0u;
+    for (uint32_t level = 0u; level < levelCount; level++)
+    {
+        size += blockSize * ((extent.width + blockDim - 1u) / blockDim) * ((extent.height + blockDim - 1u) / blockDim) * extent.depth;
+        extent = { std::max(extent.width >> 1, 1u), std::max(extent.height >> 1, 1u), std::max(extent.depth >> 1, 1u) };
+    }
+    return size;
+}
+
 Instance::Instance()
 {
     m_appInfo.apiVersion = VK_API_VERSION_1_3;
@@ -29,9 +155,9 @@ bool Instance::create()
     if (!m_enabledLayers.empty())
     {
         uint32_t availableLayerCount;
-        vkEnumerateInstanceLayerProperties(&availableLayerCount, nullptr);
+        VK_CALL(vkEnumerateInstanceLayerProperties, &availableLayerCount, nullptr);
         std::vector<VkLayerProperties> availableLayerProps(availableLayerCount);
-        vkEnumerateInstanceLayerProperties(&availableLayerCount, availableLayerProps.data());
+        VK_CALL(vkEnumerateInstanceLayerProperties, &availableLayerCount, availableLayerProps.data());
 
         // check all requested layers are available
         for (const char* layer : m_enabledLayers)
@@ -58,9 +184,9 @@ bool Instance::create()
     if (!m_enabledExtensions.empty())
     {
         uint32_t availableExtensionCount;
-        vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, nullptr);
+        VK_CALL(vkEnumerateInstanceExtensionProperties, nullptr, &availableExtensionCount, nullptr);
         std::vector<VkExtensionProperties> availableExtensionProps(availableExtensionCount);
-        vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, availableExtensionProps.data());
+        VK_CALL(vkEnumerateInstanceExtensionProperties, nullptr, &availableExtensionCount, availableExtensionProps.data());
 
         // check all requested extensions are available
         for (const char* ext : m_enabledExtensions)
@@ -85,7 +211,7 @@ bool Instance::create()
         m_createInfo.ppEnabledExtensionNames = m_enabledExtensions.data();
     }
 
-    VkResult res = vkCreateInstance(&m_createInfo, nullptr, &m_handle);
+    VkResult res = VK_CALL(vkCreateInstance, &m_createInfo, nullptr, &m_handle);
     return res == VK_SUCCESS;
 }
 
@@ -100,53 +226,254 @@ Device::~Device()
         destroy();
 }
 
-bool Device::create()
+// size of the feature structs whose support can be checked before device creation
+// all of these consist of VkBool32 members following sType/pNext
+static size_t getFeatureStructSize(VkStructureType sType)
 {
-    if (m_handle != VK_NULL_HANDLE)
-        return false;
+    switch (sType)
+    {
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES:
+        return sizeof(VkPhysicalDeviceVulkan11Features);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES:
+        return sizeof(VkPhysicalDeviceVulkan12Features);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES:
+        return sizeof(VkPhysicalDeviceVulkan13Features);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES:
+        return sizeof(VkPhysicalDeviceSynchronization2Features);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES:
+        return sizeof(VkPhysicalDeviceDynamicRenderingFeatures);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES:
+        return sizeof(VkPhysicalDeviceBufferDeviceAddressFeatures);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR:
+        return sizeof(VkPhysicalDeviceAccelerationStructureFeaturesKHR);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR:
+        return sizeof(VkPhysicalDeviceRayTracingPipelineFeaturesKHR);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR:
+        return sizeof(VkPhysicalDeviceRayQueryFeaturesKHR);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_POSITION_FETCH_FEATURES_KHR:
+        return sizeof(VkPhysicalDeviceRayTracingPositionFetchFeaturesKHR);
+    case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT:
+        return sizeof(VkPhysicalDeviceHostImageCopyFeaturesEXT);
+    default:
+        return 0u;
+    }
+}
 
-    uint32_t physicalDeviceCount;
-    vkEnumeratePhysicalDevices(*m_instance, &physicalDeviceCount, nullptr);
-    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
-    vkEnumeratePhysicalDevices(*m_instance, &physicalDeviceCount, physicalDevices.data());
+static bool checkFeatureBools(const VkBool32* requested, const VkBool32* supported, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (requested[i] == VK_TRUE && supported[i] != VK_TRUE)
+            return false;
+    }
+    return true;
+}
 
-    // choose physical device
-    for (VkPhysicalDevice pd : physicalDevices)
+bool Device::supportsFeatures(VkPhysicalDevice pd, const void* featuresChain, const VkPhysicalDeviceFeatures* coreFeatures) const
+{
+    // mirror the feature chain with zeroed structs of the same types and query support
+    std::vector<std::vector<uint8_t>> queried;
+    std::vector<const VkBaseInStructure*> requested;
+    VkPhysicalDeviceFeatures2 supported{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    VkBaseOutStructure* tail = reinterpret_cast<VkBaseOutStructure*>(&supported);
+    for (const VkBaseInStructure* in = reinterpret_cast<const VkBaseInStructure*>(featuresChain); in; in = in->pNext)
     {
-        VkPhysicalDeviceProperties props;
-        vkGetPhysicalDeviceProperties(pd, &props);
-        if (props.deviceType != m_physicalDeviceType)
+        size_t size = getFeatureStructSize(in->sType);
+        if (size == 0u)
+        {
+            LOGW("Cannot check support for device feature struct with sType " + std::to_string(in->sType) + ".");
             continue;
+        }
 
-        uint32_t supportedExtensionsCount;
-        vkEnumerateDeviceExtensionProperties(pd, nullptr, &supportedExtensionsCount, nullptr);
-        std::vector<VkExtensionProperties> supportedExtensions(supportedExtensionsCount);
-        vkEnumerateDeviceExtensionProperties(pd, nullptr, &supportedExtensionsCount, supportedExtensions.data());
+        queried.emplace_back(size, 0u);
+        VkBaseOutStructure* out = reinterpret_cast<VkBaseOutStructure*>(queried.back().data());
+        out->sType = in->sType;
+        tail->pNext = out;
+        tail = out;
+        requested.push_back(in);
+    }
+    VK_CALL(vkGetPhysicalDeviceFeatures2, pd, &supported);
 
-        bool allSupported = true;
-        for (const char* ext : m_enabledExtensions)
+    const size_t coreCount = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32);
+    if (coreFeatures && !checkFeatureBools(reinterpret_cast<const VkBool32*>(coreFeatures), reinterpret_cast<const VkBool32*>(&supported.features), coreCount))
+        return false;
+
+    for (size_t i = 0; i < requested.size(); i++)
+    {
+        size_t count = (queried[i].size() - sizeof(VkBaseOutStructure)) / sizeof(VkBool32);
+        const VkBool32* req = reinterpret_cast<const VkBool32*>(reinterpret_cast<const uint8_t*>(requested[i]) + sizeof(VkBaseOutStructure));
+        const VkBool32* sup = reinterpret_cast<const VkBool32*>(queried[i].data() + sizeof(VkBaseOutStructure));
+        if (!checkFeatureBools(req, sup, count))
+            return false;
+    }
+    return true;
+}
+
+bool Device::supportsExtension(VkPhysicalDevice pd, const char* name) const
+{
+    uint32_t supportedExtensionsCount;
+    VK_CALL(vkEnumerateDeviceExtensionProperties, pd, nullptr, &supportedExtensionsCount, nullptr);
+    std::vector<VkExtensionProperties> supportedExtensions(supportedExtensionsCount);
+    VK_CALL(vkEnumerateDeviceExtensionProperties, pd, nullptr, &supportedExtensionsCount, supportedExtensions.data());
+
+    for (VkExtensionProperties& ep : supportedExtensions)
+    {
+        if (strcmp(name, ep.extensionName) == 0)
+            return true;
+    }
+    return false;
+}
+
+int64_t Device::scorePhysicalDevice(VkPhysicalDevice pd) const
+{
+    // returns -1 if the device cannot satisfy the requested extensions, features and queues
+    VkPhysicalDeviceProperties props;
+    VK_CALL(vkGetPhysicalDeviceProperties, pd, &props);
+    const std::string name(props.deviceName);
+
+    bool isSoftware = props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU || props.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU;
+    if (isSoftware && !m_allowSoftwareDevices && props.deviceType != m_physicalDeviceType)
+    {
+        LOGW("Skipping software physical device <" + name + ">.");
+        return -1;
+    }
+
+    for (const char* ext : m_enabledExtensions)
+    {
+        if (!supportsExtension(pd, ext))
         {
-            bool supported = false;
-            for (VkExtensionProperties& ep : supportedExtensions)
-            {
-                if (strcmp(ext, ep.extensionName) == 0)
-                {
-                    supported = true;
-                    break;
-                }
-            }
-            if (!supported)
+            LOGW("Requested device extension \'" + std::string(ext) + "\' not available on physical device <" + name + ">.");
+            return -1;
+        }
+    }
+
+    if (!supportsFeatures(pd, m_enabledFeatures.pNext, &m_enabledFeatures.features))
+    {
+        LOGW("Requested device features not available on physical device <" + name + ">.");
+        return -1;
+    }
+
+    uint32_t queueFamilyCount;
+    VK_CALL(vkGetPhysicalDeviceQueueFamilyProperties, pd, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilyProps(queueFamilyCount);
+    VK_CALL(vkGetPhysicalDeviceQueueFamilyProperties, pd, &queueFamilyCount, queueFamilyProps.data());
+
+    for (const QueueRequirements& qr : m_queueRequirements)
+    {
+        bool queueFound = false;
+        for (const VkQueueFamilyProperties& qfp : queueFamilyProps)
+        {
+            if ((qfp.queueFlags & qr.flags) == qr.flags && qfp.queueCount >= qr.count)
             {
-                LOGW("Requested device extension \'" + std::string(ext) + "\' not available on physical device <" + std::string(props.deviceName) + ">.\nTrying next physical device...");
-                allSupported = false;
+                queueFound = true;
                 break;
             }
         }
-        if (!allSupported)
-            continue;
+        if (!queueFound)
+        {
+            LOGW("Queue requirements not satisfied by physical device <" + name + ">.");
+            return -1;
+        }
+    }
 
-        m_physicalDevice = pd;
+    // device type dominates, then VRAM, then queue topology
+    int64_t typeRank;
+    switch (props.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        typeRank = 4;
         break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        typeRank = 3;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        typeRank = 2;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        typeRank = 1;
+        break;
+    default:
+        typeRank = 0;
+        break;
+    }
+    if (props.deviceType == m_physicalDeviceType)
+        typeRank = 5;
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    VK_CALL(vkGetPhysicalDeviceMemoryProperties, pd, &memProps);
+    int64_t deviceLocalMiB = 0;
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; i++)
+    {
+        if (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            deviceLocalMiB += static_cast<int64_t>(memProps.memoryHeaps[i].size >> 20);
+    }
+
+    // async compute and dedicated transfer (DMA) families let uploads and compute overlap with graphics
+    int64_t queueBonus = 0;
+    for (const VkQueueFamilyProperties& qfp : queueFamilyProps)
+    {
+        bool graphics = qfp.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = qfp.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        bool transfer = qfp.queueFlags & VK_QUEUE_TRANSFER_BIT;
+        if (!graphics && compute)
+            queueBonus += 512;
+        else if (!graphics && !compute && transfer)
+            queueBonus += 256;
+    }
+
+    int64_t score = typeRank * (int64_t(1) << 40) + deviceLocalMiB + queueBonus;
+    LOG("Physical device <" + name + "> scored " + std::to_string(score) + ".");
+    return score;
+}
+
+bool Device::create()
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    uint32_t physicalDeviceCount;
+    VK_CALL(vkEnumeratePhysicalDevices, *m_instance, &physicalDeviceCount, nullptr);
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    VK_CALL(vkEnumeratePhysicalDevices, *m_instance, &physicalDeviceCount, physicalDevices.data());
+
+    // normalize requested UUID so it can be compared against the hex formatted device UUID
+    std::string requestedUUID;
+    for (char c : m_physicalDeviceUUID)
+    {
+        if (c != '-')
+            requestedUUID.push_back(static_cast<char>(tolower(c)));
+    }
+
+    // choose physical device with the highest score
+    int64_t bestScore = -1;
+    for (uint32_t i = 0; i < physicalDeviceCount; i++)
+    {
+        VkPhysicalDevice pd = physicalDevices[i];
+        VkPhysicalDeviceIDProperties IDProps{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+        VkPhysicalDeviceProperties2 props{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        props.pNext = &IDProps;
+        VK_CALL(vkGetPhysicalDeviceProperties2, pd, &props);
+
+        std::string UUID;
+        for (uint32_t b = 0; b < VK_UUID_SIZE; b++)
+        {
+            const char* hex = "0123456789abcdef";
+            UUID.push_back(hex[IDProps.deviceUUID[b] >> 4]);
+            UUID.push_back(hex[IDProps.deviceUUID[b] & 0xF]);
+        }
+        LOG("Physical device " + std::to_string(i) + ": <" + std::string(props.properties.deviceName) + "> UUID " + UUID);
+
+        if (m_physicalDeviceIndex >= 0 && static_cast<uint32_t>(m_physicalDeviceIndex) != i)
+            continue;
+        if (!requestedUUID.empty() && requestedUUID != UUID)
+            continue;
+
+        int64_t score = scorePhysicalDevice(pd);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            m_physicalDevice = pd;
+        }
     }
 
     if (m_physicalDevice == VK_NULL_HANDLE)
@@ -155,11 +482,45 @@ bool Device::create()
         return false;
     }
 
+    VkPhysicalDeviceProperties selectedProps;
+    VK_CALL(vkGetPhysicalDeviceProperties, m_physicalDevice, &selectedProps);
+    LOG("Selected physical device <" + std::string(selectedProps.deviceName) + ">.");
+
+    // enable the optional core features the selected device supports
+    VkPhysicalDeviceFeatures supportedFeatures;
+    VK_CALL(vkGetPhysicalDeviceFeatures, m_physicalDevice, &supportedFeatures);
+    const VkBool32* optional = reinterpret_cast<const VkBool32*>(&m_optionalFeatures);
+    const VkBool32* supported = reinterpret_cast<const VkBool32*>(&supportedFeatures);
+    VkBool32* enabled = reinterpret_cast<VkBool32*>(&m_enabledFeatures.features);
+    for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++)
+    {
+        if (optional[i] == VK_TRUE && supported[i] == VK_TRUE)
+            enabled[i] = VK_TRUE;
+    }
+
+    // enable optional extensions supported by the selected device, linking their features into the enabled chain
+    for (const OptionalExtension& oe : m_optionalExtensions)
+    {
+        if (!supportsExtension(m_physicalDevice, oe.name) || (oe.features && !supportsFeatures(m_physicalDevice, oe.features, nullptr)))
+        {
+            LOGW("Optional device extension \'" + std::string(oe.name) + "\' not available.");
+            continue;
+        }
+
+        m_enabledExtensions.push_back(oe.name);
+        if (oe.features)
+        {
+            VkBaseOutStructure* features = reinterpret_cast<VkBaseOutStructure*>(oe.features);
+            features->pNext = reinterpret_cast<VkBaseOutStructure*>(m_enabledFeatures.pNext);
+            m_enabledFeatures.pNext = features;
+        }
+    }
+
     // setup queue create infos
     uint32_t queueFamilyCount;
-    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+    VK_CALL(vkGetPhysicalDeviceQueueFamilyProperties, m_physicalDevice, &queueFamilyCount, nullptr);
     std::vector<VkQueueFamilyProperties> queueFamilyProps(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilyProps.data());
+    VK_CALL(vkGetPhysicalDeviceQueueFamilyProperties, m_physicalDevice, &queueFamilyCount, queueFamilyProps.data());
 
     std::vector<VkDeviceQueueCreateInfo> queueInfos;
     uint32_t maxCount = 0u;
@@ -172,7 +533,7 @@ bool Device::create()
         bool queueFound = false;
         for (uint32_t i = 0; i < queueFamilyProps.size(); i++)
         {
-            if ((queueFamilyProps[i].queueFlags & qr.flags) == qr.flags)
+            if ((queueFamilyProps[i].queueFlags & qr.flags) == qr.flags && queueFamilyProps[i].queueCount >= qr.count)
             {
                 VkDeviceQueueCreateInfo qi{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
                 qi.queueFamilyIndex = i;
@@ -204,15 +565,25 @@ bool Device::create()
         m_createInfo.ppEnabledExtensionNames = m_enabledExtensions.data();
     }
 
-    VkResult res = vkCreateDevice(m_physicalDevice, &m_createInfo, nullptr, &m_handle);
-    return res == VK_SUCCESS;
+    VkResult res = VK_CALL(vkCreateDevice, m_physicalDevice, &m_createInfo, nullptr, &m_handle);
+    if (res != VK_SUCCESS)
+        return false;
+
+    if (isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME))
+    {
+        m_vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(m_handle, "vkCreateRayTracingPipelinesKHR"));
+        m_vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(m_handle, "vkGetRayTracingShaderGroupHandlesKHR"));
+        m_vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(m_handle, "vkCmdTraceRaysKHR"));
+    }
+
+    return true;
 }
 
 VkQueue Device::getQueue(VkQueueFlags flags, uint32_t idx) const
 {
     VkQueue queue;
     uint32_t qf = m_queueFlagsToQueueFamily.at(flags);
-    vkGetDeviceQueue(m_handle, qf, idx, &queue);
+    VK_CALL(vkGetDeviceQueue, m_handle, qf, idx, &queue);
     return queue;
 }
 
@@ -227,16 +598,51 @@ bool Device::submitToQueue(VkQueue queue, VkCommandBuffer cmdBuf, VkSemaphore wa
     submitInfo.signalSemaphoreCount = 1u;
     submitInfo.pSignalSemaphores = &signalSemaphore;
 
-    VkResult res = vkQueueSubmit(queue, 1u, &submitInfo, fence);
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    VkResult res = VK_CALL(vkQueueSubmit, queue, 1u, &submitInfo, fence);
+    return res == VK_SUCCESS;
+}
+
+bool Device::submitAndWait(VkQueue queue, VkCommandBuffer cmdBuf) const
+{
+    VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence;
+    VkResult res = VK_CALL(vkCreateFence, m_handle, &fenceInfo, nullptr, &fence);
+    if (res != VK_SUCCESS)
+        return false;
+
+    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submitInfo.commandBufferCount = 1u;
+    submitInfo.pCommandBuffers = &cmdBuf;
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        res = VK_CALL(vkQueueSubmit, queue, 1u, &submitInfo, fence);
+    }
+    if (res == VK_SUCCESS)
+        res = VK_CALL(vkWaitForFences, m_handle, 1u, &fence, VK_TRUE, UINT64_MAX);
+
+    VK_CALL(vkDestroyFence, m_handle, fence, nullptr);
     return res == VK_SUCCESS;
 }
 
 bool Device::waitIdle() const
 {
-    VkResult res = vkDeviceWaitIdle(m_handle);
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    VkResult res = VK_CALL(vkDeviceWaitIdle, m_handle);
     return res == VK_SUCCESS;
 }
 
+bool Device::isExtensionEnabled(const char* name) const
+{
+    for (const char* ext : m_enabledExtensions)
+    {
+        if (strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
 Swapchain::Swapchain(Device* device) : m_device(device)
 {
     m_createInfo.imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
@@ -265,34 +671,34 @@ bool Swapchain::create(GLFWwindow* window, VkImageUsageFlags usage)
         return false;
 
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_device->m_physicalDevice, m_surface, &surfaceCapabilities);
+    VK_CALL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, m_device->m_physicalDevice, m_surface, &surfaceCapabilities);
 
     m_createInfo.surface = m_surface;
     m_createInfo.minImageCount = surfaceCapabilities.minImageCount + 1u;
     m_createInfo.imageExtent = surfaceCapabilities.currentExtent;
     m_createInfo.imageUsage = usage;
 
-    res = vkCreateSwapchainKHR(*m_device, &m_createInfo, nullptr, &m_handle);
+    res = VK_CALL(vkCreateSwapchainKHR, *m_device, &m_createInfo, nullptr, &m_handle);
     if (res != VK_SUCCESS)
         return false;
 
     uint32_t imagesCount;
-    vkGetSwapchainImagesKHR(*m_device, m_handle, &imagesCount, nullptr);
+    VK_CALL(vkGetSwapchainImagesKHR, *m_device, m_handle, &imagesCount, nullptr);
     m_images.resize(imagesCount);
-    vkGetSwapchainImagesKHR(*m_device, m_handle, &imagesCount, m_images.data());
+    VK_CALL(vkGetSwapchainImagesKHR, *m_device, m_handle, &imagesCount, m_images.data());
 
     return true;
 }
 
 void Swapchain::destroy()
 {
-    vkDestroySwapchainKHR(*m_device, m_handle, nullptr);
-    vkDestroySurfaceKHR(*m_device->m_instance, m_surface, nullptr);
+    VK_CALL(vkDestroySwapchainKHR, *m_device, m_handle, nullptr);
+    VK_CALL(vkDestroySurfaceKHR, *m_device->m_instance, m_surface, nullptr);
 }
 
 bool Swapchain::acquireNextImage(uint32_t* idx, VkSemaphore acquiredSemaphore) const
 {
-    VkResult res = vkAcquireNextImageKHR(*m_device, m_handle, UINT64_MAX, acquiredSemaphore, VK_NULL_HANDLE, idx);
+    VkResult res = VK_CALL(vkAcquireNextImageKHR, *m_device, m_handle, UINT64_MAX, acquiredSemaphore, VK_NULL_HANDLE, idx);
     return res == VK_SUCCESS;
 }
 
@@ -305,7 +711,8 @@ bool Swapchain::present(VkQueue queue, uint32_t idx, VkSemaphore waitSemaphore)
     presentInfo.pSwapchains = &m_handle;
     presentInfo.pImageIndices = &idx;
 
-    VkResult res = vkQueuePresentKHR(queue, &presentInfo);
+    std::lock_guard<std::mutex> lock(m_device->m_queueMutex);
+    VkResult res = VK_CALL(vkQueuePresentKHR, queue, &presentInfo);
     return res == VK_SUCCESS;
 }
 
@@ -344,12 +751,97 @@ bool Buffer::create(VkDeviceSize size, VkBufferUsageFlags bufferUsage, VmaMemory
     return res == VK_SUCCESS;
 }
 
+bool Buffer::importHostMemory(const void* hostPtr, VkDeviceSize size, VkBufferUsageFlags bufferUsage)
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    VmaAllocatorInfo allocatorInfo;
+    vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+    static PFN_vkGetMemoryHostPointerPropertiesEXT vkGetMemoryHostPointerPropertiesEXT = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(allocatorInfo.device, "vkGetMemoryHostPointerPropertiesEXT"));
+
+    VkMemoryHostPointerPropertiesEXT hostPointerProps{ VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT };
+    VkResult res = VK_CALL(vkGetMemoryHostPointerPropertiesEXT, allocatorInfo.device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, hostPtr, &hostPointerProps);
+    if (res != VK_SUCCESS)
+        return false;
+
+    VkExternalMemoryBufferCreateInfo externalInfo{ VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO };
+    externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    m_createInfo.pNext = &externalInfo;
+    m_createInfo.size = size;
+    m_createInfo.usage = bufferUsage;
+    res = VK_CALL(vkCreateBuffer, allocatorInfo.device, &m_createInfo, nullptr, &m_handle);
+    m_createInfo.pNext = nullptr;
+    if (res != VK_SUCCESS)
+        return false;
+
+    VkMemoryRequirements memReqs;
+    VK_CALL(vkGetBufferMemoryRequirements, allocatorInfo.device, m_handle, &memReqs);
+    uint32_t memoryTypeBits = memReqs.memoryTypeBits & hostPointerProps.memoryTypeBits;
+    uint32_t memoryTypeIdx = 0u;
+    while (memoryTypeIdx < 32u && !(memoryTypeBits & (1u << memoryTypeIdx)))
+        memoryTypeIdx++;
+    if (memoryTypeIdx == 32u)
+    {
+        LOGW("No memory type can import the host pointer.");
+        destroy();
+        return false;
+    }
+
+    VkImportMemoryHostPointerInfoEXT importInfo{ VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT };
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importInfo.pHostPointer = const_cast<void*>(hostPtr);
+    VkMemoryAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    allocInfo.pNext = &importInfo;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIdx;
+    res = VK_CALL(vkAllocateMemory, allocatorInfo.device, &allocInfo, nullptr, &m_importedMemory);
+    if (res == VK_SUCCESS)
+        res = VK_CALL(vkBindBufferMemory, allocatorInfo.device, m_handle, m_importedMemory, 0u);
+    if (res != VK_SUCCESS)
+    {
+        destroy();
+        return false;
+    }
+
+    return true;
+}
+
+void Buffer::destroy()
+{
+    if (m_allocation)
+    {
+        vmaDestroyBuffer(m_allocator, m_handle, m_allocation);
+    }
+    else
+    {
+        VmaAllocatorInfo allocatorInfo;
+        vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+        VK_CALL(vkDestroyBuffer, allocatorInfo.device, m_handle, nullptr);
+        if (m_importedMemory != VK_NULL_HANDLE)
+            VK_CALL(vkFreeMemory, allocatorInfo.device, m_importedMemory, nullptr);
+    }
+    m_handle = VK_NULL_HANDLE;
+    m_allocation = nullptr;
+    m_importedMemory = VK_NULL_HANDLE;
+}
+
 bool Buffer::map(void** data) const
 {
     VkResult res = vmaMapMemory(m_allocator, m_allocation, data);
     return res == VK_SUCCESS;
 }
 
+VkDeviceAddress Buffer::getDeviceAddress() const
+{
+    VmaAllocatorInfo allocatorInfo;
+    vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+
+    VkBufferDeviceAddressInfo addrInfo{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO };
+    addrInfo.buffer = m_handle;
+    return VK_CALL(vkGetBufferDeviceAddress, allocatorInfo.device, &addrInfo);
+}
+
 Image::Image(VmaAllocator allocator) : m_allocator(allocator)
 {
     m_createInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -392,6 +884,55 @@ bool Image::map(void** data) const
     return res == VK_SUCCESS;
 }
 
+bool Image::copyFromHost(const void* data, VkImageAspectFlags aspectMask, VkImageLayout dstLayout, uint32_t levelCount)
+{
+    VmaAllocatorInfo allocatorInfo;
+    vmaGetAllocatorInfo(m_allocator, &allocatorInfo);
+
+    static PFN_vkTransitionImageLayoutEXT vkTransitionImageLayoutEXT = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(allocatorInfo.device, "vkTransitionImageLayoutEXT"));
+    static PFN_vkCopyMemoryToImageEXT vkCopyMemoryToImageEXT = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(allocatorInfo.device, "vkCopyMemoryToImageEXT"));
+
+    VkImageSubresourceRange subRange{};
+    subRange.aspectMask = aspectMask;
+    subRange.baseMipLevel = 0u;
+    subRange.levelCount = m_createInfo.mipLevels;
+    subRange.baseArrayLayer = 0u;
+    subRange.layerCount = m_createInfo.arrayLayers;
+
+    VkHostImageLayoutTransitionInfoEXT transitionInfo{ VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT };
+    transitionInfo.image = m_handle;
+    transitionInfo.oldLayout = m_layout;
+    transitionInfo.newLayout = dstLayout;
+    transitionInfo.subresourceRange = subRange;
+
+    VkResult res = VK_CALL(vkTransitionImageLayoutEXT, allocatorInfo.device, 1u, &transitionInfo);
+    if (res != VK_SUCCESS)
+        return false;
+    m_layout = dstLayout;
+
+    std::vector<VkMemoryToImageCopyEXT> regions(levelCount, { VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT });
+    const unsigned char* levelData = static_cast<const unsigned char*>(data);
+    for (uint32_t level = 0u; level < levelCount; level++)
+    {
+        regions[level].pHostPointer = levelData;
+        regions[level].imageSubresource.aspectMask = aspectMask;
+        regions[level].imageSubresource.mipLevel = level;
+        regions[level].imageSubresource.baseArrayLayer = 0u;
+        regions[level].imageSubresource.layerCount = m_createInfo.arrayLayers;
+        regions[level].imageExtent = getMipExtent(level);
+        levelData += getMipSize(level);
+    }
+
+    VkCopyMemoryToImageInfoEXT copyInfo{ VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT };
+    copyInfo.dstImage = m_handle;
+    copyInfo.dstImageLayout = dstLayout;
+    copyInfo.regionCount = levelCount;
+    copyInfo.pRegions = regions.data();
+
+    res = VK_CALL(vkCopyMemoryToImageEXT, allocatorInfo.device, &copyInfo);
+    return res == VK_SUCCESS;
+}
+
 
 ImageView::ImageView(Device* device, Image& img) : m_device(device), m_img(img)
 {
@@ -419,7 +960,7 @@ bool ImageView::create(VkImageAspectFlags aspectMask)
         return false;
 
     m_createInfo.subresourceRange.aspectMask = aspectMask;
-    VkResult res = vkCreateImageView(*m_device, &m_createInfo, nullptr, &m_handle);
+    VkResult res = VK_CALL(vkCreateImageView, *m_device, &m_createInfo, nullptr, &m_handle);
     return res == VK_SUCCESS;
 }
 
@@ -451,7 +992,7 @@ bool Shader::create(const std::string& spirvFilepath, VkShaderStageFlagBits stag
     VkShaderModuleCreateInfo moduleInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
     moduleInfo.codeSize = m_code.size() * 4u;
     moduleInfo.pCode = m_code.data();
-    VkResult res = vkCreateShaderModule(*m_device, &moduleInfo, nullptr, &m_module);
+    VkResult res = VK_CALL(vkCreateShaderModule, *m_device, &moduleInfo, nullptr, &m_module);
     if (res != VK_SUCCESS)
         return false;
 
@@ -476,7 +1017,18 @@ bool PipelineLayout::create(const std::unordered_set<Shader*>& shaders)
 
     // create push descriptor set layout
     // implicity set 0
-    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    // bindings are keyed by binding number so resources shared between stages are merged
+    std::map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+    // push constant blocks of all stages share one range, as large as the largest of them
+    VkPushConstantRange pushConstantRange{};
+    auto addBinding = [&bindings](const VkDescriptorSetLayoutBinding& b)
+    {
+        auto it = bindings.find(b.binding);
+        if (it != bindings.end())
+            it->second.stageFlags |= b.stageFlags;
+        else
+            bindings[b.binding] = b;
+    };
     for (const Shader* sh : shaders)
     {
         spirv_cross::CompilerGLSL comp(sh->m_code.data(), sh->m_code.size());
@@ -494,7 +1046,7 @@ bool PipelineLayout::create(const std::unordered_set<Shader*>& shaders)
             uniformBinding.stageFlags = sh->m_shaderStageInfo.stage;
             uniformBinding.binding = comp.get_decoration(u.id, spv::DecorationBinding);
 
-            bindings.push_back(uniformBinding);
+            addBinding(uniformBinding);
         }
 
         for (auto& img : resources.sampled_images)
@@ -510,7 +1062,7 @@ bool PipelineLayout::create(const std::unordered_set<Shader*>& shaders)
             imgBinding.stageFlags = sh->m_shaderStageInfo.stage;
             imgBinding.binding = comp.get_decoration(img.id, spv::DecorationBinding);
 
-            bindings.push_back(imgBinding);
+            addBinding(imgBinding);
         }
 
         for (auto& img : resources.storage_images)
@@ -526,7 +1078,7 @@ bool PipelineLayout::create(const std::unordered_set<Shader*>& shaders)
             imgBinding.stageFlags = sh->m_shaderStageInfo.stage;
             imgBinding.binding = comp.get_decoration(img.id, spv::DecorationBinding);
 
-            bindings.push_back(imgBinding);
+            addBinding(imgBinding);
         }
 
         for (auto& as : resources.acceleration_structures)
@@ -542,32 +1094,48 @@ bool PipelineLayout::create(const std::unordered_set<Shader*>& shaders)
             asBinding.stageFlags = sh->m_shaderStageInfo.stage;
             asBinding.binding = comp.get_decoration(as.id, spv::DecorationBinding);
 
-            bindings.push_back(asBinding);
+            addBinding(asBinding);
+        }
+
+        for (auto& pc : resources.push_constant_buffers)
+        {
+            size_t size = comp.get_declared_struct_size(comp.get_type(pc.base_type_id));
+            pushConstantRange.size = std::max(pushConstantRange.size, static_cast<uint32_t>(size));
+            pushConstantRange.stageFlags |= sh->m_shaderStageInfo.stage;
         }
     }
 
+    std::vector<VkDescriptorSetLayoutBinding> bindingList;
+    for (const auto& b : bindings)
+        bindingList.push_back(b.second);
+
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
     descriptorSetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
-    descriptorSetLayoutInfo.bindingCount = bindings.size();
-    descriptorSetLayoutInfo.pBindings = bindings.data();
+    descriptorSetLayoutInfo.bindingCount = bindingList.size();
+    descriptorSetLayoutInfo.pBindings = bindingList.data();
 
-    VkResult res = vkCreateDescriptorSetLayout(*m_device, &descriptorSetLayoutInfo, nullptr, &m_descriptorSetLayout);
+    VkResult res = VK_CALL(vkCreateDescriptorSetLayout, *m_device, &descriptorSetLayoutInfo, nullptr, &m_descriptorSetLayout);
     if (res != VK_SUCCESS)
         return false;
 
-    // TODO push constants
     VkPipelineLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
     layoutInfo.setLayoutCount = 1u;
     layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (pushConstantRange.size > 0u)
+    {
+        layoutInfo.pushConstantRangeCount = 1u;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+    }
+    m_pushConstantStages = pushConstantRange.stageFlags;
 
-    res = vkCreatePipelineLayout(*m_device, &layoutInfo, nullptr, &m_handle);
+    res = VK_CALL(vkCreatePipelineLayout, *m_device, &layoutInfo, nullptr, &m_handle);
     return res == VK_SUCCESS;
 }
 
 void PipelineLayout::destroy()
 {
-    vkDestroyDescriptorSetLayout(*m_device, m_descriptorSetLayout, nullptr);
-    vkDestroyPipelineLayout(*m_device, m_handle, nullptr);
+    VK_CALL(vkDestroyDescriptorSetLayout, *m_device, m_descriptorSetLayout, nullptr);
+    VK_CALL(vkDestroyPipelineLayout, *m_device, m_handle, nullptr);
 }
 
 GraphicsPipeline::GraphicsPipeline(Device* device) : m_device(device)
@@ -645,7 +1213,7 @@ bool GraphicsPipeline::create(const std::unordered_set<Shader*>& shaders)
     m_createInfo.pColorBlendState = &colorBlendInfo;
     m_createInfo.layout = *m_layout;
 
-    VkResult res = vkCreateGraphicsPipelines(*m_device, VK_NULL_HANDLE, 1u, &m_createInfo, nullptr, &m_handle);
+    VkResult res = VK_CALL(vkCreateGraphicsPipelines, *m_device, VK_NULL_HANDLE, 1u, &m_createInfo, nullptr, &m_handle);
     return res == VK_SUCCESS;
 }
 
@@ -678,6 +1246,238 @@ bool GraphicsPipeline::create(const std::unordered_set<Shader*>& shaders, uint32
     return create(shaders);
 }
 
+ComputePipeline::~ComputePipeline()
+{
+    if (m_handle != VK_NULL_HANDLE)
+        destroy();
+}
+
+bool ComputePipeline::create(Shader& shader, std::shared_ptr<PipelineLayout> layout)
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    m_layout = layout;
+    m_createInfo.stage = shader.m_shaderStageInfo;
+    m_createInfo.layout = *m_layout;
+
+    VkResult res = VK_CALL(vkCreateComputePipelines, *m_device, VK_NULL_HANDLE, 1u, &m_createInfo, nullptr, &m_handle);
+    return res == VK_SUCCESS;
+}
+
+bool ComputePipeline::create(Shader& shader)
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    std::shared_ptr<PipelineLayout> layout = std::make_shared<PipelineLayout>(m_device);
+    if (!layout->create({ &shader }))
+        return false;
+
+    return create(shader, layout);
+}
+
+RayTracingPipeline::RayTracingPipeline(Device* device) : m_device(device)
+{
+    m_createInfo.maxPipelineRayRecursionDepth = 1u;
+}
+
+RayTracingPipeline::~RayTracingPipeline()
+{
+    if (m_handle != VK_NULL_HANDLE)
+        destroy();
+}
+
+std::unordered_set<Shader*> RayTracingPipeline::getShaders() const
+{
+    std::unordered_set<Shader*> shaders;
+    for (const std::vector<ShaderGroup>* groups : { &m_raygenGroups, &m_missGroups, &m_hitGroups })
+    {
+        for (const ShaderGroup& g : *groups)
+        {
+            for (Shader* sh : { g.general, g.closestHit, g.anyHit, g.intersection })
+            {
+                if (sh)
+                    shaders.insert(sh);
+            }
+        }
+    }
+    return shaders;
+}
+
+bool RayTracingPipeline::create(std::shared_ptr<PipelineLayout> layout)
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR = m_device->m_vkCreateRayTracingPipelinesKHR;
+    if (!m_device->isExtensionEnabled(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) || !vkCreateRayTracingPipelinesKHR)
+    {
+        LOGE("Ray tracing pipeline requires " VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME " to be enabled on the device.");
+        return false;
+    }
+
+    if (m_raygenGroups.empty())
+    {
+        LOGE("Ray tracing pipeline requires at least one raygen group.");
+        return false;
+    }
+
+    m_layout = layout;
+
+    // shader stages are deduplicated, groups index into them
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+    std::map<const Shader*, uint32_t> stageIndices;
+    auto getStageIndex = [&shaderStages, &stageIndices](const Shader* sh)
+    {
+        if (!sh)
+            return VK_SHADER_UNUSED_KHR;
+
+        auto it = stageIndices.find(sh);
+        if (it != stageIndices.end())
+            return it->second;
+
+        uint32_t idx = shaderStages.size();
+        shaderStages.push_back(sh->m_shaderStageInfo);
+        stageIndices[sh] = idx;
+        return idx;
+    };
+
+    std::vector<VkRayTracingShaderGroupCreateInfoKHR> groupInfos;
+    for (const std::vector<ShaderGroup>* groups : { &m_raygenGroups, &m_missGroups })
+    {
+        for (const ShaderGroup& g : *groups)
+        {
+            VkRayTracingShaderGroupCreateInfoKHR groupInfo{ VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR };
+            groupInfo.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+            groupInfo.generalShader = getStageIndex(g.general);
+            groupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+            groupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+            groupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
+            groupInfos.push_back(groupInfo);
+        }
+    }
+    for (const ShaderGroup& g : m_hitGroups)
+    {
+        VkRayTracingShaderGroupCreateInfoKHR groupInfo{ VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR };
+        groupInfo.type = g.intersection ? VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR : VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+        groupInfo.generalShader = VK_SHADER_UNUSED_KHR;
+        groupInfo.closestHitShader = getStageIndex(g.closestHit);
+        groupInfo.anyHitShader = getStageIndex(g.anyHit);
+        groupInfo.intersectionShader = getStageIndex(g.intersection);
+        groupInfos.push_back(groupInfo);
+    }
+
+    m_createInfo.stageCount = shaderStages.size();
+    m_createInfo.pStages = shaderStages.data();
+    m_createInfo.groupCount = groupInfos.size();
+    m_createInfo.pGroups = groupInfos.data();
+    m_createInfo.layout = *m_layout;
+
+    VkResult res = VK_CALL(vkCreateRayTracingPipelinesKHR, *m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1u, &m_createInfo, nullptr, &m_handle);
+    return res == VK_SUCCESS;
+}
+
+bool RayTracingPipeline::create()
+{
+    if (m_handle != VK_NULL_HANDLE)
+        return false;
+
+    std::shared_ptr<PipelineLayout> layout = std::make_shared<PipelineLayout>(m_device);
+    if (!layout->create(getShaders()))
+        return false;
+
+    return create(layout);
+}
+
+bool RayTracingPipeline::getShaderGroupHandles(uint32_t handleSize, std::vector<uint8_t>& handles) const
+{
+    // only a created pipeline has handles, and creation required the extension
+    PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR = m_device->m_vkGetRayTracingShaderGroupHandlesKHR;
+    if (m_handle == VK_NULL_HANDLE || !vkGetRayTracingShaderGroupHandlesKHR)
+        return false;
+
+    uint32_t groupCount = getGroupCount();
+    handles.resize(static_cast<size_t>(groupCount) * handleSize);
+    VkResult res = VK_CALL(vkGetRayTracingShaderGroupHandlesKHR, *m_device, m_handle, 0u, groupCount, handles.size(), handles.data());
+    return res == VK_SUCCESS;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return (size + alignment - 1u) & ~(alignment - 1u);
+}
+
+bool ShaderBindingTable::create(const RayTracingPipeline& pipeline)
+{
+    if (m_buffer.getHandle() != VK_NULL_HANDLE)
+        return false;
+
+    VkPhysicalDeviceProperties2 props{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    props.pNext = &m_properties;
+    VK_CALL(vkGetPhysicalDeviceProperties2, m_device->m_physicalDevice, &props);
+
+    const uint32_t handleSize = m_properties.shaderGroupHandleSize;
+    const VkDeviceSize handleStride = alignUp(handleSize, m_properties.shaderGroupHandleAlignment);
+    const VkDeviceSize baseAlignment = m_properties.shaderGroupBaseAlignment;
+
+    std::vector<uint8_t> handles;
+    if (!pipeline.getShaderGroupHandles(handleSize, handles))
+        return false;
+
+    // layout: [raygen 0][raygen 1]...[miss...][hit...], every region starts on a base aligned offset
+    const uint32_t raygenCount = pipeline.m_raygenGroups.size();
+    const uint32_t missCount = pipeline.m_missGroups.size();
+    const uint32_t hitCount = pipeline.m_hitGroups.size();
+
+    const VkDeviceSize raygenStride = alignUp(handleStride, baseAlignment);
+    const VkDeviceSize raygenSize = raygenStride * raygenCount;
+    const VkDeviceSize missSize = alignUp(handleStride * missCount, baseAlignment);
+    const VkDeviceSize hitSize = alignUp(handleStride * hitCount, baseAlignment);
+
+    if (!m_buffer.create(raygenSize + missSize + hitSize, VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, baseAlignment))
+        return false;
+
+    uint8_t* data;
+    if (!m_buffer.map(reinterpret_cast<void**>(&data)))
+        return false;
+
+    uint32_t groupIdx = 0u;
+    for (uint32_t i = 0; i < raygenCount; i++, groupIdx++)
+        memcpy(data + i * raygenStride, handles.data() + groupIdx * handleSize, handleSize);
+    for (uint32_t i = 0; i < missCount; i++, groupIdx++)
+        memcpy(data + raygenSize + i * handleStride, handles.data() + groupIdx * handleSize, handleSize);
+    for (uint32_t i = 0; i < hitCount; i++, groupIdx++)
+        memcpy(data + raygenSize + missSize + i * handleStride, handles.data() + groupIdx * handleSize, handleSize);
+
+    m_buffer.unmap();
+
+    VkDeviceAddress addr = m_buffer.getDeviceAddress();
+
+    m_raygenRegions.resize(raygenCount);
+    for (uint32_t i = 0; i < raygenCount; i++)
+    {
+        m_raygenRegions[i].deviceAddress = addr + i * raygenStride;
+        m_raygenRegions[i].stride = raygenStride;
+        m_raygenRegions[i].size = raygenStride;
+    }
+
+    if (missCount > 0u)
+    {
+        m_missRegion.deviceAddress = addr + raygenSize;
+        m_missRegion.stride = handleStride;
+        m_missRegion.size = missSize;
+    }
+    if (hitCount > 0u)
+    {
+        m_hitRegion.deviceAddress = addr + raygenSize + missSize;
+        m_hitRegion.stride = handleStride;
+        m_hitRegion.size = hitSize;
+    }
+
+    return true;
+}
+
 bool CommandBuffer::create()
 {
     if (m_handle != VK_NULL_HANDLE)
@@ -687,23 +1487,58 @@ bool CommandBuffer::create()
     allocInfo.commandBufferCount = 1u;
     allocInfo.commandPool = m_cmdPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    VkResult res = vkAllocateCommandBuffers(*m_device, &allocInfo, &m_handle);
+    VkResult res = VK_CALL(vkAllocateCommandBuffers, *m_device, &allocInfo, &m_handle);
     return res == VK_SUCCESS;
 }
 
 void CommandBuffer::bindGraphicsPipeline(GraphicsPipeline* pipeline)
 {
-    vkCmdBindPipeline(m_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline);
+    VK_CMD(vkCmdBindPipeline, m_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline);
     m_boundPipeline = *pipeline;
     m_boundLayout = *pipeline->m_layout;
+    m_boundPushConstantStages = pipeline->m_layout->getPushConstantStages();
+}
+
+void CommandBuffer::bindRayTracingPipeline(RayTracingPipeline* pipeline)
+{
+    VK_CMD(vkCmdBindPipeline, m_handle, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, *pipeline);
+    m_boundPipeline = *pipeline;
+    m_boundLayout = *pipeline->m_layout;
+    m_boundPushConstantStages = pipeline->m_layout->getPushConstantStages();
+}
+
+void CommandBuffer::bindComputePipeline(ComputePipeline* pipeline)
+{
+    VK_CMD(vkCmdBindPipeline, m_handle, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline);
+    m_boundPipeline = *pipeline;
+    m_boundLayout = *pipeline->m_layout;
+    m_boundPushConstantStages = pipeline->m_layout->getPushConstantStages();
+}
+
+void CommandBuffer::pushConstants(const void* data, uint32_t size, uint32_t offset)
+{
+    VK_CMD(vkCmdPushConstants, m_handle, m_boundLayout, m_boundPushConstantStages, offset, size, data);
+}
+
+void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    VK_CMD(vkCmdDispatch, m_handle, groupCountX, groupCountY, groupCountZ);
+}
+
+void CommandBuffer::traceRays(const ShaderBindingTable& sbt, uint32_t width, uint32_t height, uint32_t depth, uint32_t raygenIdx)
+{
+    // an SBT exists only for a created ray tracing pipeline, so the device has the extension enabled
+    PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR = m_device->m_vkCmdTraceRaysKHR;
+
+    VK_CMD(vkCmdTraceRaysKHR, m_handle, &sbt.getRaygenRegion(raygenIdx), &sbt.m_missRegion, &sbt.m_hitRegion, &sbt.m_callableRegion, width, height, depth);
 }
 
-void CommandBuffer::imageMemoryBarrier(VkImage img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t arrayLayers, uint32_t mipLevels)
+void CommandBuffer::imageMemoryBarrier(VkImage img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t arrayLayers, uint32_t mipLevels, uint32_t baseMipLevel)
 {
     VkImageSubresourceRange subRange{};
     subRange.aspectMask = aspectMask;
     subRange.baseArrayLayer = 0u;
-    subRange.baseMipLevel = 0u;
+    subRange.baseMipLevel = baseMipLevel;
     subRange.layerCount = arrayLayers;
     subRange.levelCount = mipLevels;
 
@@ -721,7 +1556,22 @@ void CommandBuffer::imageMemoryBarrier(VkImage img, VkImageAspectFlags aspectMas
     dependencyInfo.imageMemoryBarrierCount = 1u;
     dependencyInfo.pImageMemoryBarriers = &imageMemoryBarrier;
 
-    vkCmdPipelineBarrier2(m_handle, &dependencyInfo);
+    VK_CMD(vkCmdPipelineBarrier2, m_handle, &dependencyInfo);
+}
+
+void CommandBuffer::memoryBarrier(VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask)
+{
+    VkMemoryBarrier2 memoryBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER_2 };
+    memoryBarrier.srcStageMask = srcStageMask;
+    memoryBarrier.srcAccessMask = srcAccessMask;
+    memoryBarrier.dstStageMask = dstStageMask;
+    memoryBarrier.dstAccessMask = dstAccessMask;
+
+    VkDependencyInfo dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO };
+    dependencyInfo.memoryBarrierCount = 1u;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+
+    VK_CMD(vkCmdPipelineBarrier2, m_handle, &dependencyInfo);
 }
 
 void CommandBuffer::imageMemoryBarrier(Image& img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout newLayout)
@@ -730,6 +1580,63 @@ void CommandBuffer::imageMemoryBarrier(Image& img, VkImageAspectFlags aspectMask
     img.m_layout = newLayout;
 }
 
+void CommandBuffer::copyBuffer(VkBuffer dst, VkBuffer src, VkDeviceSize size, VkDeviceSize dstOffset, VkDeviceSize srcOffset)
+{
+    VkBufferCopy copy{};
+    copy.srcOffset = srcOffset;
+    copy.dstOffset = dstOffset;
+    copy.size = size;
+
+    VK_CMD(vkCmdCopyBuffer, m_handle, src, dst, 1u, &copy);
+}
+
+void CommandBuffer::copyBufferToImage(Image& dst, VkBuffer src, VkImageAspectFlags aspectMask, VkDeviceSize srcOffset, uint32_t levelCount)
+{
+    // src is tightly packed with levels following each other, dst must be in TRANSFER_DST_OPTIMAL or GENERAL layout
+    std::vector<VkBufferImageCopy> copies(levelCount);
+    for (uint32_t level = 0u; level < levelCount; level++)
+    {
+        copies[level].bufferOffset = srcOffset;
+        copies[level].imageSubresource.aspectMask = aspectMask;
+        copies[level].imageSubresource.mipLevel = level;
+        copies[level].imageSubresource.baseArrayLayer = 0u;
+        copies[level].imageSubresource.layerCount = dst.m_createInfo.arrayLayers;
+        copies[level].imageExtent = dst.getMipExtent(level);
+        srcOffset += dst.getMipSize(level);
+    }
+
+    VK_CMD(vkCmdCopyBufferToImage, m_handle, src, dst, dst.m_layout, levelCount, copies.data());
+}
+
+void CommandBuffer::generateMipLevels(Image& img, VkImageAspectFlags aspectMask, uint32_t srcLevelCount)
+{
+    // each level becomes a blit source once it has been written, the blits run strictly top down
+    uint32_t layerCount = img.m_createInfo.arrayLayers;
+    uint32_t levelCount = img.m_createInfo.mipLevels;
+    for (uint32_t level = 1u; level < levelCount; level++)
+    {
+        imageMemoryBarrier(img, aspectMask, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layerCount, 1u, level - 1u);
+        if (level < srcLevelCount)
+            continue;
+
+        VkExtent3D srcExtent = img.getMipExtent(level - 1u);
+        VkExtent3D dstExtent = img.getMipExtent(level);
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = aspectMask;
+        blit.srcSubresource.mipLevel = level - 1u;
+        blit.srcSubresource.baseArrayLayer = 0u;
+        blit.srcSubresource.layerCount = layerCount;
+        blit.srcOffsets[1] = { static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height), static_cast<int32_t>(srcExtent.depth) };
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstOffsets[1] = { static_cast<int32_t>(dstExtent.width), static_cast<int32_t>(dstExtent.height), static_cast<int32_t>(dstExtent.depth) };
+
+        VK_CMD(vkCmdBlitImage, m_handle, img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &blit, VK_FILTER_LINEAR);
+    }
+    imageMemoryBarrier(img, aspectMask, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layerCount, 1u, levelCount - 1u);
+    img.m_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+}
+
 //RenderContext::RenderContext(GLFWwindow* window)
 //{
 //    createInstance();
@@ -4,10 +4,13 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <unordered_set>
+#include <chrono>
 
 #include "vk_mem_alloc.h"
 
@@ -15,9 +18,58 @@
 #define LOGW(msg) std::cerr << "[WRN] " << (msg) << std::endl
 #define LOGE(msg) std::cerr << "[ERR] " << (msg) << std::endl
 
+// every Vulkan call made by the wrappers goes through these so it can be counted and timed by vk::CallRecorder
+// VK_CMD marks command recording calls, which are dropped instead of forwarded in null mode
+#define VK_CALL(fn, ...) vk::recordedCall(#fn, false, fn, __VA_ARGS__)
+#define VK_CMD(fn, ...) vk::recordedCall(#fn, true, fn, __VA_ARGS__)
+
 namespace vk
 {
 
+// counts and times Vulkan calls per entry point, to measure the CPU cost of recording and loading apart from the GPU
+// null mode additionally skips vkCmd* calls, so command buffers are submitted empty and only the wrappers' own cost remains
+// object creation and submission still reach the driver, they must return real handles
+// so it isn't a null device: it needs a Vulkan device and a window, though a software one (lavapipe) is enough without a GPU
+class CallRecorder
+{
+public:
+    static void record(const char* name, std::chrono::nanoseconds elapsed);
+    // prints per-call totals sorted by time and resets them
+    static void report(const std::string& title);
+    static void reset();
+
+    static bool s_enabled;
+    static bool s_null;
+};
+
+template <typename Fn, typename... Args>
+inline auto recordedCall(const char* name, bool isCmd, Fn fn, Args&&... args) -> decltype(fn(std::forward<Args>(args)...))
+{
+    if (!CallRecorder::s_enabled)
+        return fn(std::forward<Args>(args)...);
+
+    if (isCmd && CallRecorder::s_null)
+    {
+        CallRecorder::record(name, std::chrono::nanoseconds(0));
+        return decltype(fn(std::forward<Args>(args)...))();
+    }
+
+    // records on scope exit so void calls are timed the same way
+    struct Timer
+    {
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+        ~Timer() { CallRecorder::record(name, std::chrono::steady_clock::now() - start); }
+    } timer{ name, std::chrono::steady_clock::now() };
+    return fn(std::forward<Args>(args)...);
+}
+
+// bytes of one texel block of format, blockDim receives its width and height in texels (1 for uncompressed formats)
+// only the colour formats images are created with here are known, others return 0
+VkDeviceSize getFormatBlockSize(VkFormat format, uint32_t* blockDim = nullptr);
+// bytes of levelCount tightly packed mip levels of one layer, level 0 first
+VkDeviceSize getImageSize(VkFormat format, VkExtent3D extent, uint32_t levelCount = 1u);
+
 class Instance
 {
 public:
@@ -27,7 +79,7 @@ public:
     ~Instance();
 
     bool create();
-    void destroy() { vkDestroyInstance(m_handle, nullptr); }
+    void destroy() { VK_CALL(vkDestroyInstance, m_handle, nullptr); }
     VkInstance getHandle() const { return m_handle; }
 
     Instance& operator=(const Instance&) = delete;
@@ -51,12 +103,14 @@ public:
     ~Device();
 
     bool create();
-    void destroy() { vkDestroyDevice(m_handle, nullptr); }
+    void destroy() { VK_CALL(vkDestroyDevice, m_handle, nullptr); }
     inline VkDevice getHandle() const { return m_handle; }
 
     VkQueue getQueue(VkQueueFlags flags, uint32_t idx) const;
     bool submitToQueue(VkQueue queue, VkCommandBuffer cmdBuf, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStageMask, VkSemaphore signalSemaphore, VkFence fence) const;
+    bool submitAndWait(VkQueue queue, VkCommandBuffer cmdBuf) const;
     bool waitIdle() const;
+    bool isExtensionEnabled(const char* name) const;
 
     Device& operator=(const Device&) = delete;
     inline operator VkDevice() const { return m_handle; }
@@ -67,16 +121,42 @@ public:
         uint32_t count;
     };
 
+    // enabled only if the selected physical device supports the extension and its feature struct (may be null)
+    struct OptionalExtension
+    {
+        const char* name;
+        void* features;
+    };
+
     Instance* m_instance;
+    // physical devices are scored and the best suitable one is picked, the preferred type only adds to the score
     VkPhysicalDeviceType m_physicalDeviceType = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-    VkPhysicalDevice m_physicalDevice;
+    // explicit selection, by enumeration index or device UUID (hex, dashes ignored)
+    int m_physicalDeviceIndex = -1;
+    std::string m_physicalDeviceUUID;
+    // allow CPU and virtual devices (e.g. lavapipe, SwiftShader) when no GPU is suitable
+    bool m_allowSoftwareDevices = true;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
     VkPhysicalDeviceFeatures2 m_enabledFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
     std::vector<const char*> m_enabledExtensions;
+    std::vector<OptionalExtension> m_optionalExtensions;
+    // core features enabled only if the selected physical device supports them, check m_enabledFeatures after create()
+    VkPhysicalDeviceFeatures m_optionalFeatures{};
     std::vector<QueueRequirements> m_queueRequirements;
     VkDeviceCreateInfo m_createInfo{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     std::map<VkQueueFlags, uint32_t> m_queueFlagsToQueueFamily;
+    // queues are shared by the render and scene loader threads, submission, presentation and waiting idle hold this
+    mutable std::mutex m_queueMutex;
+    // ray tracing entry points of this device, loaded by create() only if VK_KHR_ray_tracing_pipeline is enabled
+    PFN_vkCreateRayTracingPipelinesKHR m_vkCreateRayTracingPipelinesKHR = nullptr;
+    PFN_vkGetRayTracingShaderGroupHandlesKHR m_vkGetRayTracingShaderGroupHandlesKHR = nullptr;
+    PFN_vkCmdTraceRaysKHR m_vkCmdTraceRaysKHR = nullptr;
 
 private:
+    int64_t scorePhysicalDevice(VkPhysicalDevice pd) const;
+    bool supportsFeatures(VkPhysicalDevice pd, const void* featuresChain, const VkPhysicalDeviceFeatures* coreFeatures) const;
+    bool supportsExtension(VkPhysicalDevice pd, const char* name) const;
+
     VkDevice m_handle = VK_NULL_HANDLE;
 };
 
@@ -116,11 +196,15 @@ public:
     ~Buffer();
 
     bool create(VkDeviceSize size, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage, VmaAllocationCreateFlags allocationFlags, VkMemoryPropertyFlags memoryFlags, VkDeviceSize minAlignment = 0u);
-    void destroy() { vmaDestroyBuffer(m_allocator, m_handle, m_allocation); }
+    // binds host memory imported via VK_EXT_external_memory_host instead of a VMA allocation, the memory must outlive the buffer
+    // hostPtr and size must be multiples of minImportedHostPointerAlignment
+    bool importHostMemory(const void* hostPtr, VkDeviceSize size, VkBufferUsageFlags bufferUsage);
+    void destroy();
     inline VkBuffer getHandle() const { return m_handle; }
 
     bool map(void** data) const;
     void unmap() const { vmaUnmapMemory(m_allocator, m_allocation); }
+    VkDeviceAddress getDeviceAddress() const;
 
     Buffer& operator=(const VkBuffer&) = delete;
     inline operator VkBuffer() const { return m_handle; }
@@ -131,6 +215,7 @@ public:
 private:
     VmaAllocator m_allocator;
     VmaAllocation m_allocation = nullptr;
+    VkDeviceMemory m_importedMemory = VK_NULL_HANDLE;
     VkBuffer m_handle = VK_NULL_HANDLE;
 };
 
@@ -149,6 +234,13 @@ public:
     bool map(void** data) const;
     void unmap() const { vmaUnmapMemory(m_allocator, m_allocation); }
 
+    VkExtent3D getMipExtent(uint32_t level) const { return { std::max(m_createInfo.extent.width >> level, 1u), std::max(m_createInfo.extent.height >> level, 1u), std::max(m_createInfo.extent.depth >> level, 1u) }; }
+    VkDeviceSize getMipSize(uint32_t level) const { return getImageSize(m_createInfo.format, getMipExtent(level)) * m_createInfo.arrayLayers; }
+
+    // VK_EXT_host_image_copy, image must be created with VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT
+    // transitions to dstLayout and copies tightly packed texels into mips 0 .. levelCount - 1 without any command buffer, levels follow each other in data
+    bool copyFromHost(const void* data, VkImageAspectFlags aspectMask, VkImageLayout dstLayout, uint32_t levelCount = 1u);
+
     Image& operator=(const Image&) = delete;
     inline operator VkImage() const { return m_handle; }
 
@@ -171,7 +263,7 @@ public:
     ~ImageView();
 
     bool create(VkImageAspectFlags aspectMask);
-    void destroy() { vkDestroyImageView(*m_device, m_handle, nullptr); }
+    void destroy() { VK_CALL(vkDestroyImageView, *m_device, m_handle, nullptr); }
     inline VkImageView getHandle() const { return m_handle; }
 
     VkImageView& operator=(const ImageView&) = delete;
@@ -194,7 +286,7 @@ public:
     ~Shader();
 
     bool create(const std::string& spirvFilepath, VkShaderStageFlagBits stage);
-    void destroy() { vkDestroyShaderModule(*m_device, m_module, nullptr); }
+    void destroy() { VK_CALL(vkDestroyShaderModule, *m_device, m_module, nullptr); }
 
     Shader& operator=(const Shader&) = delete;
 
@@ -217,6 +309,8 @@ public:
     bool create(const std::unordered_set<Shader*>& shaders);
     void destroy();
     inline VkPipelineLayout getHandle() const { return m_handle; }
+    // stages of the single push constant range, 0 if no shader declares a push constant block
+    VkShaderStageFlags getPushConstantStages() const { return m_pushConstantStages; }
 
     PipelineLayout& operator=(const PipelineLayout&) = delete;
     inline operator VkPipelineLayout() const { return m_handle; }
@@ -224,6 +318,7 @@ public:
 private:
     Device* m_device;
     VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkShaderStageFlags m_pushConstantStages = 0u;
     VkPipelineLayout m_handle = VK_NULL_HANDLE;
 };
 
@@ -237,7 +332,7 @@ public:
 
     bool create(const std::unordered_set<Shader*>& shaders, std::shared_ptr<PipelineLayout> layout, uint32_t width, uint32_t height);
     bool create(const std::unordered_set<Shader*>& shaders, uint32_t width, uint32_t height);
-    void destroy() { vkDestroyPipeline(*m_device, m_handle, nullptr); }
+    void destroy() { VK_CALL(vkDestroyPipeline, *m_device, m_handle, nullptr); }
     inline VkPipeline getHandle() const { return m_handle; }
 
     GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
@@ -264,6 +359,101 @@ private:
     VkPipeline m_handle = VK_NULL_HANDLE;
 };
 
+class ComputePipeline
+{
+public:
+    ComputePipeline(Device* device) : m_device(device) {}
+    ComputePipeline(const ComputePipeline&) = delete;
+
+    ~ComputePipeline();
+
+    bool create(Shader& shader, std::shared_ptr<PipelineLayout> layout);
+    bool create(Shader& shader);
+    void destroy() { VK_CALL(vkDestroyPipeline, *m_device, m_handle, nullptr); }
+    inline VkPipeline getHandle() const { return m_handle; }
+
+    ComputePipeline& operator=(const ComputePipeline&) = delete;
+    inline operator VkPipeline() const { return m_handle; }
+
+    std::shared_ptr<PipelineLayout> m_layout;
+    VkComputePipelineCreateInfo m_createInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+
+private:
+    Device* m_device;
+    VkPipeline m_handle = VK_NULL_HANDLE;
+};
+
+class RayTracingPipeline
+{
+public:
+    RayTracingPipeline(Device* device);
+    RayTracingPipeline(const RayTracingPipeline&) = delete;
+
+    ~RayTracingPipeline();
+
+    bool create(std::shared_ptr<PipelineLayout> layout);
+    bool create();
+    void destroy() { VK_CALL(vkDestroyPipeline, *m_device, m_handle, nullptr); }
+    inline VkPipeline getHandle() const { return m_handle; }
+
+    uint32_t getGroupCount() const { return m_raygenGroups.size() + m_missGroups.size() + m_hitGroups.size(); }
+    bool getShaderGroupHandles(uint32_t handleSize, std::vector<uint8_t>& handles) const;
+
+    RayTracingPipeline& operator=(const RayTracingPipeline&) = delete;
+    inline operator VkPipeline() const { return m_handle; }
+
+    // raygen and miss groups only use general, hit groups use the rest
+    // a hit group with an intersection shader is a procedural hit group
+    struct ShaderGroup
+    {
+        Shader* general = nullptr;
+        Shader* closestHit = nullptr;
+        Shader* anyHit = nullptr;
+        Shader* intersection = nullptr;
+    };
+
+    // groups are laid out raygen, miss, hit in the pipeline (and in the SBT)
+    std::shared_ptr<PipelineLayout> m_layout;
+    std::vector<ShaderGroup> m_raygenGroups;
+    std::vector<ShaderGroup> m_missGroups;
+    std::vector<ShaderGroup> m_hitGroups;
+
+    VkRayTracingPipelineCreateInfoKHR m_createInfo{ VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR };
+
+private:
+    std::unordered_set<Shader*> getShaders() const;
+
+    Device* m_device;
+    VkPipeline m_handle = VK_NULL_HANDLE;
+};
+
+class ShaderBindingTable
+{
+public:
+    ShaderBindingTable(Device* device, VmaAllocator allocator) : m_device(device), m_buffer(allocator) {}
+    ShaderBindingTable(const ShaderBindingTable&) = delete;
+
+    ~ShaderBindingTable() {}
+
+    bool create(const RayTracingPipeline& pipeline);
+    void destroy() { m_buffer.destroy(); }
+
+    // each raygen record gets its own region, since raygen regions must have size == stride
+    const VkStridedDeviceAddressRegionKHR& getRaygenRegion(uint32_t idx) const { return m_raygenRegions[idx]; }
+
+    ShaderBindingTable& operator=(const ShaderBindingTable&) = delete;
+
+    VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR };
+    VkStridedDeviceAddressRegionKHR m_missRegion{};
+    VkStridedDeviceAddressRegionKHR m_hitRegion{};
+    VkStridedDeviceAddressRegionKHR m_callableRegion{};
+
+private:
+    Device* m_device;
+    Buffer m_buffer;
+    std::vector<VkStridedDeviceAddressRegionKHR> m_raygenRegions;
+};
+
 class CommandBuffer
 {
 public:
@@ -273,12 +463,24 @@ public:
     ~CommandBuffer() {}
 
     bool create();
-    void free() { vkFreeCommandBuffers(*m_device, m_cmdPool, 1u, &m_handle); }
+    void free() { VK_CALL(vkFreeCommandBuffers, *m_device, m_cmdPool, 1u, &m_handle); }
     inline VkCommandBuffer getHandle() const { return m_handle; }
 
     void bindGraphicsPipeline(vk::GraphicsPipeline* pipeline);
-    void imageMemoryBarrier(VkImage img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t arrayLayers = 1u, uint32_t mipLevels = 1u);
+    void bindRayTracingPipeline(vk::RayTracingPipeline* pipeline);
+    void bindComputePipeline(vk::ComputePipeline* pipeline);
+    // into the bound pipeline's push constant range
+    void pushConstants(const void* data, uint32_t size, uint32_t offset = 0u);
+    void dispatch(uint32_t groupCountX, uint32_t groupCountY = 1u, uint32_t groupCountZ = 1u);
+    void traceRays(const ShaderBindingTable& sbt, uint32_t width, uint32_t height, uint32_t depth = 1u, uint32_t raygenIdx = 0u);
+    void imageMemoryBarrier(VkImage img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t arrayLayers = 1u, uint32_t mipLevels = 1u, uint32_t baseMipLevel = 0u);
     void imageMemoryBarrier(Image& img, VkImageAspectFlags aspectMask, VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask, VkImageLayout newLayout);
+    // global barrier, for buffers written and read by the device within one submission
+    void memoryBarrier(VkPipelineStageFlags2 srcStageMask, VkAccessFlags2 srcAccessMask, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask);
+    void copyBuffer(VkBuffer dst, VkBuffer src, VkDeviceSize size, VkDeviceSize dstOffset = 0u, VkDeviceSize srcOffset = 0u);
+    void copyBufferToImage(Image& dst, VkBuffer src, VkImageAspectFlags aspectMask, VkDeviceSize srcOffset = 0u, uint32_t levelCount = 1u);
+    // blits every level from srcLevelCount on from the one above, all levels must be in TRANSFER_DST_OPTIMAL and end up in TRANSFER_SRC_OPTIMAL
+    void generateMipLevels(Image& img, VkImageAspectFlags aspectMask, uint32_t srcLevelCount = 1u);
 
     CommandBuffer& operator=(const CommandBuffer&) = delete;
     inline operator VkCommandBuffer() const { return m_handle; }
@@ -290,6 +492,7 @@ private:
     // TODO reference pipeline superclass
     VkPipeline m_boundPipeline = VK_NULL_HANDLE;
     VkPipelineLayout m_boundLayout = VK_NULL_HANDLE;
+    VkShaderStageFlags m_boundPushConstantStages = 0u;
 };
 
 //class RenderContext
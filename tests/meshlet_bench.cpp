@@ -0,0 +1,72 @@
+#include "../src/meshlet_builder.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// times buildMeshlets on a rippled grid, usage: meshlet_bench [columns rows iterations]
+
+int main(int argc, char** argv)
+{
+    uint32_t columns = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 800u;
+    uint32_t rows = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 400u;
+    uint32_t iterations = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 5u;
+    if (columns == 0u || rows == 0u || iterations == 0u)
+    {
+        std::printf("usage: meshlet_bench [columns rows iterations]\n");
+        return 1;
+    }
+
+    std::vector<glm::vec3> positions;
+    positions.reserve((columns + 1u) * (rows + 1u));
+    for (uint32_t i = 0; i <= rows; i++)
+    {
+        for (uint32_t j = 0; j <= columns; j++)
+        {
+            float x = static_cast<float>(j) / columns;
+            float z = static_cast<float>(i) / rows;
+            positions.push_back(glm::vec3(x, 0.05f * std::sin(40.0f * x) * std::cos(25.0f * z), z));
+        }
+    }
+    std::vector<uint32_t> indices;
+    indices.reserve(6u * columns * rows);
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        for (uint32_t j = 0; j < columns; j++)
+        {
+            uint32_t a = i * (columns + 1u) + j;
+            uint32_t b = a + 1u;
+            uint32_t c = a + columns + 1u;
+            uint32_t d = c + 1u;
+            indices.insert(indices.end(), { a, c, b, b, c, d });
+        }
+    }
+
+    MeshletSet set;
+    double best = 0.0;
+    double total = 0.0;
+    for (uint32_t k = 0; k < iterations; k++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (!buildMeshlets(positions.data(), static_cast<uint32_t>(positions.size()), indices.data(), indices.size(), set))
+        {
+            std::printf("buildMeshlets failed\n");
+            return 1;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = k == 0u || ms < best ? ms : best;
+        total += ms;
+    }
+
+    size_t triangleCount = indices.size() / 3u;
+    size_t coneCount = 0;
+    for (const Meshlet& m : set.meshlets)
+        coneCount += m.coneCutoff < 1.0f ? 1u : 0u;
+    std::printf("%zu triangles, %zu vertices -> %zu meshlets, %.1f vertices and %.1f triangles per meshlet, %zu with a cone\n",
+        triangleCount, positions.size(), set.meshlets.size(),
+        static_cast<double>(set.vertices.size()) / set.meshlets.size(), static_cast<double>(triangleCount) / set.meshlets.size(), coneCount);
+    std::printf("best %.2f ms, mean %.2f ms over %u runs, %.1f M triangles/s\n", best, total / iterations, iterations, triangleCount / (best * 1000.0));
+    return 0;
+}
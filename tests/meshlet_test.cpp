@@ -0,0 +1,170 @@
+#include "../src/meshlet_builder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+
+// checks the invariants of buildMeshlets on a few meshes, returns the number of failed checks
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { std::printf("FAIL %s:%d: ", __FILE__, __LINE__); std::printf(__VA_ARGS__); std::printf("\n"); s_failures++; } } while (0)
+
+struct TestMesh
+{
+    const char* name;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+// uv sphere with bumps, so the meshlets get cones of different widths
+static TestMesh bumpySphere(uint32_t rows, uint32_t columns)
+{
+    TestMesh mesh;
+    mesh.name = "bumpy sphere";
+    for (uint32_t i = 0; i <= rows; i++)
+    {
+        for (uint32_t j = 0; j <= columns; j++)
+        {
+            float theta = 3.14159265f * i / rows;
+            float phi = 6.28318531f * j / columns;
+            float r = 1.0f + 0.05f * std::sin(13.0f * theta) * std::cos(7.0f * phi);
+            mesh.positions.push_back(r * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        for (uint32_t j = 0; j < columns; j++)
+        {
+            uint32_t a = i * (columns + 1u) + j;
+            uint32_t b = a + 1u;
+            uint32_t c = a + columns + 1u;
+            uint32_t d = c + 1u;
+            mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+        }
+    }
+    return mesh;
+}
+
+// triangles over random vertices, few share more than one vertex so most meshlets hit the vertex limit first
+static TestMesh triangleSoup(uint32_t vertexCount, uint32_t triangleCount)
+{
+    TestMesh mesh;
+    mesh.name = "triangle soup";
+    std::mt19937 rng(7u);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> vertex(0u, vertexCount - 1u);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        mesh.positions.push_back(glm::vec3(coord(rng), coord(rng), coord(rng)));
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        // degenerate triangles included, they carry no normal but still have to be covered
+        mesh.indices.push_back(vertex(rng));
+        mesh.indices.push_back(vertex(rng));
+        mesh.indices.push_back(t % 17u == 0u ? mesh.indices.back() : vertex(rng));
+    }
+    return mesh;
+}
+
+static void checkMesh(const TestMesh& mesh)
+{
+    std::printf("%s: %zu triangles\n", mesh.name, mesh.indices.size() / 3u);
+
+    MeshletSet set;
+    bool built = buildMeshlets(mesh.positions.data(), static_cast<uint32_t>(mesh.positions.size()), mesh.indices.data(), mesh.indices.size(), set);
+    CHECK(built, "%s: buildMeshlets failed", mesh.name);
+    if (!built)
+        return;
+
+    typedef std::tuple<uint32_t, uint32_t, uint32_t> Triangle;
+    std::vector<Triangle> expected;
+    for (size_t i = 0; i < mesh.indices.size(); i += 3u)
+        expected.push_back(Triangle(mesh.indices[i], mesh.indices[i + 1u], mesh.indices[i + 2u]));
+
+    std::vector<Triangle> covered;
+    for (size_t i = 0; i < set.meshlets.size(); i++)
+    {
+        const Meshlet& m = set.meshlets[i];
+        CHECK(m.vertexCount > 0u && m.vertexCount <= MESHLET_MAX_VERTICES, "%s: meshlet %zu has %u vertices", mesh.name, i, m.vertexCount);
+        CHECK(m.triangleCount > 0u && m.triangleCount <= MESHLET_MAX_TRIANGLES, "%s: meshlet %zu has %u triangles", mesh.name, i, m.triangleCount);
+        CHECK(m.triangleOffset % 4u == 0u, "%s: meshlet %zu triangle offset %u is not 4 byte aligned", mesh.name, i, m.triangleOffset);
+        bool inRange = m.vertexOffset + m.vertexCount <= set.vertices.size() && m.triangleOffset + 3u * m.triangleCount <= set.triangles.size();
+        CHECK(inRange, "%s: meshlet %zu runs past the end of the set", mesh.name, i);
+        if (!inRange)
+            continue;
+
+        const uint32_t* vertices = &set.vertices[m.vertexOffset];
+        const uint8_t* triangles = &set.triangles[m.triangleOffset];
+        for (uint32_t t = 0; t < 3u * m.triangleCount; t++)
+            CHECK(triangles[t] < m.vertexCount, "%s: meshlet %zu local index %u is out of range", mesh.name, i, triangles[t]);
+        for (uint32_t t = 0; t < m.triangleCount; t++)
+        {
+            const uint8_t* tri = triangles + 3u * t;
+            if (tri[0] < m.vertexCount && tri[1] < m.vertexCount && tri[2] < m.vertexCount)
+                covered.push_back(Triangle(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]));
+        }
+
+        float slack = 1e-5f * std::max(1.0f, m.radius);
+        for (uint32_t v = 0; v < m.vertexCount; v++)
+            CHECK(glm::length(mesh.positions[vertices[v]] - m.center) <= m.radius + slack, "%s: meshlet %zu vertex %u is outside its bounds", mesh.name, i, v);
+    }
+
+    // every triangle in exactly one meshlet, with its winding kept
+    std::sort(expected.begin(), expected.end());
+    std::sort(covered.begin(), covered.end());
+    CHECK(covered == expected, "%s: meshlets cover %zu triangles, the mesh has %zu or the triangles differ", mesh.name, covered.size(), expected.size());
+
+    MeshletSet again;
+    buildMeshlets(mesh.positions.data(), static_cast<uint32_t>(mesh.positions.size()), mesh.indices.data(), mesh.indices.size(), again);
+    CHECK(again.vertices == set.vertices && again.triangles == set.triangles && again.meshlets.size() == set.meshlets.size(), "%s: rebuilding gives different meshlets", mesh.name);
+
+    // cone culling is conservative: a culled meshlet has no triangle facing the viewer
+    std::mt19937 rng(1u);
+    std::uniform_real_distribution<float> coord(-4.0f, 4.0f);
+    size_t culled = 0;
+    size_t wrong = 0;
+    for (uint32_t k = 0; k < 64u; k++)
+    {
+        glm::vec3 view(coord(rng), coord(rng), coord(rng));
+        for (const Meshlet& m : set.meshlets)
+        {
+            if (!meshletBackfacing(m, view))
+                continue;
+            culled++;
+            const uint32_t* vertices = &set.vertices[m.vertexOffset];
+            const uint8_t* triangles = &set.triangles[m.triangleOffset];
+            for (uint32_t t = 0; t < m.triangleCount; t++)
+            {
+                glm::vec3 a = mesh.positions[vertices[triangles[3u * t]]];
+                glm::vec3 b = mesh.positions[vertices[triangles[3u * t + 1u]]];
+                glm::vec3 c = mesh.positions[vertices[triangles[3u * t + 2u]]];
+                if (glm::dot(a - view, glm::cross(b - a, c - a)) < 0.0f)
+                {
+                    wrong++;
+                    break;
+                }
+            }
+        }
+    }
+    CHECK(wrong == 0u, "%s: %zu of %zu culled meshlets have front facing triangles", mesh.name, wrong, culled);
+    std::printf("%s: %zu meshlets, %zu culled from 64 views\n", mesh.name, set.meshlets.size(), culled);
+}
+
+int main()
+{
+    checkMesh(bumpySphere(64u, 128u));
+    checkMesh(triangleSoup(4096u, 20000u));
+
+    // an index past the vertex count has to be rejected
+    glm::vec3 position(0.0f);
+    uint32_t badIndices[] = { 0u, 0u, 1u };
+    MeshletSet set;
+    CHECK(!buildMeshlets(&position, 1u, badIndices, 3u, set), "an out of range index was accepted");
+
+    if (s_failures == 0)
+        std::printf("all meshlet checks passed\n");
+    return s_failures == 0 ? 0 : 1;
+}